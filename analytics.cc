@@ -0,0 +1,318 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <string>
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#include "analytics.hh"
+#include "apdufile.hh"
+#include "paylogscan.hh"
+#include "workpool.hh"
+
+struct Spend {
+  unsigned long long count;
+  unsigned long long amount; // Minor units
+};
+
+// Every key is combined with the currency of the entry
+typedef std::unordered_map<unsigned long long, Spend> SpendTable;
+typedef std::unordered_map<std::string, Spend> MerchantTable;
+
+struct Stats {
+  Stats();
+
+  void add(PaylogEntry const& entry);
+  void merge(Stats const& other);
+
+  unsigned long long cards;
+  unsigned long long entries;
+  MerchantTable merchants;
+  SpendTable countries;
+  SpendTable currencies;
+  SpendTable days;
+  SpendTable types;
+  std::vector<unsigned long long> logCounts; // Cards per number of entries
+  std::vector<unsigned long long> amounts; // Log-linear histogram
+};
+
+/* 16 sub-buckets per power of two, about 6% wide.
+   Values below 16 have their own bucket.
+*/
+static const size_t SUB_BUCKETS = 16;
+
+static size_t bucket(unsigned long long value) {
+  if (value < SUB_BUCKETS)
+    return value;
+  int msb = 63 - __builtin_clzll(value);
+  return (msb - 3) * SUB_BUCKETS + ((value >> (msb - 4)) & (SUB_BUCKETS - 1));
+}
+
+static unsigned long long bucketFloor(size_t b) {
+  if (b < SUB_BUCKETS)
+    return b;
+  int msb = b / SUB_BUCKETS + 3;
+  return (1ull << msb) | (unsigned long long)(b % SUB_BUCKETS) << (msb - 4);
+}
+
+Stats::Stats()
+  : cards(0),
+    entries(0),
+    logCounts(33, 0),
+    amounts(bucket(~0ull) + 1, 0)
+{
+}
+
+static void add(SpendTable& table, unsigned long long key, unsigned long long amount) {
+  Spend& s = table[key];
+  s.count++;
+  s.amount += amount;
+}
+
+void Stats::add(PaylogEntry const& e) {
+  unsigned long long currency = e.currency;
+
+  entries++;
+  std::string merchant(e.merchant, e.merchantLength);
+  merchant += (char)(currency >> 8);
+  merchant += (char)currency;
+  Spend& s = merchants[merchant];
+  s.count++;
+  s.amount += e.amountValue;
+
+  ::add(countries, (unsigned long long)e.country << 16 | currency, e.amountValue);
+  ::add(currencies, currency, e.amountValue);
+  ::add(days, (unsigned long long)(e.date[0] << 16 | e.date[1] << 8 | e.date[2]) << 16 | currency, e.amountValue);
+  ::add(types, (unsigned long long)e.type << 16 | currency, e.amountValue);
+  amounts[bucket(e.amountValue)]++;
+}
+
+template <typename Table>
+static void mergeTable(Table& into, Table const& from) {
+  for (typename Table::const_iterator it = from.begin(); it != from.end(); ++it) {
+    Spend& s = into[it->first];
+    s.count += it->second.count;
+    s.amount += it->second.amount;
+  }
+}
+
+void Stats::merge(Stats const& o) {
+  cards += o.cards;
+  entries += o.entries;
+  mergeTable(merchants, o.merchants);
+  mergeTable(countries, o.countries);
+  mergeTable(currencies, o.currencies);
+  mergeTable(days, o.days);
+  mergeTable(types, o.types);
+  for (size_t i = 0; i < logCounts.size(); ++i)
+    logCounts[i] += o.logCounts[i];
+  for (size_t i = 0; i < amounts.size(); ++i)
+    amounts[i] += o.amounts[i];
+}
+
+static std::string currencyText(unsigned short code) {
+  if (code == 0) // Not in the log format
+    return "-";
+  char const* name = CCInfo::currencyName(code);
+  if (name)
+    return name;
+  std::ostringstream s;
+  s << HEX((byte_t)(code >> 8)) << HEX((byte_t)code);
+  return s.str();
+}
+
+static std::string countryText(unsigned short code) {
+  if (code == 0) // Not in the log format
+    return "-";
+  char const* name = CCInfo::countryName(code);
+  if (name)
+    return name;
+  std::ostringstream s;
+  s << HEX((byte_t)(code >> 8)) << HEX((byte_t)code);
+  return s.str();
+}
+
+// Minor units with 2 decimals, as printed by most terminals
+static std::string amountText(unsigned long long amount) {
+  std::ostringstream s;
+  s << amount / 100 << "." << std::setw(2) << std::setfill('0') << amount % 100;
+  return s.str();
+}
+
+template <typename Key>
+static bool byCount(std::pair<Key, Spend> const& a, std::pair<Key, Spend> const& b) {
+  return a.second.count != b.second.count ? a.second.count > b.second.count : a.first < b.first;
+}
+
+template <typename Key>
+static bool byKey(std::pair<Key, Spend> const& a, std::pair<Key, Spend> const& b) {
+  return a.first < b.first;
+}
+
+// Sorted by number of entries, top rows only (0 = all)
+static void printSpend(std::ostream& out, char const* title, SpendTable const& table, size_t top, bool sortByKey,
+		       std::string (*name)(unsigned long long)) {
+  std::vector<std::pair<unsigned long long, Spend> > rows(table.begin(), table.end());
+  std::sort(rows.begin(), rows.end(), sortByKey ? byKey<unsigned long long> : byCount<unsigned long long>);
+  if (top > 0 && rows.size() > top)
+    rows.resize(top);
+
+  out << "-----------------" << std::endl;
+  out << "-- " << title << " --" << std::endl;
+  out << "-----------------" << std::endl;
+  for (std::pair<unsigned long long, Spend> const& r : rows)
+    out << name(r.first) << " " << currencyText(r.first & 0xFFFF) << ": "
+	<< r.second.count << " entries, " << amountText(r.second.amount) << std::endl;
+}
+
+static std::string countryName(unsigned long long key) {
+  return countryText(key >> 16);
+}
+
+static std::string dayName(unsigned long long key) {
+  std::ostringstream s;
+  s << "20" << HEX((byte_t)(key >> 32)) << "/" << HEX((byte_t)(key >> 24)) << "/" << HEX((byte_t)(key >> 16));
+  return s.str();
+}
+
+static std::string typeName(unsigned long long key) {
+  return (key >> 16) ? "Withdrawal" : "Payment";
+}
+
+static std::string noName(unsigned long long) {
+  return "";
+}
+
+static void printMerchants(std::ostream& out, MerchantTable const& table, size_t top) {
+  std::vector<std::pair<std::string, Spend> > rows(table.begin(), table.end());
+  std::sort(rows.begin(), rows.end(), byCount<std::string>);
+  if (top > 0 && rows.size() > top)
+    rows.resize(top);
+
+  out << "-----------------" << std::endl;
+  out << "-- Merchants --" << std::endl;
+  out << "-----------------" << std::endl;
+  for (std::pair<std::string, Spend> const& r : rows) {
+    size_t length = r.first.size() - 2;
+    unsigned short currency = (byte_t)r.first[length] << 8 | (byte_t)r.first[length + 1];
+    if (length == 0)
+      out << "-";
+    out.write(r.first.data(), length);
+    out << " " << currencyText(currency) << ": "
+	<< r.second.count << " entries, " << amountText(r.second.amount) << std::endl;
+  }
+}
+
+static void printAmounts(std::ostream& out, std::vector<unsigned long long> const& histogram, unsigned long long total) {
+  double const quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  char const* names[] = {"p50", "p90", "p99", "p99.9"};
+
+  out << "Amount (minor units, all currencies):";
+  if (total == 0) {
+    out << " no entry" << std::endl;
+    return;
+  }
+
+  size_t first = 0;
+  while (histogram[first] == 0)
+    ++first;
+  size_t last = histogram.size() - 1;
+  while (histogram[last] == 0)
+    --last;
+
+  out << " min " << bucketFloor(first);
+  unsigned long long seen = 0;
+  size_t q = 0;
+  for (size_t b = first; b <= last && q < 4; ++b) {
+    seen += histogram[b];
+    while (q < 4 && seen >= quantiles[q] * total)
+      out << ", " << names[q++] << " " << bucketFloor(b);
+  }
+  out << ", max " << bucketFloor(last) << std::endl;
+}
+
+int Analytics::run(std::vector<char const*> const& paths, unsigned threads, size_t top, std::ostream& out) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::vector<ApduFile> files(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i)
+    if (files[i].open(paths[i]))
+      return 1;
+
+  struct Session {
+    byte_t const* data;
+    size_t size;
+  } s;
+  std::vector<Session> sessions;
+  for (ApduFile& file : files)
+    while (file.nextSession(s.data, s.size))
+      sessions.push_back(s);
+
+  if (threads < 1)
+    threads = 1;
+  std::vector<Stats> stats(threads);
+  size_t const chunkSessions = 1024;
+
+  WorkPool::run((sessions.size() + chunkSessions - 1) / chunkSessions, threads,
+		[&] (size_t chunk, unsigned thread, ChunkOutput&) {
+		  Stats& local = stats[thread];
+		  std::vector<PaylogEntry> entries;
+		  size_t last = std::min(sessions.size(), (chunk + 1) * chunkSessions);
+
+		  for (size_t i = chunk * chunkSessions; i < last; ++i) {
+		    entries.clear();
+		    size_t count = PaylogScan::scan(sessions[i].data, sessions[i].size, entries);
+		    local.cards++;
+		    local.logCounts[std::min<size_t>(count, local.logCounts.size() - 1)]++;
+		    for (PaylogEntry const& e : entries)
+		      local.add(e);
+		  }
+		},
+		[] (size_t, ChunkOutput&) {});
+
+  Stats& total = stats[0];
+  for (unsigned i = 1; i < threads; ++i)
+    total.merge(stats[i]);
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  out << "-- Paylog analytics --" << std::endl;
+  out << total.cards << " card(s), " << total.entries << " paylog entries in " << elapsed << "s" << std::endl;
+  printMerchants(out, total.merchants, top);
+  printSpend(out, "Countries", total.countries, top, false, countryName);
+  printSpend(out, "Currencies", total.currencies, 0, false, noName);
+  printSpend(out, "Days", total.days, 0, true, dayName);
+  printSpend(out, "Types", total.types, 0, false, typeName);
+
+  out << "-----------------" << std::endl;
+  out << "-- Distributions --" << std::endl;
+  out << "-----------------" << std::endl;
+  printAmounts(out, total.amounts, total.entries);
+  out << "Log count (cards per number of entries):";
+  for (size_t i = 0; i < total.logCounts.size(); ++i)
+    if (total.logCounts[i])
+      out << " " << i << (i + 1 == total.logCounts.size() ? "+" : "") << ": " << total.logCounts[i];
+  out << std::endl;
+  return 0;
+}
@@ -0,0 +1,40 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __ANALYTICS_HH__
+# define __ANALYTICS_HH__
+
+#include <vector>
+#include <iostream>
+
+/* Paylog statistics over recorded APDU files: spend per merchant, country, currency, day and type,
+   amount and log count distributions. Sessions are scanned on a WorkPool, each thread aggregates
+   into its own hash tables, merged at the end. Amounts are only added up within one currency.
+*/
+class Analytics {
+
+public:
+  static int run(std::vector<char const*> const& paths, unsigned threads, size_t top,
+		 std::ostream& out = std::cout);
+};
+
+#endif // __ANALYTICS_HH__
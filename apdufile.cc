@@ -0,0 +1,157 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "apdufile.hh"
+
+const char ApduFile::_MAGIC[8] = {'R', 'C', 'C', 'A', 'P', 'D', 'U', '1'};
+
+ApduFile::ApduFile()
+  : _data(NULL),
+    _size(0),
+    _offset(0)
+{
+}
+
+ApduFile::~ApduFile() {
+  close();
+}
+
+int ApduFile::open(char const* path) {
+  close();
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return 1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(_MAGIC)) {
+    std::cerr << path << ": not an APDU file" << std::endl;
+    ::close(fd);
+    return 1;
+  }
+
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    perror(path);
+    return 1;
+  }
+
+  if (memcmp(map, _MAGIC, sizeof(_MAGIC))) {
+    std::cerr << path << ": not an APDU file" << std::endl;
+    munmap(map, st.st_size);
+    return 1;
+  }
+
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+  _data = (byte_t const*)map;
+  _size = st.st_size;
+  _offset = sizeof(_MAGIC);
+  return 0;
+}
+
+void ApduFile::close() {
+  if (_data)
+    munmap((void*)_data, _size);
+  _data = NULL;
+  _size = 0;
+  _offset = 0;
+}
+
+void ApduFile::rewind() {
+  _offset = sizeof(_MAGIC);
+}
+
+// Offset of the next session in the file
+size_t ApduFile::tell() const {
+  return _offset;
+}
+
+void ApduFile::seek(size_t offset) {
+  _offset = std::min(std::max(offset, sizeof(_MAGIC)), _size);
+}
+
+bool ApduFile::isSessionStart(byte_t const* command, size_t size) {
+  return size == sizeof(Command::START_14443A) && command[0] == Command::START_14443A[0];
+}
+
+// Returns false at the end of the buffer or on a truncated exchange
+bool ApduFile::nextExchange(byte_t const*& cursor, byte_t const* end, Exchange& exchange) {
+  if (end - cursor < 4)
+    return false;
+
+  exchange.szCommand = cursor[0] | cursor[1] << 8;
+  exchange.szResponse = cursor[2] | cursor[3] << 8;
+  if ((size_t)(end - cursor) < 4 + exchange.szCommand + exchange.szResponse)
+    return false;
+
+  exchange.command = cursor + 4;
+  exchange.response = exchange.command + exchange.szCommand;
+  cursor = exchange.response + exchange.szResponse;
+  return true;
+}
+
+// The session runs until the next START 14443A
+bool ApduFile::nextSession(byte_t const*& session, size_t& size) {
+  byte_t const* cursor = _data + _offset;
+  byte_t const* end = _data + _size;
+  byte_t const* last = cursor;
+  Exchange exchange;
+
+  if (!nextExchange(cursor, end, exchange))
+    return false;
+
+  session = last;
+  last = cursor;
+  while (nextExchange(cursor, end, exchange) &&
+	 !isSessionStart(exchange.command, exchange.szCommand))
+    last = cursor;
+
+  size = last - session;
+  _offset = last - _data;
+  return true;
+}
+
+void ApduFile::writeHeader(FILE* file) {
+  fwrite(_MAGIC, sizeof(_MAGIC), 1, file);
+}
+
+void ApduFile::writeExchange(FILE* file,
+			     byte_t const* command, size_t szCommand,
+			     byte_t const* response, size_t szResponse) {
+  byte_t const header[4] = {(byte_t)szCommand, (byte_t)(szCommand >> 8),
+			    (byte_t)szResponse, (byte_t)(szResponse >> 8)};
+  fwrite(header, sizeof(header), 1, file);
+  fwrite(command, 1, szCommand, file);
+  fwrite(response, 1, szResponse, file);
+}
@@ -0,0 +1,71 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __APDUFILE_HH__
+# define __APDUFILE_HH__
+
+#include <cstdio>
+
+#include "tools.hh"
+
+struct Exchange {
+  byte_t const* command;
+  size_t szCommand;
+  byte_t const* response; // Status word included, no PN532 status byte
+  size_t szResponse;
+};
+
+/* Recorded card exchanges, used by the synthetic corpus and recorded traces.
+   After an 8-byte magic, each exchange is stored as
+   command length (2 bytes LE) | response length (2 bytes LE) | command | response.
+   A session (one card in the field) starts with a START 14443A exchange.
+*/
+class ApduFile {
+
+public:
+  ApduFile();
+  ~ApduFile();
+
+public:
+  int open(char const* path);
+  void close();
+  void rewind();
+  size_t tell() const;
+  void seek(size_t offset);
+  bool nextSession(byte_t const*& session, size_t& size);
+
+  static bool nextExchange(byte_t const*& cursor, byte_t const* end, Exchange& exchange);
+  static bool isSessionStart(byte_t const* command, size_t size);
+  static void writeHeader(FILE* file);
+  static void writeExchange(FILE* file,
+			    byte_t const* command, size_t szCommand,
+			    byte_t const* response, size_t szResponse);
+
+private:
+  byte_t const* _data;
+  size_t _size;
+  size_t _offset;
+
+  static const char _MAGIC[8];
+};
+
+#endif // __APDUFILE_HH__
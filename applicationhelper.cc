@@ -24,6 +24,7 @@
 #include <iostream>
 #include <iomanip>
 #include <cstring>
+#include <algorithm>
 
 extern "C" {
 #include <nfc/nfc.h>
@@ -36,9 +37,45 @@ extern "C" {
 
 #include "applicationhelper.hh"
 #include "tools.hh"
+#include "trace.hh"
+#include "apdufile.hh"
+#include "readerhealth.hh"
 
-byte_t ApplicationHelper::abtRx[MAX_FRAME_LEN];
-int ApplicationHelper::szRx;
+thread_local byte_t ApplicationHelper::abtRx[MAX_FRAME_LEN];
+thread_local int ApplicationHelper::szRx;
+thread_local Transceiver ApplicationHelper::transceiver = ApplicationHelper::pn53xTransceive;
+thread_local int ApplicationHelper::timeout = 0;
+thread_local int ApplicationHelper::retries = 0;
+FILE* ApplicationHelper::recorder = NULL;
+
+int ApplicationHelper::pn53xTransceive(byte_t const* tx, size_t szTx, byte_t* rx, size_t szRx, int timeout) {
+  int ret = pn53x_transceive(pnd, tx, szTx, rx, szRx, timeout);
+  ReaderHealth::report(ret, tx[0] != Command::IN_DATA_EXCHANGE);
+  return ret;
+}
+
+// For the calling thread only. Returns the previous transceiver so it can be restored
+Transceiver ApplicationHelper::setTransceiver(Transceiver t) {
+  Transceiver old = transceiver;
+  transceiver = t ? t : pn53xTransceive;
+  return old;
+}
+
+// Every following exchange is appended to the APDU file, a failed one with an empty answer
+void ApplicationHelper::setRecorder(FILE* file) {
+  recorder = file;
+}
+
+void ApplicationHelper::setPolicy(int t, int r) {
+  timeout = t;
+  retries = r;
+}
+
+// Touch the receive buffer so the first APDU does not take a page fault
+void ApplicationHelper::prefaultBuffers() {
+  memset(abtRx, 0, sizeof(abtRx));
+  szRx = 0;
+}
 
 bool ApplicationHelper::checkTrailer() {
   if (szRx < 2)
@@ -50,7 +87,7 @@ bool ApplicationHelper::checkTrailer() {
   return true;
 }
 
-AppList ApplicationHelper::getAll() {
+AppList ApplicationHelper::getAll(std::ostream& log) {
   AppList list;
 
   // SELECT PPSE to retrieve all applications
@@ -61,41 +98,55 @@ AppList ApplicationHelper::getAll() {
     return list;
 
   /* szRx and abtRx are the same as the return value,
-     we can use them directly as long as the software is not multithreated
+     we can use them directly as they are per thread.
+     The FCI is walked TLV by TLV: a length byte of 0x61 is not an application template.
   */
-  for (size_t i = 0; i < szRx; ++i) {
-    if (abtRx[i] == 0x61) { // Application template
+  size_t last = szRx - 2; // Without the status word
+  for (size_t i = 1; i + 1 < last; ) {
+    unsigned short outer = abtRx[i++];
+    if ((outer & 0x1F) == 0x1F)
+      outer = outer << 8 | abtRx[i++];
+    size_t length = abtRx[i++];
+    if (length == 0x81 && i < last)
+      length = abtRx[i++];
+
+    if (outer == 0x6F || outer == 0xA5 || outer == 0xBF0C) // FCI templates, step in
+      continue;
+    size_t end = std::min<size_t>(i + length, last);
+    if (outer != 0x61) {
+      i = end;
+      continue;
+    }
+
+    { // Application template
       Application app;
-      ++i;
-      while (i < szRx && abtRx[i] != 0x61) { // until the end of the buffer or the next entry
+      memset(&app, 0, sizeof(app));
+
+      // Walk the template TLV by TLV so label or AID bytes are never taken for tags
+      while (i + 1 < end) {
+	unsigned short tag = abtRx[i++];
+	if ((tag & 0x1F) == 0x1F) // 2-byte tag, e.g. 9F12 preferred name
+	  tag = tag << 8 | abtRx[i++];
+	byte_t len = abtRx[i++];
+	if (i + len > end)
+	  len = end - i;
 
-	if (abtRx[i] == 0x4F) { // Application ID
-	  byte_t len = abtRx[++i];
-	  i++;
-	  
+	if (tag == 0x4F) { // Application ID
 	  if (len != 7)
-	    std::cerr << "Application id larger then 7 bytes, wtf. Continue anyway. Its gonna crash" << std::endl;
-	  memcpy(app.aid, &abtRx[i], len);
-	  i += len - 1;
+	    log << "Application id larger then 7 bytes, wtf. Continue anyway." << std::endl;
+	  memcpy(app.aid, &abtRx[i], std::min<size_t>(len, sizeof(app.aid)));
 	}
-
-	if (abtRx[i] == 0x87) { // Application Priority indicator
-	  i += 2;
+	else if (tag == 0x87 && len > 0) // Application Priority indicator
 	  app.priority = abtRx[i];
+	else if (tag == 0x50) { // Application label
+	  size_t copy = std::min<size_t>(len, sizeof(app.name) - 1);
+	  memcpy(app.name, &abtRx[i], copy);
+	  app.name[copy] = 0;
 	}
-	++i;
-
-	if (abtRx[i] == 0x50) { // Application label
-	  byte_t len = abtRx[++i];
-	  i++;
-	  memcpy(app.name, &abtRx[i], len);
-	  app.name[len] = 0;
-	  i += len - 1;
-	}
-	
+	i += len;
       }
       list.push_back(app);
-      --i;
+      i = end;
     }
   }
 
@@ -138,20 +189,46 @@ APDU ApplicationHelper::selectByPriority(AppList const& list, byte_t priority) {
   return executeCommand(select_app, size, "SELECT APP");
 }
 
+void ApplicationHelper::transmit(byte_t const* command, size_t size, char const* name) {
+  for (int attempt = 0; ; ++attempt) {
+    szRx = transceiver(command, size, abtRx, sizeof(abtRx), timeout);
+    if (Trace::enabled(Trace::APDU))
+      Trace::record(name, command, size, abtRx, szRx);
+    if (recorder)
+      ApduFile::writeExchange(recorder, command, size, abtRx + 1, szRx > 0 ? szRx - 1 : 0);
+
+    if (szRx >= 0 || attempt >= retries)
+      break;
+  }
+}
+
 APDU ApplicationHelper::executeCommand(byte_t const* command, size_t size, char const* name) {
-  szRx = pn53x_transceive(pnd,
-			  command, size,
-			  abtRx, sizeof(abtRx),
-			  0);
-#ifdef DEBUG
-  if (szRx > 0) {
-    Tools::printHex(abtRx + 1, szRx - 1, std::string(std::string("Answer from ") + name));
-    //    Tools::printChar(abtRx, szRx, std::string(std::string("Answer from ") + name));
+  transmit(command, size, name);
+
+  // ISO 7816-4 procedure bytes: 6Cxx asks to resend with Le = xx,
+  // 61xx announces xx bytes to fetch with GET RESPONSE
+  if (szRx >= 3 && command[0] == Command::IN_DATA_EXCHANGE) {
+    byte_t sw1 = abtRx[szRx - 2];
+    byte_t sw2 = abtRx[szRx - 1];
+
+    if (sw1 == 0x6C) {
+      byte_t resend[MAX_FRAME_LEN];
+      memcpy(resend, command, size);
+      resend[size - 1] = sw2;
+      transmit(resend, size, name);
+    }
+    else if (sw1 == 0x61) {
+      byte_t getResponse[sizeof(Command::GET_RESPONSE)];
+      memcpy(getResponse, Command::GET_RESPONSE, sizeof(getResponse));
+      getResponse[sizeof(getResponse) - 1] = sw2;
+      transmit(getResponse, sizeof(getResponse), "GET RESPONSE");
+    }
   }
-#endif
 
   if (szRx < 0 || checkTrailer()) {
-    if (szRx < 0)
+    // No card in the field before the timeout is not worth a line
+    bool polling = command[0] != Command::IN_DATA_EXCHANGE;
+    if (szRx < 0 && pnd && !(polling && szRx == NFC_ETIMEOUT))
       nfc_perror(pnd, name);
     return {0, {0}};
   }
@@ -162,6 +239,18 @@ APDU ApplicationHelper::executeCommand(byte_t const* command, size_t size, char
   return ret;
 }
 
+// Status word of the last answer, 0 if the exchange failed
+unsigned short ApplicationHelper::lastStatus() {
+  if (szRx < 3)
+    return 0;
+  return abtRx[szRx - 2] << 8 | abtRx[szRx - 1];
+}
+
+// Whether the last START 14443A found a card: its answer starts with the number of targets
+bool ApplicationHelper::targetFound() {
+  return szRx > 0 && abtRx[0] > 0;
+}
+
 void ApplicationHelper::printList(AppList const& list) {
   std::cout << list.size() << " Application(s) found:" << std::endl;
 
@@ -25,23 +25,42 @@
 
 #include <list>
 #include <cstdio>
+#include <iostream>
 
 #include "tools.hh"
 
 typedef std::list<Application> AppList;
 
+// Low level exchange with the card: returns the number of bytes written in rx or < 0 on error
+typedef int (*Transceiver)(byte_t const* tx, size_t szTx, byte_t* rx, size_t szRx, int timeout);
+
 class ApplicationHelper {
 
 public:
   static bool checkTrailer();
-  static AppList getAll();
+  static AppList getAll(std::ostream& log = std::cerr);
   static void printList(AppList const& list);
   static APDU selectByPriority(AppList const& list, byte_t priority);
   static APDU executeCommand(byte_t const* command, size_t size, char const* name);
+  static unsigned short lastStatus();
+  static bool targetFound();
+
+  static Transceiver setTransceiver(Transceiver); // NULL = the NFC device
+  static void setRecorder(FILE* file);
+  static void setPolicy(int timeout, int retries); // For the calling thread
+  static void prefaultBuffers();
 
 private:
-  static byte_t abtRx[MAX_FRAME_LEN];
-  static int szRx;
+  static void transmit(byte_t const* command, size_t size, char const* name);
+  static int pn53xTransceive(byte_t const* tx, size_t szTx, byte_t* rx, size_t szRx, int timeout);
+
+  static thread_local Transceiver transceiver;
+  static thread_local int timeout; // ms, 0 waits forever
+  static thread_local int retries; // Extra attempts when the transceive fails
+  static FILE* recorder; // APDU file receiving every exchange, NULL if none
+  // One exchange buffer per thread so offline decoding can run in parallel
+  static thread_local byte_t abtRx[MAX_FRAME_LEN];
+  static thread_local int szRx;
 };
 
 #endif // __APPLICATIONHELPER_HH__
@@ -0,0 +1,291 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bintable.hh"
+#include "ccinfo.hh"
+
+const char BinTable::_MAGIC[8] = {'R', 'C', 'C', 'B', 'I', 'N', 'S', '1'};
+
+struct BinHeader {
+  char magic[8];
+  unsigned long long ranges;
+  unsigned long long stringsBytes;
+  byte_t pad[40]; // The keys start on a cache line
+};
+
+struct BinSource {
+  unsigned long long first;
+  unsigned long long last;
+  BinTable::Range range;
+};
+
+BinTable::BinTable()
+  : _map(NULL),
+    _size(0),
+    _count(0)
+{
+}
+
+BinTable::~BinTable() {
+  if (_map)
+    munmap(_map, _size);
+}
+
+// First 12 digits as a number, shorter prefixes padded with pad. 0 if there is not a digit
+unsigned long long BinTable::key(char const* digits, char pad) {
+  unsigned long long value = 0;
+  size_t n = 0;
+  for (; n < _KEY_DIGITS && digits[n] >= '0' && digits[n] <= '9'; ++n)
+    value = value * 10 + (digits[n] - '0');
+  if (n == 0)
+    return 0;
+  for (; n < _KEY_DIGITS; ++n)
+    value = value * 10 + (pad - '0');
+  return value;
+}
+
+// ISO 3166 numeric code, stored as in paylogs (250 -> 0x250), or one of the alpha-3 names readcc knows
+static unsigned short countryCode(std::string const& text) {
+  if (text.size() == 3 && isdigit((unsigned char)text[0]) && isdigit((unsigned char)text[1])
+      && isdigit((unsigned char)text[2]))
+    return (text[0] - '0') << 8 | (text[1] - '0') << 4 | (text[2] - '0');
+  return CCInfo::countryCode(text.data(), text.size());
+}
+
+static unsigned internString(std::string const& text, std::string& strings,
+			     std::unordered_map<std::string, unsigned>& offsets) {
+  std::unordered_map<std::string, unsigned>::const_iterator it = offsets.find(text);
+  if (it != offsets.end())
+    return it->second;
+  unsigned offset = strings.size();
+  strings.append(text.c_str(), text.size() + 1);
+  offsets[text] = offset;
+  return offset;
+}
+
+// In order walk of the implicit tree: the sorted ranges land in Eytzinger order
+static void layout(std::vector<BinSource> const& sorted, size_t& next, size_t k,
+		   std::vector<unsigned long long>& lasts, std::vector<BinTable::Range>& ranges) {
+  if (k > sorted.size())
+    return;
+  layout(sorted, next, 2 * k, lasts, ranges);
+  lasts[k] = sorted[next].last;
+  ranges[k] = sorted[next].range;
+  ++next;
+  layout(sorted, next, 2 * k + 1, lasts, ranges);
+}
+
+int BinTable::build(char const* source, char const* path) {
+  std::ifstream in(source);
+  if (!in) {
+    perror(source);
+    return 1;
+  }
+
+  std::vector<BinSource> sorted;
+  std::string strings(1, 0); // Offset 0 is the empty string
+  std::unordered_map<std::string, unsigned> offsets;
+  offsets[""] = 0;
+  std::string line;
+  size_t number = 0, rejected = 0;
+  while (std::getline(in, line)) {
+    ++number;
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::string columns[6];
+    size_t c = 0, start = 0;
+    for (size_t tab; c < 5 && (tab = line.find('\t', start)) != std::string::npos; start = tab + 1)
+      columns[c++] = line.substr(start, tab - start);
+    columns[c++] = line.substr(start);
+    if (!line.empty() && *line.rbegin() == '\r')
+      columns[c - 1].erase(columns[c - 1].size() - 1);
+
+    BinSource s;
+    s.first = key(columns[0].c_str(), '0');
+    s.last = key(columns[1].c_str(), '9');
+    if (c < 6 || s.first == 0 || s.last == 0 || s.last < s.first) {
+      std::cerr << source << ":" << number << ": expected first, last, brand, type, country and issuer" << std::endl;
+      return 1;
+    }
+    memset(&s.range, 0, sizeof(s.range));
+    s.range.first = s.first;
+    s.range.brand = internString(columns[2], strings, offsets);
+    s.range.type = internString(columns[3], strings, offsets);
+    s.range.country = countryCode(columns[4]);
+    s.range.issuer = internString(columns[5], strings, offsets);
+    sorted.push_back(s);
+  }
+
+  // Of overlapping ranges, the one starting first is kept
+  std::stable_sort(sorted.begin(), sorted.end(),
+		   [] (BinSource const& a, BinSource const& b) { return a.first < b.first; });
+  size_t kept = 0;
+  for (size_t i = 0; i < sorted.size(); ++i)
+    if (kept == 0 || sorted[i].first > sorted[kept - 1].last)
+      sorted[kept++] = sorted[i];
+    else
+      ++rejected;
+  sorted.resize(kept);
+
+  std::vector<unsigned long long> lasts(sorted.size() + 1, 0);
+  std::vector<Range> ranges(sorted.size() + 1);
+  memset(ranges.data(), 0, ranges.size() * sizeof(Range));
+  size_t next = 0;
+  layout(sorted, next, 1, lasts, ranges);
+
+  BinHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, _MAGIC, sizeof(_MAGIC));
+  header.ranges = sorted.size();
+  header.stringsBytes = strings.size();
+
+  // A running reader keeps the table it mapped, the new one replaces it whole
+  std::string tmp = std::string(path) + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "wb");
+  if (file == NULL) {
+    perror(tmp.c_str());
+    return 1;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1
+    && fwrite(lasts.data(), sizeof(unsigned long long), lasts.size(), file) == lasts.size()
+    && fwrite(ranges.data(), sizeof(Range), ranges.size(), file) == ranges.size()
+    && fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+  if (fclose(file) != 0 || !written || rename(tmp.c_str(), path) != 0) {
+    perror(path);
+    return 1;
+  }
+
+  std::cerr << sorted.size() << " range(s), " << rejected << " overlapping range(s) left out, "
+	    << offsets.size() - 1 << " distinct strings, "
+	    << sizeof(header) + lasts.size() * sizeof(unsigned long long) + ranges.size() * sizeof(Range) + strings.size()
+	    << " bytes" << std::endl;
+
+  BinTable table;
+  if (table.open(path))
+    return 1;
+  table.bench(1 << 22);
+  return 0;
+}
+
+int BinTable::open(char const* path) {
+  int fd = ::open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    perror(path);
+    if (fd >= 0)
+      ::close(fd);
+    return 1;
+  }
+  _map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (_map == MAP_FAILED) {
+    _map = NULL;
+    perror(path);
+    return 1;
+  }
+  _size = st.st_size;
+
+  BinHeader const* header = (BinHeader const*)_map;
+  if (_size < sizeof(BinHeader) || memcmp(header->magic, _MAGIC, sizeof(_MAGIC))) {
+    std::cerr << path << ": not a BIN table" << std::endl;
+    return 1;
+  }
+
+  _count = header->ranges;
+  _lasts = (unsigned long long const*)(header + 1);
+  _ranges = (Range const*)(_lasts + _count + 1);
+  _strings = (char const*)(_ranges + _count + 1);
+  if ((size_t)(_strings + header->stringsBytes - (char const*)_map) != _size || header->stringsBytes == 0
+      || _strings[header->stringsBytes - 1] != 0) {
+    std::cerr << path << ": truncated BIN table" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+bool BinTable::lookup(char const* pan, BinInfo& info) const {
+  unsigned long long k = key(pan, '0');
+  size_t i = 1;
+  while (i <= _count) {
+    __builtin_prefetch(_lasts + 8 * i);
+    i = 2 * i + (_lasts[i] < k);
+  }
+  // Back up over the right turns taken after the last left one: there is the first last key >= k
+  i >>= __builtin_ffsll(~i);
+
+  if (i == 0 || k == 0 || k < _ranges[i].first) {
+    memset(&info, 0, sizeof(info));
+    return false;
+  }
+  Range const& r = _ranges[i];
+  info.issuer = _strings + r.issuer;
+  info.brand = _strings + r.brand;
+  info.type = _strings + r.type;
+  info.country = r.country;
+  return true;
+}
+
+// Random PANs, half of them drawn inside the ranges
+void BinTable::bench(size_t lookups, std::ostream& out) const {
+  if (_count == 0)
+    return;
+
+  std::mt19937_64 rng(1);
+  std::vector<char> pans(lookups * 20);
+  for (size_t i = 0; i < lookups; ++i) {
+    unsigned long long value;
+    if (i & 1)
+      value = rng() % 10000000000000000ULL;
+    else {
+      Range const& r = _ranges[1 + rng() % _count];
+      value = r.first * 10000 + rng() % 10000;
+    }
+    snprintf(&pans[i * 20], 20, "%016llu", value);
+  }
+
+  BinInfo info;
+  size_t hits = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < lookups; ++i)
+    hits += lookup(&pans[i * 20], info);
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  out << lookups << " lookup(s), " << hits << " hit(s), " << elapsed * 1e9 / lookups << " ns per lookup"
+      << std::endl;
+}
@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+
+#ifndef __BINTABLE_HH__
+# define __BINTABLE_HH__
+
+#include <iostream>
+
+#include "tools.hh"
+
+// Issuer of a PAN, strings from the mapped table
+struct BinInfo {
+  char const* issuer; // NULL if the PAN is in no range
+  char const* brand;
+  char const* type; // debit, credit, prepaid...
+  unsigned short country; // ISO 3166 code as stored in paylogs (0x250 = FRA), 0 if unknown
+};
+
+/* BIN (IIN) ranges: issuer, brand, card type and country of PAN prefixes, for --bin-table.
+   A range is keyed by the first 12 digits of the PAN, shorter bounds padded with 0 for the first PAN
+   and with 9 for the last one. Ranges do not overlap, so the one holding a PAN is the first whose last
+   key is not below the PAN's.
+   The last keys are stored in Eytzinger order (the sorted array as an implicit binary tree, breadth
+   first, from index 1) and the ranges in the same order: the top levels share a few cache lines, and
+   the 8 descendants three levels down fill one line, prefetched while the search goes down.
+   The file is mapped and used in place. It is built from tab separated lines
+     first  last  brand  type  country  issuer
+   with the country as its ISO 3166 numeric code (or an alpha-3 name known to CCInfo); '#' starts a comment.
+*/
+class BinTable {
+
+public:
+  BinTable();
+  ~BinTable();
+
+public:
+  static int build(char const* source, char const* path);
+
+  int open(char const* path);
+  bool lookup(char const* pan, BinInfo& info) const;
+  size_t size() const { return _count; }
+  void bench(size_t lookups, std::ostream& out = std::cerr) const;
+
+  static unsigned long long key(char const* digits, char pad);
+
+public:
+  struct Range {
+    unsigned long long first;
+    unsigned int issuer; // Offsets of NUL terminated strings
+    unsigned int brand;
+    unsigned int type;
+    unsigned short country;
+    unsigned short pad;
+  };
+
+private:
+  void* _map;
+  size_t _size;
+  size_t _count;
+  unsigned long long const* _lasts; // Eytzinger order, from 1
+  Range const* _ranges; // Same order
+  char const* _strings;
+
+  static const char _MAGIC[8];
+  static const size_t _KEY_DIGITS = 12;
+};
+
+#endif // __BINTABLE_HH__
@@ -0,0 +1,130 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstring>
+#include <vector>
+
+#include "blockcodec.hh"
+
+static unsigned read32(byte_t const* p) {
+  unsigned value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static void putLength(std::string& out, size_t length) {
+  for (; length >= 0xFF; length -= 0xFF)
+    out += (char)0xFF;
+  out += (char)length;
+}
+
+static void putSequence(std::string& out, byte_t const* literals, size_t literalLength, size_t offset,
+			size_t matchLength) {
+  size_t match = matchLength ? matchLength - 4 : 0;
+  out += (char)(std::min<size_t>(literalLength, 15) << 4 | std::min<size_t>(match, 15));
+  if (literalLength >= 15)
+    putLength(out, literalLength - 15);
+  out.append((char const*)literals, literalLength);
+  if (!matchLength)
+    return;
+  out += (char)offset;
+  out += (char)(offset >> 8);
+  if (match >= 15)
+    putLength(out, match - 15);
+}
+
+void BlockCodec::compress(byte_t const* data, size_t size, std::string& out) {
+  static thread_local std::vector<unsigned> table;
+  table.assign(1 << _HASH_BITS, ~0u);
+
+  size_t anchor = 0;
+  size_t i = 0;
+  while (i + _MIN_MATCH <= size) {
+    unsigned value = read32(data + i);
+    unsigned h = (value * 2654435761u) >> (32 - _HASH_BITS);
+    size_t candidate = table[h];
+    table[h] = i;
+
+    if (candidate == ~0u || i - candidate > _MAX_OFFSET || read32(data + candidate) != value) {
+      // Longer runs without a match are skipped faster
+      i += 1 + ((i - anchor) >> 6);
+      continue;
+    }
+
+    size_t length = _MIN_MATCH;
+    while (i + length < size && data[candidate + length] == data[i + length])
+      ++length;
+    putSequence(out, data + anchor, i - anchor, i - candidate, length);
+    i += length;
+    anchor = i;
+  }
+  putSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+bool BlockCodec::decompress(byte_t const* data, size_t size, byte_t* out, size_t outSize) {
+  byte_t const* end = data + size;
+  byte_t* o = out;
+  byte_t* const oend = out + outSize;
+
+  auto length = [&data, end] (size_t value) {
+    if (value == 15)
+      for (byte_t b = 0xFF; b == 0xFF && data < end; value += b)
+	b = *data++;
+    return value;
+  };
+
+  while (data < end) {
+    byte_t token = *data++;
+    size_t literals = length(token >> 4);
+    if (literals > (size_t)(end - data) || literals > (size_t)(oend - o))
+      return false;
+    // Short copies are done 16 bytes at a time when both buffers have the room
+    if (literals <= 16 && end - data >= 16 && oend - o >= 16)
+      memcpy(o, data, 16);
+    else
+      memcpy(o, data, literals);
+    o += literals;
+    data += literals;
+    if (data == end)
+      break;
+
+    if (end - data < 2)
+      return false;
+    size_t offset = data[0] | data[1] << 8;
+    data += 2;
+    size_t match = length(token & 0x0F) + _MIN_MATCH;
+    if (offset == 0 || offset > (size_t)(o - out) || match > (size_t)(oend - o))
+      return false;
+
+    byte_t const* from = o - offset;
+    if (offset >= 16 && (size_t)(oend - o) >= match + 16)
+      for (size_t k = 0; k < match; k += 16)
+	memcpy(o + k, from + k, 16);
+    else if (offset >= match)
+      memcpy(o, from, match);
+    else
+      for (size_t k = 0; k < match; ++k) // Overlapping copy repeats the last offset bytes
+	o[k] = from[k];
+    o += match;
+  }
+  return o == oend;
+}
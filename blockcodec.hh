@@ -0,0 +1,49 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __BLOCKCODEC_HH__
+# define __BLOCKCODEC_HH__
+
+#include <string>
+
+#include "tools.hh"
+
+/* Byte oriented LZ77 block codec, in the spirit of LZ4: fast to decode, no entropy stage.
+   A block is a list of sequences
+     token | extra literal length | literals | match offset (2, LE) | extra match length
+   The token holds the literal length in its high nibble and the match length minus 4 in its low one,
+   15 meaning that bytes follow, added up until one is below 255. The last sequence has literals only.
+*/
+class BlockCodec {
+
+public:
+  static void compress(byte_t const* data, size_t size, std::string& out); // Appended to out
+  static bool decompress(byte_t const* data, size_t size, byte_t* out, size_t outSize); // Exactly outSize
+
+private:
+  static const size_t _MIN_MATCH = 4;
+  static const size_t _MAX_OFFSET = 0xFFFF;
+  static const unsigned _HASH_BITS = 14;
+};
+
+#endif // __BLOCKCODEC_HH__
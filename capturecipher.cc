@@ -0,0 +1,373 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+
+#include "capturecipher.hh"
+#include "apdufile.hh"
+
+static const char CIPHER_MAGIC[8] = {'R', 'C', 'C', 'E', 'N', 'C', '0', '1'};
+static const size_t CHUNK_BYTES = 1 << 20;
+static const unsigned long long SEGMENT_BYTES = 1ull << 30;
+static const size_t IV_SIZE = 12;
+static const size_t TAG_SIZE = 16;
+static const size_t PREFIX_SIZE = 4;
+static const size_t SEGMENT_RECORD = 1 + IV_SIZE + CaptureCipher::KEY_SIZE + TAG_SIZE + PREFIX_SIZE;
+static const size_t CHUNK_HEADER = 1 + 4 + TAG_SIZE;
+
+struct CipherStream {
+  int fd;
+  EVP_CIPHER_CTX* ctx;
+  byte_t master[CaptureCipher::KEY_SIZE];
+  byte_t prefix[PREFIX_SIZE];
+  bool segment; // A segment was started
+  unsigned long long chunk; // Index in the segment
+  unsigned long long segmentBytes;
+  std::vector<byte_t> sealed;
+};
+
+static bool writeAll(int fd, void const* data, size_t size) {
+  for (size_t written = 0; written < size; ) {
+    ssize_t n = write(fd, (char const*)data + written, size - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    written += n;
+  }
+  return true;
+}
+
+static void nonce(byte_t const prefix[PREFIX_SIZE], unsigned long long chunk, byte_t iv[IV_SIZE]) {
+  memcpy(iv, prefix, PREFIX_SIZE);
+  for (size_t i = 0; i < 8; ++i)
+    iv[PREFIX_SIZE + i] = chunk >> (8 * i);
+}
+
+// New data key, wrapped by the master key with the nonce prefix as additional data
+static bool startSegment(CipherStream& s) {
+  byte_t key[CaptureCipher::KEY_SIZE];
+  byte_t record[SEGMENT_RECORD];
+  byte_t* iv = record + 1;
+  byte_t* wrapped = iv + IV_SIZE;
+  byte_t* tag = wrapped + sizeof(key);
+  int length;
+
+  record[0] = 'S';
+  bool ok = RAND_bytes(key, sizeof(key)) == 1 && RAND_bytes(s.prefix, sizeof(s.prefix)) == 1
+    && RAND_bytes(iv, IV_SIZE) == 1
+    && EVP_EncryptInit_ex(s.ctx, EVP_aes_256_gcm(), NULL, s.master, iv) == 1
+    && EVP_EncryptUpdate(s.ctx, NULL, &length, s.prefix, sizeof(s.prefix)) == 1
+    && EVP_EncryptUpdate(s.ctx, wrapped, &length, key, sizeof(key)) == 1
+    && EVP_EncryptFinal_ex(s.ctx, wrapped + length, &length) == 1
+    && EVP_CIPHER_CTX_ctrl(s.ctx, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag) == 1;
+  memcpy(tag + TAG_SIZE, s.prefix, sizeof(s.prefix));
+
+  // The data key is set once, chunks only change the IV
+  ok = ok && writeAll(s.fd, record, sizeof(record))
+    && EVP_EncryptInit_ex(s.ctx, EVP_aes_256_gcm(), NULL, key, NULL) == 1;
+  OPENSSL_cleanse(key, sizeof(key));
+
+  s.segment = true;
+  s.chunk = 0;
+  s.segmentBytes = 0;
+  return ok;
+}
+
+static bool seal(CipherStream& s, byte_t const* plain, size_t size) {
+  if ((!s.segment || s.segmentBytes >= SEGMENT_BYTES) && !startSegment(s))
+    return false;
+
+  byte_t iv[IV_SIZE];
+  int length, final;
+  nonce(s.prefix, s.chunk, iv);
+
+  s.sealed.resize(CHUNK_HEADER + size);
+  byte_t* header = s.sealed.data();
+  header[0] = 'C';
+  for (size_t i = 0; i < 4; ++i)
+    header[1 + i] = size >> (8 * i);
+  byte_t* tag = header + 5;
+  byte_t* cipher = header + CHUNK_HEADER;
+
+  bool ok = EVP_EncryptInit_ex(s.ctx, NULL, NULL, NULL, iv) == 1
+    && EVP_EncryptUpdate(s.ctx, cipher, &length, plain, size) == 1
+    && EVP_EncryptFinal_ex(s.ctx, cipher + length, &final) == 1
+    && EVP_CIPHER_CTX_ctrl(s.ctx, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag) == 1
+    && writeAll(s.fd, s.sealed.data(), s.sealed.size());
+
+  s.chunk++;
+  s.segmentBytes += size;
+  return ok;
+}
+
+// Called by stdio when its buffer is full or flushed: bulk writes come in 64 KB, and the fflush
+// after each card seals it right away
+static ssize_t cipherWrite(void* cookie, char const* data, size_t size) {
+  CipherStream& s = *(CipherStream*)cookie;
+  for (size_t offset = 0; offset < size; offset += CHUNK_BYTES)
+    if (!seal(s, (byte_t const*)data + offset, std::min(size - offset, CHUNK_BYTES))) {
+      errno = EIO;
+      return -1;
+    }
+  return size;
+}
+
+static int cipherClose(void* cookie) {
+  CipherStream* s = (CipherStream*)cookie;
+  bool ok = close(s->fd) == 0;
+  EVP_CIPHER_CTX_free(s->ctx);
+  OPENSSL_cleanse(s->master, sizeof(s->master));
+  delete s;
+  return ok ? 0 : -1;
+}
+
+int CaptureCipher::generateKey(char const* path) {
+  byte_t key[KEY_SIZE];
+  int fd = ::open(path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    perror(path);
+    return 1;
+  }
+  bool ok = RAND_bytes(key, sizeof(key)) == 1 && writeAll(fd, key, sizeof(key));
+  OPENSSL_cleanse(key, sizeof(key));
+  if (close(fd) != 0 || !ok) {
+    perror(path);
+    return 1;
+  }
+  return 0;
+}
+
+int CaptureCipher::loadKey(char const* path, byte_t key[KEY_SIZE]) {
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return 1;
+  }
+  ssize_t n = read(fd, key, KEY_SIZE);
+  byte_t extra;
+  bool ok = n == (ssize_t)KEY_SIZE && read(fd, &extra, 1) == 0;
+  close(fd);
+  if (!ok) {
+    std::cerr << path << ": a key file holds exactly " << KEY_SIZE << " bytes" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Appends a segment to an encrypted capture, or starts one
+FILE* CaptureCipher::open(char const* path, byte_t const key[KEY_SIZE], bool* empty) {
+  int fd = ::open(path, O_RDWR | O_CREAT | O_APPEND, 0600);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    perror(path);
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+
+  char magic[sizeof(CIPHER_MAGIC)];
+  if (S_ISREG(st.st_mode) && st.st_size > 0
+      ? pread(fd, magic, sizeof(magic), 0) != sizeof(magic) || memcmp(magic, CIPHER_MAGIC, sizeof(magic))
+      : !writeAll(fd, CIPHER_MAGIC, sizeof(CIPHER_MAGIC))) {
+    std::cerr << path << ": not an encrypted capture" << std::endl;
+    close(fd);
+    return NULL;
+  }
+
+  // Nothing was sealed yet if the file holds the magic only
+  if (empty)
+    *empty = st.st_size <= (off_t)sizeof(CIPHER_MAGIC);
+
+  CipherStream* s = new CipherStream();
+  s->fd = fd;
+  s->ctx = EVP_CIPHER_CTX_new();
+  memcpy(s->master, key, KEY_SIZE);
+  s->segment = false;
+
+  cookie_io_functions_t functions = {NULL, cipherWrite, NULL, cipherClose};
+  FILE* file = fopencookie(s, "w", functions);
+  if (!file) {
+    perror(path);
+    cipherClose(s);
+    return NULL;
+  }
+  setvbuf(file, NULL, _IOFBF, 1 << 16);
+  return file;
+}
+
+int CaptureCipher::decrypt(char const* path, byte_t const key[KEY_SIZE], FILE* out) {
+  int fd = ::open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    perror(path);
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+  size_t size = st.st_size;
+  void* map = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (map == MAP_FAILED || size < sizeof(CIPHER_MAGIC) || memcmp(map, CIPHER_MAGIC, sizeof(CIPHER_MAGIC))) {
+    std::cerr << path << ": not an encrypted capture" << std::endl;
+    if (map != MAP_FAILED)
+      munmap(map, size);
+    return 1;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  byte_t const* data = (byte_t const*)map;
+  size_t offset = sizeof(CIPHER_MAGIC);
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  byte_t dataKey[KEY_SIZE];
+  byte_t prefix[PREFIX_SIZE];
+  bool segment = false;
+  unsigned long long chunk = 0;
+  std::vector<byte_t> plain;
+  char const* error = NULL;
+  int length;
+
+  while (offset < size && !error) {
+    byte_t const* record = data + offset;
+    if (record[0] == 'S' && size - offset >= SEGMENT_RECORD) {
+      byte_t const* iv = record + 1;
+      byte_t const* wrapped = iv + IV_SIZE;
+      byte_t* tag = (byte_t*)wrapped + KEY_SIZE;
+      memcpy(prefix, tag + TAG_SIZE, PREFIX_SIZE);
+      segment = EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, iv) == 1
+	&& EVP_DecryptUpdate(ctx, NULL, &length, prefix, PREFIX_SIZE) == 1
+	&& EVP_DecryptUpdate(ctx, dataKey, &length, wrapped, KEY_SIZE) == 1
+	&& EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag) == 1
+	&& EVP_DecryptFinal_ex(ctx, dataKey + length, &length) == 1
+	&& EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, dataKey, NULL) == 1;
+      if (!segment)
+	error = "wrong master key or corrupted segment";
+      else
+	offset += SEGMENT_RECORD;
+      chunk = 0;
+    }
+    else if (record[0] == 'C' && size - offset >= CHUNK_HEADER) {
+      size_t chunkSize = record[1] | record[2] << 8 | record[3] << 16 | (size_t)record[4] << 24;
+      byte_t* tag = (byte_t*)record + 5;
+      byte_t iv[IV_SIZE];
+      if (!segment) {
+	error = "chunk outside of a segment";
+	break;
+      }
+      if (size - offset - CHUNK_HEADER < chunkSize) {
+	error = "truncated";
+	break;
+      }
+      nonce(prefix, chunk++, iv);
+      plain.resize(chunkSize);
+      if (EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv) != 1
+	  || EVP_DecryptUpdate(ctx, plain.data(), &length, record + CHUNK_HEADER, chunkSize) != 1
+	  || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag) != 1
+	  || EVP_DecryptFinal_ex(ctx, plain.data() + length, &length) != 1)
+	error = "authentication failed";
+      else if (fwrite(plain.data(), 1, chunkSize, out) != chunkSize)
+	error = "write error";
+      else
+	offset += CHUNK_HEADER + chunkSize;
+    }
+    else
+      error = record[0] == 'S' || record[0] == 'C' ? "truncated" : "corrupted";
+  }
+
+  OPENSSL_cleanse(dataKey, sizeof(dataKey));
+  if (!plain.empty())
+    OPENSSL_cleanse(plain.data(), plain.size());
+  EVP_CIPHER_CTX_free(ctx);
+  munmap(map, size);
+  fflush(out);
+
+  if (error) {
+    std::cerr << path << ": " << error << " at byte " << offset << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Writes the exchanges of the corpus, over and over, the way --record does
+static double benchWrite(FILE* file, std::vector<Exchange> const& exchanges, size_t bytes, double& cpu) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  clock_t startCpu = clock();
+
+  size_t written = 0;
+  for (size_t i = 0; written < bytes; i = (i + 1) % exchanges.size()) {
+    Exchange const& e = exchanges[i];
+    ApduFile::writeExchange(file, e.command, e.szCommand, e.response, e.szResponse);
+    written += 4 + e.szCommand + e.szResponse;
+  }
+  fclose(file);
+
+  cpu = (double)(clock() - startCpu) / CLOCKS_PER_SEC;
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Capture throughput to /dev/null, so only the CPU cost of writing is measured
+int CaptureCipher::bench(byte_t const key[KEY_SIZE], size_t megabytes, char const* corpus) {
+  ApduFile file;
+  std::vector<Exchange> exchanges;
+  if (file.open(corpus))
+    return 1;
+
+  byte_t const* session;
+  size_t size;
+  Exchange e;
+  while (file.nextSession(session, size))
+    for (byte_t const* cursor = session; ApduFile::nextExchange(cursor, session + size, e); )
+      exchanges.push_back(e);
+  if (exchanges.empty()) {
+    std::cerr << corpus << ": no exchange" << std::endl;
+    return 1;
+  }
+
+  size_t bytes = megabytes << 20;
+  for (int encrypted = 0; encrypted < 2; ++encrypted) {
+    FILE* out = encrypted ? open("/dev/null", key) : fopen("/dev/null", "wb");
+    if (!out)
+      return 1;
+    double cpu;
+    double elapsed = benchWrite(out, exchanges, bytes, cpu);
+    std::cout << (encrypted ? "AES-256-GCM: " : "Plaintext:   ") << megabytes << " MB in " << elapsed << "s, "
+	      << (elapsed > 0 ? megabytes / elapsed : 0) << " MB/s, "
+	      << cpu * 1024 / megabytes << " CPU s per GB" << std::endl;
+  }
+  return 0;
+}
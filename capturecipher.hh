@@ -0,0 +1,53 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __CAPTURECIPHER_HH__
+# define __CAPTURECIPHER_HH__
+
+#include <cstdio>
+
+#include "tools.hh"
+
+/* Encryption at rest of recorded captures, with AES-256-GCM from libcrypto.
+   The capture is written through a stdio stream that seals each write in a chunk: up to 64 KB
+   in bulk, and a card on its own when the stream is flushed after it.
+   Each run, and every GB, starts a segment with a new random data key, stored wrapped by the
+   32-byte master key. The file is
+     "RCCENC01" then records:
+       'S' | IV (12) | wrapped data key (32) | tag (16) | nonce prefix (4)       segment
+       'C' | plaintext length (4, LE) | tag (16) | ciphertext                    chunk
+   A chunk nonce is the nonce prefix then the index of the chunk in its segment (8, LE).
+*/
+class CaptureCipher {
+
+public:
+  static const size_t KEY_SIZE = 32;
+
+  static int generateKey(char const* path);
+  static int loadKey(char const* path, byte_t key[KEY_SIZE]);
+  static FILE* open(char const* path, byte_t const key[KEY_SIZE], bool* empty = NULL);
+  static int decrypt(char const* path, byte_t const key[KEY_SIZE], FILE* out);
+  static int bench(byte_t const key[KEY_SIZE], size_t megabytes, char const* corpus);
+};
+
+#endif // __CAPTURECIPHER_HH__
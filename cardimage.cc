@@ -0,0 +1,148 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstring>
+
+#include "cardimage.hh"
+
+Bytes CardImage::key(byte_t const* command, size_t size) {
+  if (size > 0 && command[0] == Command::IN_DATA_EXCHANGE)
+    --size;
+  return Bytes(command, command + size);
+}
+
+void CardImage::add(byte_t const* command, size_t szCommand, Bytes const& response) {
+  _responses[key(command, szCommand)] = response;
+}
+
+void CardImage::add(byte_t const* command, size_t szCommand, char const* hexResponse) {
+  byte_t buff[MAX_FRAME_LEN];
+  size_t size = Tools::fromHex(hexResponse, buff, sizeof(buff));
+  add(command, szCommand, Bytes(buff, buff + size));
+}
+
+void CardImage::addRecord(byte_t sfi, byte_t record, Bytes const& response) {
+  byte_t readRecord[sizeof(Command::READ_RECORD)];
+  memcpy(readRecord, Command::READ_RECORD, sizeof(readRecord));
+  readRecord[4] = record;
+  readRecord[5] = (sfi << 3) | (1 << 2);
+  add(readRecord, sizeof(readRecord), response);
+}
+
+void CardImage::clear() {
+  _responses.clear();
+}
+
+// Reads the exchanges of one session of an APDU file
+void CardImage::load(byte_t const* session, size_t size) {
+  byte_t const* end = session + size;
+  Exchange exchange;
+
+  clear();
+  while (ApduFile::nextExchange(session, end, exchange)) {
+    if (!ApduFile::isSessionStart(exchange.command, exchange.szCommand))
+      add(exchange.command, exchange.szCommand,
+	  Bytes(exchange.response, exchange.response + exchange.szResponse));
+  }
+}
+
+// Writes the image as one session. APDU frames get back their Le
+void CardImage::save(FILE* file) const {
+  byte_t command[MAX_FRAME_LEN];
+
+  ApduFile::writeExchange(file, Command::START_14443A, sizeof(Command::START_14443A), NULL, 0);
+  for (std::map<Bytes, Bytes>::const_iterator it = _responses.begin(); it != _responses.end(); ++it) {
+    size_t size = it->first.size();
+    memcpy(command, it->first.data(), size);
+    if (command[0] == Command::IN_DATA_EXCHANGE)
+      command[size++] = 0x00;
+    ApduFile::writeExchange(file, command, size, it->second.data(), it->second.size());
+  }
+}
+
+void CardImage::answer(byte_t const* command, size_t size, Bytes& response) const {
+  std::map<Bytes, Bytes>::const_iterator it = _responses.find(key(command, size));
+  if (it != _responses.end()) {
+    response = it->second;
+    return;
+  }
+
+  // Unknown READ RECORD: 6A83 if the SFI has other records, 6A82 if the file does not exist
+  if (size == sizeof(Command::READ_RECORD) && command[3] == Command::READ_RECORD[3]) {
+    byte_t sw2 = 0x82;
+    for (it = _responses.begin(); it != _responses.end(); ++it)
+      if (it->first.size() == size - 1 && it->first[3] == command[3] && it->first[5] == command[5])
+	sw2 = 0x83;
+    response = {0x6A, sw2};
+    return;
+  }
+
+  response = {0x6D, 0x00}; // Instruction not supported
+}
+
+// A Visa debit card with a 10-entry paylog, close to the ones we tested
+CardImage CardImage::defaultCard() {
+  CardImage card;
+
+  byte_t const selectApp[] = {0x40,0x01,
+			      0x00,0xA4,0x04,0x00,
+			      0x07,
+			      0xA0,0x00,0x00,0x00,0x03,0x10,0x10,
+			      0x00};
+
+  card.add(Command::SELECT_PPSE, sizeof(Command::SELECT_PPSE),
+	   "6F29840E325041592E5359532E4444463031A517BF0C1461124F07A0000000031010500456495341870101"
+	   "9000");
+  card.add(selectApp, sizeof(selectApp),
+	   "6F2F8407A0000000031010A5245004564953419F380C9F66049F02069F37045F2A025F2D04656E6672BF0C059F4D020B0A"
+	   "9000");
+  card.add(Command::GET_DATA_LOG_FORMAT, sizeof(Command::GET_DATA_LOG_FORMAT),
+	   "9F4F169A039F21039F02065F2A029F1A029C019F36029F4E14"
+	   "9000");
+
+  byte_t buff[MAX_FRAME_LEN];
+  size_t size = Tools::fromHex("704557134970123456789012D25122010000012345678F5F201A444F452F4A4F484E20202020"
+			       "20202020202020202020202020209F1F1030313233343536373839303132333435"
+			       "9000", buff, sizeof(buff));
+  card.addRecord(1, 1, Bytes(buff, buff + size));
+  size = Tools::fromHex("700A5F280202509F0702FF00"
+			"9000", buff, sizeof(buff));
+  card.addRecord(1, 2, Bytes(buff, buff + size));
+
+  // Log entries follow the format above: date, time, amount, currency, country, type, counter, merchant
+  char const* merchants[] = {"TESCO STORES        ", "CANTERBURY CATHEDRAL", "SNCF                "};
+  auto bcd = [](int n) { return (byte_t)((n / 10) << 4 | n % 10); };
+  for (int i = 0; i < 10; ++i) {
+    Bytes entry = {0x14, 0x03, bcd(20 - i), // 2014/03/(20 - i)
+		   bcd(9 + i), 0x30, 0x00,
+		   0x00, 0x00, 0x00, bcd(12 + i), bcd(50 - i), 0x00,
+		   0x09, 0x78, // EUR
+		   0x02, 0x50, // FRA
+		   0x00, // Payment
+		   0x00, (byte_t)(0x40 - i)};
+    entry.insert(entry.end(), merchants[i % 3], merchants[i % 3] + 20);
+    entry.push_back(0x90);
+    entry.push_back(0x00);
+    card.addRecord(0x0B, i + 1, entry);
+  }
+  return card;
+}
@@ -0,0 +1,58 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __CARDIMAGE_HH__
+# define __CARDIMAGE_HH__
+
+#include <map>
+#include <vector>
+
+#include "tools.hh"
+#include "apdufile.hh"
+
+typedef std::vector<byte_t> Bytes;
+
+/* What a card answers to each command frame, status word included.
+   The trailing Le of APDU frames is not part of the key so a 6Cxx resend still matches.
+*/
+class CardImage {
+
+public:
+  void add(byte_t const* command, size_t szCommand, Bytes const& response);
+  void add(byte_t const* command, size_t szCommand, char const* hexResponse);
+  void addRecord(byte_t sfi, byte_t record, Bytes const& response);
+  void answer(byte_t const* command, size_t size, Bytes& response) const;
+  void clear();
+
+  void load(byte_t const* session, size_t size);
+  void save(FILE* file) const;
+
+  static CardImage defaultCard();
+
+private:
+  static Bytes key(byte_t const* command, size_t size);
+
+private:
+  std::map<Bytes, Bytes> _responses;
+};
+
+#endif // __CARDIMAGE_HH__
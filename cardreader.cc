@@ -0,0 +1,110 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include "cardreader.hh"
+#include "outputtemplate.hh"
+#include "textimport.hh"
+#include "stageprofile.hh"
+
+OutputTemplate const* CardReader::outputTemplate = NULL;
+
+// Returns 1 if an application could not be read completely
+int CardReader::read(std::vector<CCInfo>& infos, bool dump, std::ostream& log) {
+  // Retrieve all available applications
+  AppList list;
+  {
+    StageProfile::Scope scope(StageProfile::GET_ALL);
+    list = ApplicationHelper::getAll(log);
+  }
+
+  infos.clear();
+  if (list.size() == 0) {
+    log << "No application found using PPSE" << std::endl;
+    return 1;
+  }
+
+  /* Create CCinfo object then extract all information.
+   */
+  infos.reserve(list.size());
+  int ret = 0;
+  for (Application app : list) {
+    APDU res = ApplicationHelper::selectByPriority(list, app.priority);
+    if (res.size == 0) {
+      log << "Unable to select application " << app.name << std::endl;
+      ret = 1;
+      continue;
+    }
+    infos.push_back(CCInfo());
+    CCInfo& info = infos.back();
+    {
+      StageProfile::Scope scope(StageProfile::EXTRACT_APP_RESPONSE);
+      info.extractAppResponse(app, res);
+    }
+
+    /* Prepare PDOL, print optional interesting fields (e.g. the prefered language) and send the GPO
+       THIS COMMAND ADDS AN ENTRY IN THE PAYLOG, BEWARE OF THIS
+    */
+    // if (info.getProcessingOptions())
+    //   ;
+
+    if (dump)
+      info.dumpRecords();
+    else {
+      StageProfile::Scope scope(StageProfile::EXTRACT_BASE_RECORDS);
+      info.extractBaseRecords();
+    }
+    if (info.extractLogEntries()) {
+      log << "Unable to read the paylog. Reading aborted." << std::endl;
+      ret = 1;
+    }
+
+    // Entries are decoded on first use, while printing; the profile decodes them here instead
+    if (StageProfile::enabled()) {
+      StageProfile::Scope scope(StageProfile::PAYLOG_DECODE);
+      for (size_t i = 0; i < info.logEntryCount(); ++i)
+	info.logEntry(i);
+    }
+
+    log << "App" << (char) ('0' + app.priority) << " finished" << std::endl;
+  }
+
+  return ret;
+}
+
+void CardReader::print(std::vector<CCInfo> const& infos, std::ostream& out) {
+  StageProfile::Scope scope(StageProfile::FORMATTING);
+  if (outputTemplate) {
+    outputTemplate->print(infos, out);
+    return;
+  }
+  for (CCInfo const& info : infos)
+    info.printAll(out);
+}
+
+void CardReader::printMarker(std::ostream& out) {
+  if (!outputTemplate)
+    out << TextImport::MARKER << std::endl;
+}
+
+void CardReader::setTemplate(OutputTemplate const* t) {
+  outputTemplate = t;
+}
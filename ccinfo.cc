@@ -22,74 +22,120 @@
 
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 #include "tools.hh"
 #include "ccinfo.hh"
 
 CCInfo::CCInfo()
-  : _pdol({0, {0}}),
-    _track1DiscretionaryData({0, {0}}),
-    _track2EquivalentData({0, {0}}),
+  : _selectAppResponse({0, {0}}),
     _logSFI(0),
     _logCount(0),
     _logFormat({0, {0}}),
-    _logEntries({{0, {0}}})
+    _dumpCommands(0),
+    _logLayoutDecoded(false),
+    _logEntriesDecoded(0),
+    _logEntriesDropped(0)
 {
+  memset(&_application, 0, sizeof(_application));
+  memset(_fields, 0, sizeof(_fields));
+  memset(_logEntries, 0, sizeof(_logEntries));
+  memset(_decoded, 0, sizeof(_decoded));
   bzero(_languagePreference, sizeof(_languagePreference));
   bzero(_cardholderName, sizeof(_cardholderName));
+  memset(&_track2, 0, sizeof(_track2));
+  memset(&_issuer, 0, sizeof(_issuer));
 }
 
-int CCInfo::extractAppResponse(Application const& app, APDU const& appResponse) {
-  
-  _application = app;
+/* Walks the TLV objects, going down into templates, and remembers where the fields we
+   print lie. Nothing is copied. The log entry (SFI + count) is needed to read the paylog so it is kept now.
+*/
+void CCInfo::indexTlv(byte_t const* buff, size_t size, short source) {
+  byte_t const* origin = source < 0 ? _selectAppResponse.data : _records[source].response.data;
+  size_t i = 0;
+
+  while (i < size) {
+    if (buff[i] == 0x00 || buff[i] == 0xFF) { // Padding between objects
+      ++i;
+      continue;
+    }
 
-  byte_t const* buff = appResponse.data;
-  size_t size = appResponse.size;
+    unsigned short tag = buff[i++];
+    bool constructed = tag & 0x20;
+    if ((tag & 0x1F) == 0x1F && i < size) // 2-byte tag
+      tag = tag << 8 | buff[i++];
+    if (i >= size)
+      break;
 
-  for (size_t i = 0; i < size; ++i) {
-    if (i + 1 < size &&
-	buff[i] == 0x5F && buff[i + 1] == 0x2D) { // Language preference
+    size_t len = buff[i++];
+    if (len == 0x81 && i < size)
+      len = buff[i++];
+    else if (len == 0x82 && i + 1 < size) {
+      len = buff[i] << 8 | buff[i + 1];
       i += 2;
-      byte_t len = buff[i++];
-      memcpy(_languagePreference, &buff[i], len);
-      i += len - 1;
     }
-    else if (i + 1 < size &&
-	     buff[i] == 0x9F && buff[i + 1] == 0x38) { // PDOL
-      i += 2;
-      // We just store it to parse it later
-      _pdol.size = buff[i++];;
-      memcpy(_pdol.data, &buff[i], _pdol.size);
-      i += _pdol.size - 1;
+    if (i + len > size) // Truncated answer, keep what we have
+      len = size - i;
+
+    byte_t const* value = buff + i;
+    i += len;
+
+    if (constructed) {
+      indexTlv(value, len, source);
+      continue;
     }
-    else if (i + 1 < size &&
-	     buff[i] == 0xBF && buff[i + 1] == 0x0C) { // File Control Information
-      i += 2;
-      byte_t len = buff[i++];;
-      // Parse it now. Extract the LOG ENTRY
-      for (size_t j = 0; j < len; ++j) {
-	if (j + 1 < len &&
-	    buff[i + j] == 0x9F && buff[i + j + 1] == 0x4D) { // Log Entry
-	  j += 3; // Size = 2 so we don't save it
-	  _logSFI = buff[i + j++];
-	  _logCount = buff[i + j];
-	}
-      } // End read LOG ENTRY
-      i += len - 1;
+
+    Field f = FIELD_COUNT;
+    switch (tag) {
+    case 0x5F2D: f = LANGUAGE_PREFERENCE; break;
+    case 0x9F38: f = PDOL; break;
+    case 0x57: f = TRACK2_EQUIVALENT_DATA; break;
+    case 0x9F1F: f = TRACK1_DISCRETIONARY_DATA; break;
+    case 0x5F20: // Cardholder name
+      if (len > 2) // We dont save when the name is "/"
+	f = CARDHOLDER_NAME;
+      break;
+    case 0x9F4D: // Log Entry
+      if (len >= 2) {
+	_logSFI = value[0];
+	_logCount = value[1];
+      }
+      break;
     }
+
+    if (f != FIELD_COUNT && _fields[f].length == 0 && len > 0)
+      _fields[f] = {source, (unsigned short)(value - origin), (byte_t)std::min<size_t>(len, 0xFF)};
   }
 }
 
+byte_t const* CCInfo::field(Field f, size_t& size) const {
+  TlvRef const& ref = _fields[f];
+
+  size = ref.length;
+  if (size == 0)
+    return NULL;
+  return (ref.source < 0 ? _selectAppResponse.data : _records[ref.source].response.data) + ref.offset;
+}
+
+int CCInfo::extractAppResponse(Application const& app, APDU const& appResponse) {
+  
+  _application = app;
+  _selectAppResponse = appResponse;
+
+  // The answer ends with the status word
+  if (appResponse.size > 2)
+    indexTlv(_selectAppResponse.data, _selectAppResponse.size - 2, -1);
+  return 0;
+}
+
 int CCInfo::extractLogEntries() {
 
   // First we get the log format
   _logFormat = ApplicationHelper::executeCommand(Command::GET_DATA_LOG_FORMAT,
 						 sizeof(Command::GET_DATA_LOG_FORMAT), 
 						 "GET DATA LOG FORMAT");
-  if (_logFormat.size == 0) {
-    std::cerr << "Unable to get the log format. Reading aborted." << std::endl;
+  if (_logFormat.size == 0)
     return 1;
-  }
   
   byte_t readRecord[sizeof(Command::READ_RECORD)];
   memcpy(readRecord, Command::READ_RECORD, sizeof(readRecord));
@@ -98,7 +144,8 @@ int CCInfo::extractLogEntries() {
   //          Three other bits must be set to 1|0|0 (P1 is a record number)
   readRecord[5] = (_logSFI << 3) | (1 << 2);
 
-  for (size_t i = 0; i < _logCount; ++i) {
+  size_t count = std::min<size_t>(_logCount, sizeof(_logEntries) / sizeof(*_logEntries));
+  for (size_t i = 0; i < count; ++i) {
 
     // Param 1: record number
     readRecord[4] = i + 1; // Starts from 1 and not 0
@@ -134,226 +181,473 @@ int CCInfo::extractBaseRecords() {
 					      readRecord.size,
 					      "READ RECORD BASE");
       
-      if (res.size == 0)
+      if (res.size <= 2)
+	continue;
+
+      _records.push_back({(byte_t)sfi, (byte_t)record, res});
+      indexTlv(_records.back().response.data, res.size - 2, _records.size() - 1);
+    }
+  }
+  return 0;
+}
+
+/* Reads every record of SFI 1 to 30, records 1 to 16. 6A83 (record not found) ends the SFI,
+   6A82 (file not found) skips it: most cards answer in a few dozen commands instead of 480.
+*/
+int CCInfo::dumpRecords() {
+
+  APDU readRecord;
+  APDU res;
+
+  readRecord.size = sizeof(Command::READ_RECORD);
+  memcpy(readRecord.data, Command::READ_RECORD, sizeof(Command::READ_RECORD));
+
+  _dumpCommands = 0;
+  for (size_t sfi = _FROM_SFI; sfi <= _DUMP_TO_SFI; ++sfi) {
+    readRecord.data[5] = (sfi << 3) | (1 << 2);
+
+    for (size_t record = _FROM_RECORD; record <= _DUMP_TO_RECORD; ++record) {
+      readRecord.data[4] = record;
+
+      res = ApplicationHelper::executeCommand(readRecord.data,
+					      readRecord.size,
+					      "READ RECORD DUMP");
+      _dumpCommands++;
+
+      if (res.size > 0) {
+	_records.push_back({(byte_t)sfi, (byte_t)record, res});
+	if (res.size > 2 && res.data[0] == 0x70) // Record template, unlike log entries
+	  indexTlv(_records.back().response.data, res.size - 2, _records.size() - 1);
 	continue;
+      }
 
-      byte_t const* buff = res.data;
-      size_t size = res.size;
-
-      for (size_t i = 0; i < size; ++i) {
-	if (buff[i] == 0x57 && _track2EquivalentData.size == 0) { // Track 2 equivalent data
-	  i++;
-	  _track2EquivalentData.size = buff[i++];
-	  memcpy(_track2EquivalentData.data, &buff[i], _track2EquivalentData.size);
-	  i += _track2EquivalentData.size - 1;      
-	}
-	else if (i + 1 < size &&
-		 buff[i] == 0x5F && buff[i + 1] == 0x20) { // Cardholder name
-	  i += 2;
-	  byte_t len = buff[i++];
-	  if (len > 2) // We dont save when the name is "/"
-	    memcpy(_cardholderName, &buff[i], len);
-	  i += len - 1;
-	}
-	else if (i + 1 < size && _track1DiscretionaryData.size == 0 &&
-		 buff[i] == 0x9F && buff[i + 1] == 0x1F) { // Track 1 discretionary data
-	  i += 2;
-	  // We just store it to parse it later
-	  _track1DiscretionaryData.size = buff[i++];;
-	  memcpy(_track1DiscretionaryData.data, &buff[i], _track1DiscretionaryData.size);
-	  i += _track1DiscretionaryData.size - 1;
-	}    
+      unsigned short status = ApplicationHelper::lastStatus();
+      if (status == 0) { // No answer, the card is gone
+	std::cerr << "Dump aborted at SFI " << sfi << " record " << record << std::endl;
+	return 1;
       }
+      if (status == 0x6A82 || status == 0x6A83)
+	break;
     }
   }
   return 0;
 }
 
-void CCInfo::printAll() const {
- 
-  std::cout << "----------------------------------" << std::endl;
-  std::cout << "----------------------------------" << std::endl;
-  std::cout << "-- Application --" << std::endl;
-  std::cout << "----------------------------------" << std::endl;
-  std::cout << "Name: " << _application.name << std::endl;
-  std::cout << "Priority: " << (char)('0' + _application.priority) << std::endl;
-  Tools::printHex(_application.aid, sizeof(_application.aid), "AID");
-
-  std::cout << "-----------------" << std::endl;
-  Tools::print(_languagePreference, "Language Preference");
-  Tools::print(_cardholderName, "Cardholder Name");
-  //  Tools::printHex(_pdol, "PDOL");
-  Tools::printHex(_track1DiscretionaryData, "Track 1 Discretionary data");
-  Tools::printHex(_track2EquivalentData, "Track 2 equivalent data");
-
-  printTracksInfo();
-
-  std::cout << "Log count: " << (int)_logCount << std::endl;
-  
-  printPaylog();
-}
-
-void CCInfo::printTracksInfo() const {
-  // Track 2
-  /* Description (from emvlab.org)
-    Contains the data elements of track 2 according to ISO/IEC 7813, excluding start sentinel, end sentinel, and Longitudinal Redundancy Check (LRC), as follows:
-    Primary Account Number (n, var. up to 19)
-    Field Separator (Hex 'D') (b)
-    Expiration Date (YYMM) (n 4)
-    Service Code (n 3)
-    Discretionary Data (defined by individual payment systems) (n, var.)
-    Pad with one Hex 'F' if needed to ensure whole bytes (b)
-  */
-  byte_t const* buff = _track2EquivalentData.data;
-  size_t size = _track2EquivalentData.size;
-  
-  size_t i;
-  std::cout << "PAN: ";
-  for (i = 0; i < 8; ++i) {
-    std::cout << HEX(buff[i]) << (i & 1 ? " " : "");
+/*
+  Decoding, done on first access
+*/
+
+Application const& CCInfo::application() const {
+  return _application;
+}
+
+char const* CCInfo::languagePreference() const {
+  if (!_decoded[LANGUAGE_PREFERENCE]) {
+    size_t size;
+    byte_t const* buff = field(LANGUAGE_PREFERENCE, size);
+    memcpy(_languagePreference, buff, std::min(size, sizeof(_languagePreference) - 1));
+    _decoded[LANGUAGE_PREFERENCE] = true;
+  }
+  return _languagePreference;
+}
+
+char const* CCInfo::cardholderName() const {
+  if (!_decoded[CARDHOLDER_NAME]) {
+    size_t size;
+    byte_t const* buff = field(CARDHOLDER_NAME, size);
+    memcpy(_cardholderName, buff, std::min(size, sizeof(_cardholderName) - 1));
+    _decoded[CARDHOLDER_NAME] = true;
+  }
+  return _cardholderName;
+}
+
+Track2 const& CCInfo::track2() const {
+  if (!_decoded[TRACK2_EQUIVALENT_DATA]) {
+    size_t size;
+    byte_t const* buff = field(TRACK2_EQUIVALENT_DATA, size);
+    decodeTrack2(buff, size, _track2);
+    if (_binTable)
+      _binTable->lookup(_track2.pan, _issuer);
+    _decoded[TRACK2_EQUIVALENT_DATA] = true;
+  }
+  return _track2;
+}
+
+BinInfo const& CCInfo::issuer() const {
+  track2();
+  return _issuer;
+}
+
+void CCInfo::setBinTable(BinTable const* table) {
+  _binTable = table;
+}
+
+byte_t const* CCInfo::track1Data(size_t& size) const {
+  return field(TRACK1_DISCRETIONARY_DATA, size);
+}
+
+byte_t const* CCInfo::track2Data(size_t& size) const {
+  return field(TRACK2_EQUIVALENT_DATA, size);
+}
+
+byte_t CCInfo::logCount() const {
+  return _logCount;
+}
+
+// Number of log entries actually read
+size_t CCInfo::logEntryCount() const {
+  size_t count = 0;
+  while (count < sizeof(_logEntries) / sizeof(*_logEntries) && _logEntries[count].size > 2)
+    count++;
+  return count;
+}
+
+// A dropped entry stays readable but is not printed, see PaylogDedupe
+void CCInfo::dropLogEntry(size_t index) {
+  _logEntriesDropped |= 1u << index;
+}
+
+bool CCInfo::logEntryDropped(size_t index) const {
+  return _logEntriesDropped & (1u << index);
+}
+
+std::vector<LogField> const& CCInfo::logLayout() const {
+  if (!_logLayoutDecoded) {
+    decodeLogFormat(_logFormat.data, _logFormat.size, _logLayout);
+    _logLayoutDecoded = true;
   }
-  std::cout << std::endl;
+  return _logLayout;
+}
+
+APDU const& CCInfo::selectResponse() const {
+  return _selectAppResponse;
+}
+
+std::vector<RawRecord> const& CCInfo::records() const {
+  return _records;
+}
+
+APDU const& CCInfo::rawLogEntry(size_t index) const {
+  return _logEntries[index];
+}
+
+// From the answer to GET DATA LOG FORMAT, status word included
+void CCInfo::decodeLogFormat(byte_t const* answer, size_t size, std::vector<LogField>& layout) {
+  byte_t const* format = answer;
+  size = size >= 2 ? size - 2 : 0; // Without the status word
+
+  // The answer to GET DATA is the 9F4F object itself
+  if (size >= 3 && format[0] == 0x9F && format[1] == 0x4F) {
+    size = std::min<size_t>(format[2], size - 3);
+    format += 3;
+  }
+  decodeLogLayout(format, size, layout);
+}
+
+PaylogEntry const& CCInfo::logEntry(size_t index) const {
+  if (!(_logEntriesDecoded & (1u << index))) {
+    APDU const& entry = _logEntries[index];
+    decodeLogEntry(entry.data, entry.size >= 2 ? entry.size - 2 : 0, logLayout(), _paylog[index]);
+    _logEntriesDecoded |= 1u << index;
+  }
+  return _paylog[index];
+}
+
+/* Description (from emvlab.org)
+   Contains the data elements of track 2 according to ISO/IEC 7813, excluding start sentinel, end sentinel, and Longitudinal Redundancy Check (LRC), as follows:
+   Primary Account Number (n, var. up to 19)
+   Field Separator (Hex 'D') (b)
+   Expiration Date (YYMM) (n 4)
+   Service Code (n 3)
+   Discretionary Data (defined by individual payment systems) (n, var.)
+   Pad with one Hex 'F' if needed to ensure whole bytes (b)
+*/
+bool CCInfo::decodeTrack2(byte_t const* buff, size_t size, Track2& track2) {
+  memset(&track2, 0, sizeof(track2));
+
+  size_t nibbles = size * 2;
+  size_t n = 0;
+  auto nibble = [buff](size_t i) { return (i & 1) ? buff[i / 2] & 0x0F : buff[i / 2] >> 4; };
+
   // Separator now is only 4-bit long, seriously?.. -_-
-  // Next 2 bytes after the separator are the expiry date
-  // So we must pick this:
-  // DY YM M*
-  //  ^ ^^ ^
-  byte_t year = buff[i++] << 4;
-  year |= buff[i] >> 4;
-  byte_t month = buff[i++] << 4;
-  month |= buff[i] >> 4;
+  for (; n < nibbles && nibble(n) != 0xD; ++n)
+    if (n < sizeof(track2.pan) - 1)
+      track2.pan[n] = '0' + nibble(n);
+  if (n + 8 > nibbles)
+    return false;
+
+  track2.pan[std::min(n, sizeof(track2.pan) - 1)] = 0;
+  n++;
+  track2.expiryYear = nibble(n) << 4 | nibble(n + 1);
+  track2.expiryMonth = nibble(n + 2) << 4 | nibble(n + 3);
+  for (size_t i = 0; i < 3; ++i)
+    track2.serviceCode[i] = '0' + nibble(n + 4 + i);
+  return true;
+}
+
+// The log format is a data object list: tag and length of each field, no value
+void CCInfo::decodeLogLayout(byte_t const* format, size_t size, std::vector<LogField>& layout) {
+  size_t offset = 0;
+
+  layout.clear();
+  for (size_t i = 0; i < size; ) {
+    unsigned short tag = format[i++];
+    if ((tag & 0x1F) == 0x1F && i < size)
+      tag = tag << 8 | format[i++];
+    if (i >= size)
+      break;
+    byte_t len = format[i++];
+
+    layout.push_back({tag, (byte_t)offset, len});
+    offset += len;
+  }
+}
+
+void CCInfo::decodeLogEntry(byte_t const* entry, size_t size, std::vector<LogField> const& layout, PaylogEntry& decoded) {
+  memset(&decoded, 0, sizeof(decoded));
+
+  for (LogField const& f : layout) {
+    if (f.offset + f.length > size)
+      break;
+    byte_t const* value = entry + f.offset;
+
+    switch (f.tag) {
+    case 0x9A: // Date
+      memcpy(decoded.date, value, std::min<size_t>(f.length, sizeof(decoded.date)));
+      break;
+    case 0x9F21: // Time
+      memcpy(decoded.time, value, std::min<size_t>(f.length, sizeof(decoded.time)));
+      break;
+    case 0x9F02: { // Amount, right aligned BCD
+      size_t len = std::min<size_t>(f.length, sizeof(decoded.amount));
+      memcpy(decoded.amount + sizeof(decoded.amount) - len, value + f.length - len, len);
+      for (size_t j = 0; j < sizeof(decoded.amount); ++j)
+	decoded.amountValue = decoded.amountValue * 100 + (decoded.amount[j] >> 4) * 10 + (decoded.amount[j] & 0x0F);
+      break;
+    }
+    case 0x5F2A: { // Currency
+      decoded.currency = f.length >= 2 ? value[0] << 8 | value[1] : value[0];
+      decoded.currencyName = currencyName(decoded.currency);
+      break;
+    }
+    case 0x9F1A: { // Terminal country code
+      decoded.country = f.length >= 2 ? value[0] << 8 | value[1] : value[0];
+      decoded.countryName = countryName(decoded.country);
+      break;
+    }
+    case 0x9C: // Type
+      decoded.type = value[0];
+      break;
+    case 0x9F36: // Counter
+      decoded.counter = f.length >= 2 ? value[0] << 8 | value[1] : value[0];
+      break;
+    case 0x9F27: // Crypto info data
+      decoded.cryptoInfo = value[0];
+      break;
+    case 0x9F4E: // Merchant
+      decoded.merchantLength = std::min<size_t>(f.length, sizeof(decoded.merchant) - 1);
+      memcpy(decoded.merchant, value, decoded.merchantLength);
+      break;
+    }
+  }
+}
+
+char const* CCInfo::findName(std::map<unsigned short, std::string> const& names, unsigned short code) {
+  std::map<unsigned short, std::string>::const_iterator it = names.find(code);
+  return it == names.end() ? NULL : it->second.c_str();
+}
+
+// The maps are small, a linear search is enough
+unsigned short CCInfo::findCode(std::map<unsigned short, std::string> const& names, char const* name, size_t length) {
+  for (std::map<unsigned short, std::string>::const_iterator it = names.begin(); it != names.end(); ++it)
+    if (it->second.size() == length && !memcmp(it->second.data(), name, length))
+      return it->first;
+  return 0;
+}
+
+char const* CCInfo::currencyName(unsigned short code) {
+  return findName(_currencyCodes, code);
+}
+
+char const* CCInfo::countryName(unsigned short code) {
+  return findName(_countryCodes, code);
+}
+
+unsigned short CCInfo::currencyCode(char const* name, size_t length) {
+  return findCode(_currencyCodes, name, length);
+}
+
+unsigned short CCInfo::countryCode(char const* name, size_t length) {
+  return findCode(_countryCodes, name, length);
+}
+
+unsigned short CCInfo::logFieldTag(char const* name, size_t length) {
+  return findCode(_logFormatTags, name, length);
+}
+
+/*
+  Printing
+*/
+
+void CCInfo::printAll(std::ostream& out) const {
+ 
+  out << "----------------------------------" << std::endl;
+  out << "----------------------------------" << std::endl;
+  out << "-- Application --" << std::endl;
+  out << "----------------------------------" << std::endl;
+  out << "Name: " << _application.name << std::endl;
+  out << "Priority: " << (char)('0' + _application.priority) << std::endl;
+  Tools::printHex(_application.aid, sizeof(_application.aid), "AID", out);
+
+  out << "-----------------" << std::endl;
+  Tools::print(languagePreference(), "Language Preference", out);
+  Tools::print(cardholderName(), "Cardholder Name", out);
+
+  size_t size;
+  byte_t const* buff = field(TRACK1_DISCRETIONARY_DATA, size);
+  Tools::printHex(buff, size, "Track 1 Discretionary data", out);
+  buff = field(TRACK2_EQUIVALENT_DATA, size);
+  Tools::printHex(buff, size, "Track 2 equivalent data", out);
+
+  printTracksInfo(out);
+
+  out << "Log count: " << (int)_logCount << std::endl;
   
-  std::cout << "Expiry date: " << HEX(month) << "/20" << HEX(year) << std::endl;
+  printPaylog(out);
+
+  if (_dumpCommands > 0)
+    printDump(out);
 }
 
-void CCInfo::printPaylog() const {
+void CCInfo::printDump(std::ostream& out) const {
+  unsigned naive = (_DUMP_TO_SFI - _FROM_SFI + 1) * (_DUMP_TO_RECORD - _FROM_RECORD + 1);
 
-  std::cout << "-----------------" << std::endl;
-  std::cout << "-- Paylog --" << std::endl;
-  std::cout << "-----------------" << std::endl;
-  // Data are not formatted. We must read the logFormat to parse each entry
-  byte_t const* format = _logFormat.data;
-  size_t size = _logFormat.size;
-  size_t index = 0;
-  for (APDU entry : _logEntries) {
-    if (entry.size == 0)
+  out << "-----------------" << std::endl;
+  out << "-- Records --" << std::endl;
+  out << "-----------------" << std::endl;
+  for (RawRecord const& r : _records) {
+    out << "SFI " << HEX(r.sfi) << " record " << HEX(r.record) << ": ";
+    Tools::printHex(r.response.data, r.response.size - 2, "", out); // Without the status word
+  }
+  out << _records.size() << " record(s) read with " << _dumpCommands
+	    << " READ RECORD instead of " << naive << std::endl;
+}
+
+void CCInfo::printTracksInfo(std::ostream& out) const {
+  Track2 const& t = track2();
+
+  out << "PAN: ";
+  for (size_t i = 0; t.pan[i]; ++i)
+    out << t.pan[i] << ((i & 3) == 3 ? " " : "");
+  out << std::endl;
+
+  out << "Expiry date: " << HEX(t.expiryMonth) << "/20" << HEX(t.expiryYear) << std::endl;
+
+  if (_issuer.issuer) {
+    char const* country = countryName(_issuer.country);
+    out << "Issuer: " << _issuer.issuer << " (" << _issuer.brand << " " << _issuer.type;
+    if (country)
+      out << ", " << country;
+    else if (_issuer.country)
+      out << ", " << std::hex << _issuer.country << std::dec;
+    out << ")" << std::endl;
+  }
+}
+
+void CCInfo::printPaylog(std::ostream& out) const {
+  printPaylogHeader(out);
+
+  size_t count = logEntryCount();
+  for (size_t index = 0; index < count; ++index)
+    if (!logEntryDropped(index))
+      printLogEntry(index, out);
+}
+
+void CCInfo::printPaylogHeader(std::ostream& out) {
+  out << "-----------------" << std::endl;
+  out << "-- Paylog --" << std::endl;
+  out << "-----------------" << std::endl;
+}
+
+void CCInfo::printLogEntry(size_t index, std::ostream& out) const {
+  printLogEntry(index, logLayout(), logEntry(index), out);
+}
+
+// Fields are printed in the order of the log format
+void CCInfo::printLogEntry(size_t index, std::vector<LogField> const& layout, PaylogEntry const& entry,
+			   std::ostream& out) {
+  out << index << ": ";
+  for (LogField const& f : layout) {
+    switch (f.tag) {
+    case 0x9A: // Date
+      out << _logFormatTags.at(0x9A) << ": "
+		<< "20" << HEX(entry.date[0]) << "/" << HEX(entry.date[1]) << "/" << HEX(entry.date[2]) << "; ";
       break;
-    
-    std::cout << index++ << ": ";
-    size_t e = 0;
-    // Read the log format to deduce what is in the log entry
-    for (size_t i = 0; i < size; ++i) {
-      if (format[i] == 0x9A) { // Date
-	i++;
-	size_t len = format[i];
-	std::cout << _logFormatTags.at(0x9A) << ": ";
-	for (size_t j = 0; j < len; ++j) {
-	  std::cout << (j == 0 ? "" : "/") << (j == 0 ? "20" : "") << HEX(entry.data[e++]);
-	}
-	std::cout << "; ";
-      }
-      else if (format[i] == 0x9C) { // Type
-	i++;
-	size_t len = format[i];
-	std::cout << _logFormatTags.at(0x9C) << ": "
-		  << (entry.data[e++] ? "Withdrawal" : "Payment")
-		  << "; ";
-      }
-      else if (i + 1 < size) {
-	if (format[i] == 0x9F && format[i + 1] == 0x21) { // Time
-	  i += 2;
-	  size_t len = format[i];
-	  std::cout << _logFormatTags.at(0x9F21) << ": ";
-	  for (size_t j = 0; j < len; ++j)
-	    std::cout << (j == 0 ? "" : ":") << HEX(entry.data[e++]);	  
-	  std::cout << "; ";
-	}
-	else if (format[i] == 0x5F && format[i + 1] == 0x2A) { // Currency
-	  i += 2;
-	  size_t len = format[i];
-	  std::cout << _logFormatTags.at(0x5F2A) << ": ";
-	  unsigned short value = entry.data[e] << 8 | entry.data[e+1];
-	  // If the code is unknown, we print it. Otherwise we print the 3-char equivalent
-	  if (_currencyCodes.find(value) == _currencyCodes.end()) {
-	    for (size_t j = 0; j < len; ++j)
-	      std::cout << HEX(entry.data[e++]);	  
-	  } else {
-	    std::cout << _currencyCodes.at(value);
-	    e += 2;
-	  }
-	  std::cout << "; ";
-	}
-	else if (format[i] == 0x9F && format[i + 1] == 0x02) { // Amount
-	  i += 2;
-	  size_t len = format[i]; // Len should always be 6
-	  std::cout << _logFormatTags.at(0x9F02) << ": ";
-	  // First 4 bytes = value without comma
-	  // 5th byte - value after the comma
-	  // 6th byte = dk what it is
-	  bool flagZero = true;
-	  for (size_t j = 0; j < len; ++j) {
-	    if (j < 4 && flagZero && entry.data[e] == 0) { // We dont print zeros before the value
-	      e++;
-	      continue;
-	    }
-	    else
-	      flagZero = false;
-	    std::cout << HEX(entry.data[e++]);
-	    if (j == 4)
-	      std::cout << ".";
-	  }
-	  std::cout << "; ";
-	}
-	else if (format[i] == 0x9F && format[i + 1] == 0x4E) { // Merchant
-	  i += 2;
-	  size_t len = format[i];
-	  std::cout << _logFormatTags.at(0x9F4E) << ": ";	  
-	  for (size_t j = 0; j < len; ++j)
-	    std::cout << (char) entry.data[e++]; 
-	  std::cout << "; ";
-	}
-	else if (format[i] == 0x9F && format[i + 1] == 0x36) { // Counter
-	  i += 2;
-	  size_t len = format[i];
-	  std::cout << _logFormatTags.at(0x9F36) << ": ";	  
-	  for (size_t j = 0; j < len; ++j)
-	    std::cout << HEX(entry.data[e++]);
-	  std::cout << "; ";
-	}
-	else if (format[i] == 0x9F && format[i + 1] == 0x1A) { // Terminal country code
-	  i += 2;
-	  size_t len = format[i];
-	  std::cout << _logFormatTags.at(0x9F1A) << ": ";
-	  unsigned short value = entry.data[e] << 8 | entry.data[e+1];
-	  // If the code is unknown, we print it. Otherwise we print the 3-char equivalent
-	  if (_countryCodes.find(value) == _countryCodes.end()) {
-	    for (size_t j = 0; j < len; ++j)
-	      std::cout << HEX(entry.data[e++]);	  
-	  } else {
-	    std::cout << _countryCodes.at(value);
-	    e += 2;
-	  }
-	  std::cout << "; ";
-	}
-	else if (format[i] == 0x9F && format[i + 1] == 0x27) { // Crypto info data
-	  i += 2;
-	  size_t len = format[i];
-	  std::cout << _logFormatTags.at(0x9F27) << ": ";
-	  for (size_t j = 0; j < len; ++j)
-	    std::cout << HEX(entry.data[e++]);
-	  std::cout << "; ";
-	}
+    case 0x9C: // Type
+      out << _logFormatTags.at(0x9C) << ": "
+		<< (entry.type ? "Withdrawal" : "Payment")
+		<< "; ";
+      break;
+    case 0x9F21: // Time
+      out << _logFormatTags.at(0x9F21) << ": "
+		<< HEX(entry.time[0]) << ":" << HEX(entry.time[1]) << ":" << HEX(entry.time[2]) << "; ";
+      break;
+    case 0x5F2A: // Currency
+      out << _logFormatTags.at(0x5F2A) << ": ";
+      // If the code is unknown, we print it. Otherwise we print the 3-char equivalent
+      if (entry.currencyName)
+	out << entry.currencyName;
+      else
+	out << HEX((byte_t)(entry.currency >> 8)) << HEX((byte_t)entry.currency);
+      out << "; ";
+      break;
+    case 0x9F02: { // Amount
+      out << _logFormatTags.at(0x9F02) << ": ";
+      // First 4 bytes = value without comma
+      // 5th byte - value after the comma
+      // 6th byte = dk what it is
+      bool flagZero = true;
+      for (size_t j = 0; j < sizeof(entry.amount); ++j) {
+	if (j < 4 && flagZero && entry.amount[j] == 0) // We dont print zeros before the value
+	  continue;
+	flagZero = false;
+	out << HEX(entry.amount[j]);
+	if (j == 4)
+	  out << ".";
       }
+      out << "; ";
+      break;
+    }
+    case 0x9F4E: // Merchant
+      out << _logFormatTags.at(0x9F4E) << ": ";
+      out.write(entry.merchant, entry.merchantLength);
+      out << "; ";
+      break;
+    case 0x9F36: // Counter
+      out << _logFormatTags.at(0x9F36) << ": "
+		<< HEX((byte_t)(entry.counter >> 8)) << HEX((byte_t)entry.counter) << "; ";
+      break;
+    case 0x9F1A: // Terminal country code
+      out << _logFormatTags.at(0x9F1A) << ": ";
+      if (entry.countryName)
+	out << entry.countryName;
+      else
+	out << HEX((byte_t)(entry.country >> 8)) << HEX((byte_t)entry.country);
+      out << "; ";
+      break;
+    case 0x9F27: // Crypto info data
+      out << _logFormatTags.at(0x9F27) << ": " << HEX(entry.cryptoInfo) << "; ";
+      break;
     }
-    std::cout << std::endl;
   }
+  out << std::endl;
 }
 
 int CCInfo::getProcessingOptions() const {
 
   size_t pdol_response_len = 0;
-  size_t size = _pdol.size;
-  byte_t const* buff = _pdol.data;
+  size_t size;
+  byte_t const* buff = field(PDOL, size);
 
   std::list<std::pair<unsigned short, byte_t> > tagList;
 
@@ -434,6 +728,8 @@ const std::map<unsigned short, std::string> CCInfo::_logFormatTags =
     {0x9F36,  "Counter"}
   };
 
+BinTable const* CCInfo::_binTable = NULL;
+
 const std::map<unsigned short, std::string> CCInfo::_countryCodes =
   {
     {0x756, "CHE"},
@@ -24,9 +24,59 @@
 # define __CCINFO_HH__
 
 #include <map>
+#include <vector>
 
 #include "applicationhelper.hh"
+#include "bintable.hh"
 
+// Raw answer to a READ RECORD
+struct RawRecord {
+  byte_t sfi;
+  byte_t record;
+  APDU response;
+};
+
+// Where a field lies in the retained answers
+struct TlvRef {
+  short source; // -1 = SELECT APP answer, otherwise index in the records
+  unsigned short offset;
+  byte_t length;
+};
+
+// Position of a tag inside each log entry, from the log format
+struct LogField {
+  unsigned short tag;
+  byte_t offset;
+  byte_t length;
+};
+
+struct Track2 {
+  char pan[20]; // Digits, NUL terminated
+  byte_t expiryYear; // BCD, as on the card
+  byte_t expiryMonth; // BCD
+  char serviceCode[4];
+};
+
+// Decoded paylog entry. Fields absent from the log format are left to 0
+struct PaylogEntry {
+  byte_t date[3]; // BCD YY MM DD
+  byte_t time[3]; // BCD HH MM SS
+  byte_t amount[6]; // BCD, minor units
+  unsigned long long amountValue; // Minor units
+  unsigned short currency; // ISO 4217 code as stored (0x978 = EUR)
+  unsigned short country; // ISO 3166 code as stored (0x250 = FRA)
+  char const* currencyName; // NULL if unknown
+  char const* countryName; // NULL if unknown
+  byte_t type; // 0 = payment
+  unsigned short counter; // ATC
+  byte_t cryptoInfo;
+  byte_t merchantLength;
+  char merchant[64];
+};
+
+/* Only the raw answers and the position of the interesting tags are kept while reading.
+   Each field is decoded the first time it is asked for, then cached.
+*/
 class CCInfo {
 
 public:
@@ -36,23 +86,72 @@ public:
   int extractAppResponse(Application const&, APDU const&);
   int extractLogEntries();
   int extractBaseRecords();
+  int dumpRecords();
 
-  void printAll() const;
-  void printPaylog() const;
-  void printTracksInfo() const;
+  void printAll(std::ostream& out = std::cout) const;
+  void printDump(std::ostream& out = std::cout) const;
+  void printPaylog(std::ostream& out = std::cout) const;
+  void printLogEntry(size_t index, std::ostream& out = std::cout) const;
+  void printTracksInfo(std::ostream& out = std::cout) const;
 
   int getProcessingOptions() const;
 
+public:
+  Application const& application() const;
+  char const* languagePreference() const;
+  char const* cardholderName() const;
+  Track2 const& track2() const;
+  BinInfo const& issuer() const; // From --bin-table, issuer NULL if unknown
+  byte_t const* track1Data(size_t& size) const; // Track 1 discretionary data, as on the card
+  byte_t const* track2Data(size_t& size) const;
+  byte_t logCount() const; // From the log entry (9F4D)
+  size_t logEntryCount() const;
+  PaylogEntry const& logEntry(size_t index) const;
+  void dropLogEntry(size_t index);
+  bool logEntryDropped(size_t index) const;
+  std::vector<LogField> const& logLayout() const;
+  APDU const& selectResponse() const;
+  std::vector<RawRecord> const& records() const;
+  APDU const& rawLogEntry(size_t index) const; // As read, status word included
+
+  static void setBinTable(BinTable const* table);
+  static bool decodeTrack2(byte_t const* buff, size_t size, Track2& track2);
+  static void decodeLogFormat(byte_t const* answer, size_t size, std::vector<LogField>& layout);
+  static void decodeLogLayout(byte_t const* format, size_t size, std::vector<LogField>& layout);
+  static void decodeLogEntry(byte_t const* entry, size_t size, std::vector<LogField> const& layout, PaylogEntry& decoded);
+  static void printPaylogHeader(std::ostream& out);
+  static void printLogEntry(size_t index, std::vector<LogField> const& layout, PaylogEntry const& entry,
+			    std::ostream& out);
+
+  // Names used by printPaylog, NULL or 0 if unknown
+  static char const* currencyName(unsigned short code);
+  static char const* countryName(unsigned short code);
+  static unsigned short currencyCode(char const* name, size_t length);
+  static unsigned short countryCode(char const* name, size_t length);
+  static unsigned short logFieldTag(char const* name, size_t length);
+
 private:
-  Application _application;
-  char _languagePreference[56]; // Handle quite a lot of languages if needed...
-  char _cardholderName[56]; // Max size should never exceed 26
+  enum Field {
+    LANGUAGE_PREFERENCE,
+    PDOL,
+    CARDHOLDER_NAME,
+    TRACK1_DISCRETIONARY_DATA,
+    TRACK2_EQUIVALENT_DATA,
+    FIELD_COUNT
+  };
+
+private:
+  void indexTlv(byte_t const* buff, size_t size, short source);
+  byte_t const* field(Field field, size_t& size) const;
 
-  // Information to print or to temporary save
-  // Not real APDUS!! The structure is used to save the length
-  APDU _pdol; // Size unknown
-  APDU _track1DiscretionaryData; // Size unknown
-  APDU _track2EquivalentData; // Max size should never exceed 19
+  static char const* findName(std::map<unsigned short, std::string> const& names, unsigned short code);
+  static unsigned short findCode(std::map<unsigned short, std::string> const& names, char const* name, size_t length);
+
+private:
+  Application _application;
+  APDU _selectAppResponse;
+  std::vector<RawRecord> _records; // Every record read, in order
+  TlvRef _fields[FIELD_COUNT]; // length 0 = not found
 
   // SFI and number of log entries
   byte_t _logSFI;
@@ -61,17 +160,34 @@ private:
   APDU _logFormat; // Format of log entries
   APDU _logEntries[0x20]; // Maximum 32 entries
 
+  // Dump mode
+  size_t _dumpCommands;
+
+  // Decoded on first access
+  mutable bool _decoded[FIELD_COUNT];
+  mutable char _languagePreference[56];
+  mutable char _cardholderName[56];
+  mutable Track2 _track2;
+  mutable BinInfo _issuer; // Looked up with track 2
+  mutable std::vector<LogField> _logLayout;
+  mutable bool _logLayoutDecoded;
+  mutable unsigned int _logEntriesDecoded; // One bit per entry
+  unsigned int _logEntriesDropped; // One bit per entry
+  mutable PaylogEntry _paylog[0x20];
+
 private:
-  APDU _select_app_response;
   static const std::map<unsigned short, byte_t const*> PDOLValues;
   static const std::map<unsigned short, std::string> _logFormatTags;
   static const std::map<unsigned short, std::string> _currencyCodes;
   static const std::map<unsigned short, std::string> _countryCodes;
+  static BinTable const* _binTable;
 
   static const byte_t _FROM_SFI = 1;
   static const byte_t _TO_SFI = 2;
   static const byte_t _FROM_RECORD = 1;
   static const byte_t _TO_RECORD = 2;
+  static const byte_t _DUMP_TO_SFI = 30;
+  static const byte_t _DUMP_TO_RECORD = 16;
 };
 
 #endif // __CCINFO_HH__
@@ -0,0 +1,147 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "collector.hh"
+#include "forwarder.hh"
+#include "textimport.hh"
+
+struct CollectorClient {
+  int socket;
+  std::string peer;
+  std::string buffer;
+  unsigned long long batches;
+  unsigned long long cards;
+};
+
+// Handles the complete frames of the buffer, false on a malformed frame
+static bool handleFrames(CollectorClient& client, unsigned long long& cards, std::ostream& out) {
+  size_t consumed = 0;
+  std::string text;
+  std::string acks;
+
+  while (client.buffer.size() - consumed >= Forwarder::HEADER_SIZE) {
+    byte_t const* frame = (byte_t const*)client.buffer.data() + consumed;
+    unsigned payload, records;
+    unsigned long long sequence;
+    if (!Forwarder::parseHeader(frame, payload, sequence, records))
+      return false;
+    if (client.buffer.size() - consumed < Forwarder::HEADER_SIZE + payload)
+      break;
+
+    byte_t const* cursor = frame + Forwarder::HEADER_SIZE;
+    byte_t const* end = cursor + payload;
+    ImportedCard card;
+    for (unsigned i = 0; i < records; ++i) {
+      card.offset = cards++;
+      if (!Forwarder::decode(cursor, end, card))
+	return false;
+      TextImport::write(card, text);
+    }
+
+    for (int i = 0; i < 8; ++i)
+      acks += (char)(sequence >> (8 * i));
+    consumed += Forwarder::HEADER_SIZE + payload;
+    client.batches++;
+    client.cards += records;
+  }
+
+  client.buffer.erase(0, consumed);
+  out << text;
+  out.flush();
+  return send(client.socket, acks.data(), acks.size(), MSG_NOSIGNAL) == (ssize_t)acks.size();
+}
+
+int Collector::run(unsigned short port, std::ostream& out) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (listener < 0
+      || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0
+      || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0
+      || listen(listener, 16) != 0) {
+    perror("Collector");
+    return 1;
+  }
+  std::cerr << "Collecting on port " << port << std::endl;
+
+  std::vector<CollectorClient> clients;
+  unsigned long long cards = 0;
+  while (true) {
+    std::vector<struct pollfd> fds(1, {listener, POLLIN, 0});
+    for (CollectorClient const& c : clients)
+      fds.push_back({c.socket, POLLIN, 0});
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR)
+	continue;
+      perror("Collector");
+      return 1;
+    }
+
+    // Clients first, accepting changes the indexes
+    for (size_t i = clients.size(); i-- > 0; ) {
+      if (!fds[i + 1].revents)
+	continue;
+      CollectorClient& c = clients[i];
+      char buffer[65536];
+      ssize_t n = recv(c.socket, buffer, sizeof(buffer), 0);
+      if (n > 0)
+	c.buffer.append(buffer, n);
+      if (n > 0 && handleFrames(c, cards, out))
+	continue;
+
+      std::cerr << c.peer << ": " << c.batches << " batch(es), " << c.cards << " card(s)"
+		<< (n > 0 ? ", malformed frame" : "") << std::endl;
+      close(c.socket);
+      clients.erase(clients.begin() + i);
+    }
+
+    if (fds[0].revents & POLLIN) {
+      struct sockaddr_in peer;
+      socklen_t length = sizeof(peer);
+      int fd = accept(listener, (struct sockaddr*)&peer, &length);
+      if (fd < 0)
+	continue;
+      char host[INET_ADDRSTRLEN] = "";
+      inet_ntop(AF_INET, &peer.sin_addr, host, sizeof(host));
+      CollectorClient c = {fd, std::string(host) + ":" + std::to_string(ntohs(peer.sin_port)), "", 0, 0};
+      out << "F\t" << c.peer << "\n";
+      clients.push_back(c);
+    }
+  }
+  return 0;
+}
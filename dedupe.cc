@@ -0,0 +1,136 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#include <cstring>
+
+#include "dedupe.hh"
+
+PaylogDedupe::PaylogDedupe(unsigned window)
+  : _keys(_MIN_CAPACITY, 0),
+    _seen(_MIN_CAPACITY, 0),
+    _size(0),
+    _window(window),
+    _entries(0),
+    _fresh(0),
+    _evicted(0)
+{
+}
+
+unsigned long long PaylogDedupe::key(unsigned long long card, PaylogEntry const& entry) {
+  byte_t packed[sizeof(card) + 2 + sizeof(entry.date) + sizeof(entry.time) + sizeof(entry.amount)];
+  byte_t* p = packed;
+  memcpy(p, &card, sizeof(card));
+  p += sizeof(card);
+  *p++ = entry.counter >> 8;
+  *p++ = entry.counter;
+  memcpy(p, entry.date, sizeof(entry.date));
+  p += sizeof(entry.date);
+  memcpy(p, entry.time, sizeof(entry.time));
+  p += sizeof(entry.time);
+  memcpy(p, entry.amount, sizeof(entry.amount));
+
+  unsigned long long key = Tools::hash(packed, sizeof(packed));
+  return key ? key : 1;
+}
+
+// Returns true if the key was not in the table
+bool PaylogDedupe::insert(unsigned long long key, unsigned now) {
+  size_t mask = _keys.size() - 1;
+  size_t slot = key & mask;
+  for (; _keys[slot]; slot = (slot + 1) & mask)
+    if (_keys[slot] == key) {
+      _seen[slot] = now;
+      return false;
+    }
+
+  _keys[slot] = key;
+  _seen[slot] = now;
+  if (++_size * 10 > _keys.size() * 7)
+    rehash(now);
+  return true;
+}
+
+bool PaylogDedupe::expired(unsigned seen, unsigned now) const {
+  return now > seen && now - seen > _window;
+}
+
+// Drops the expired keys, then resizes so the table is at most half full
+void PaylogDedupe::rehash(unsigned now) {
+  std::vector<unsigned long long> keys;
+  std::vector<unsigned> seen;
+  keys.swap(_keys);
+  seen.swap(_seen);
+
+  size_t live = 0;
+  for (size_t i = 0; i < keys.size(); ++i)
+    if (keys[i] && !expired(seen[i], now))
+      ++live;
+
+  size_t capacity = _MIN_CAPACITY;
+  while (capacity < live * 2)
+    capacity *= 2;
+  _keys.assign(capacity, 0);
+  _seen.assign(capacity, 0);
+  _evicted += _size - live;
+  _size = live;
+
+  size_t mask = capacity - 1;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (!keys[i] || expired(seen[i], now))
+      continue;
+    size_t slot = keys[i] & mask;
+    while (_keys[slot])
+      slot = (slot + 1) & mask;
+    _keys[slot] = keys[i];
+    _seen[slot] = seen[i];
+  }
+}
+
+size_t PaylogDedupe::filter(std::vector<CCInfo>& infos, unsigned now) {
+  // Applications of a card share the PAN, without one the entries cannot be told apart
+  unsigned long long card = 0;
+  for (CCInfo const& info : infos) {
+    Track2 const& t = info.track2();
+    if (t.pan[0]) {
+      card = Tools::hash(t.pan, strlen(t.pan));
+      break;
+    }
+  }
+
+  size_t fresh = 0;
+  for (CCInfo& info : infos)
+    for (size_t i = 0; i < info.logEntryCount(); ++i) {
+      _entries++;
+      if (!card || insert(key(card, info.logEntry(i)), now))
+	fresh++;
+      else
+	info.dropLogEntry(i);
+    }
+  _fresh += fresh;
+  return fresh;
+}
+
+void PaylogDedupe::print(std::ostream& out) const {
+  out << "Paylog dedupe: " << _fresh << " new entries out of " << _entries << ", "
+      << _size << " keys in " << _keys.size() << " slots, " << _evicted << " expired" << std::endl;
+}
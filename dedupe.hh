@@ -0,0 +1,67 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __DEDUPE_HH__
+# define __DEDUPE_HH__
+
+#include <vector>
+#include <iostream>
+
+#include "ccinfo.hh"
+
+/* Cards return their whole paylog on every tap. Only the entries not seen before are kept:
+   each entry is reduced to a 64-bit key of (PAN, ATC, date, time, amount) held in an open addressing
+   table with linear probing. A key is forgotten once it has not been seen for the window, which
+   happens when the entry has left the log of the card, so memory follows the cards seen recently.
+*/
+class PaylogDedupe {
+
+public:
+  PaylogDedupe(unsigned window = 30 * 24 * 3600);
+
+public:
+  // Drops the entries already seen from the applications, returns the number of new entries
+  size_t filter(std::vector<CCInfo>& infos, unsigned now);
+  bool insert(unsigned long long key, unsigned now);
+  void print(std::ostream& out = std::cerr) const;
+
+  static unsigned long long key(unsigned long long card, PaylogEntry const& entry);
+
+private:
+  bool expired(unsigned seen, unsigned now) const;
+  void rehash(unsigned now);
+
+private:
+  std::vector<unsigned long long> _keys; // 0 = free slot
+  std::vector<unsigned> _seen; // Last time each key was seen
+  size_t _size;
+  unsigned _window;
+
+  unsigned long long _entries;
+  unsigned long long _fresh;
+  unsigned long long _evicted;
+
+  static const size_t _MIN_CAPACITY = 1 << 12;
+};
+
+#endif // __DEDUPE_HH__
@@ -0,0 +1,542 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstring>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <map>
+
+#include "diffharness.hh"
+#include "apdufile.hh"
+#include "applicationhelper.hh"
+#include "ccinfo.hh"
+#include "tracedecoder.hh"
+
+static void addField(DecodedFields& fields, std::string const& name, void const* data, size_t size) {
+  fields.push_back(std::make_pair(name, std::string((char const*)data, size)));
+}
+
+static std::string entryField(size_t index, char const* name) {
+  return "entry[" + std::to_string((unsigned long long)index) + "]." + name;
+}
+
+// Short name of the fields of the entries, for the per field counts: entry.date
+static std::string fieldKind(std::string const& name) {
+  size_t close = name.find("].");
+  return close == std::string::npos ? name : "entry" + name.substr(close + 1);
+}
+
+/*
+  The current read path
+*/
+
+static void addEntryField(DecodedFields& fields, size_t index, unsigned short tag, PaylogEntry const& e) {
+  byte_t code[2];
+  switch (tag) {
+  case 0x9A:
+    addField(fields, entryField(index, "date"), e.date, sizeof(e.date));
+    break;
+  case 0x9F21:
+    addField(fields, entryField(index, "time"), e.time, sizeof(e.time));
+    break;
+  case 0x9F02:
+    addField(fields, entryField(index, "amount"), e.amount, sizeof(e.amount));
+    break;
+  case 0x5F2A:
+    code[0] = e.currency >> 8;
+    code[1] = e.currency;
+    addField(fields, entryField(index, "currency"), code, sizeof(code));
+    break;
+  case 0x9F1A:
+    code[0] = e.country >> 8;
+    code[1] = e.country;
+    addField(fields, entryField(index, "country"), code, sizeof(code));
+    break;
+  case 0x9C:
+    addField(fields, entryField(index, "type"), &e.type, 1);
+    break;
+  case 0x9F36:
+    code[0] = e.counter >> 8;
+    code[1] = e.counter;
+    addField(fields, entryField(index, "atc"), code, sizeof(code));
+    break;
+  case 0x9F27:
+    addField(fields, entryField(index, "cid"), &e.cryptoInfo, 1);
+    break;
+  case 0x9F4E:
+    addField(fields, entryField(index, "merchant"), e.merchant, e.merchantLength);
+    break;
+  }
+}
+
+static void decodeCCInfo(byte_t const* session, size_t size, std::vector<DecodedFields>& apps) {
+  static thread_local std::ostringstream log;
+  static thread_local std::vector<CCInfo> infos;
+
+  log.str("");
+  TraceDecoder::replay(session, size, infos, false, log);
+  apps.resize(infos.size());
+  for (size_t a = 0; a < infos.size(); ++a) {
+    CCInfo const& info = infos[a];
+    DecodedFields& fields = apps[a];
+    fields.clear();
+
+    Application const& application = info.application();
+    addField(fields, "aid", application.aid, sizeof(application.aid));
+    addField(fields, "name", application.name, strlen(application.name));
+    addField(fields, "priority", &application.priority, 1);
+    addField(fields, "language", info.languagePreference(), strlen(info.languagePreference()));
+    addField(fields, "cardholder", info.cardholderName(), strlen(info.cardholderName()));
+
+    size_t length;
+    byte_t const* data = info.track1Data(length);
+    addField(fields, "track1", data, length);
+    data = info.track2Data(length);
+    addField(fields, "track2", data, length);
+    Track2 const& t = info.track2();
+    addField(fields, "pan", t.pan, strlen(t.pan));
+    byte_t const expiry[2] = {t.expiryYear, t.expiryMonth};
+    addField(fields, "expiry", expiry, sizeof(expiry));
+
+    byte_t logCount = info.logCount();
+    addField(fields, "logcount", &logCount, 1);
+    std::string count = std::to_string((unsigned long long)info.logEntryCount());
+    addField(fields, "entries", count.data(), count.size());
+    std::vector<LogField> const& layout = info.logLayout();
+    for (size_t i = 0; i < info.logEntryCount(); ++i)
+      for (LogField const& f : layout)
+	addEntryField(fields, i, f.tag, info.logEntry(i));
+  }
+}
+
+/*
+  The parsing of the first release, over the same exchanges. Its logic is kept as it was: tags found by
+  scanning bytes, lengths trusted. Only the copies and reads are bounded, where it overflowed its buffers.
+*/
+
+struct LegacyApp {
+  Application application;
+  char language[56];
+  char cardholder[56];
+  APDU track1;
+  APDU track2;
+  byte_t logSFI;
+  byte_t logCount;
+  APDU logFormat;
+  std::vector<APDU> entries;
+};
+
+static size_t legacyCopy(void* to, size_t room, byte_t const* buff, size_t size, size_t i, size_t len) {
+  size_t n = std::min(len, std::min(room, i < size ? size - i : 0));
+  memcpy(to, buff + i, n);
+  return n;
+}
+
+static AppList legacyGetAll() {
+  AppList list;
+  APDU res = ApplicationHelper::executeCommand(Command::SELECT_PPSE, sizeof(Command::SELECT_PPSE), "SELECT PPSE");
+  if (res.size == 0)
+    return list;
+
+  // The first release walked the receive buffer, PN532 status byte included
+  byte_t rx[MAX_FRAME_LEN + 1] = {0};
+  memcpy(rx + 1, res.data, res.size);
+  size_t szRx = res.size + 1;
+
+  for (size_t i = 0; i < szRx; ++i) {
+    if (rx[i] != 0x61) // Application template
+      continue;
+    Application app;
+    memset(&app, 0, sizeof(app));
+    ++i;
+    while (i < szRx && rx[i] != 0x61) { // Until the end of the buffer or the next entry
+      if (rx[i] == 0x4F && i + 1 < szRx) { // Application ID
+	byte_t len = rx[++i];
+	i++;
+	legacyCopy(app.aid, sizeof(app.aid), rx, szRx, i, len);
+	i += len - 1;
+      }
+      if (i + 2 < szRx && rx[i] == 0x87) { // Application Priority indicator
+	i += 2;
+	app.priority = rx[i];
+      }
+      ++i;
+      if (i + 1 < szRx && rx[i] == 0x50) { // Application label
+	byte_t len = rx[++i];
+	i++;
+	app.name[legacyCopy(app.name, sizeof(app.name) - 1, rx, szRx, i, len)] = 0;
+	i += len - 1;
+      }
+    }
+    list.push_back(app);
+    --i;
+  }
+  return list;
+}
+
+static void legacyAppResponse(LegacyApp& app, APDU const& response) {
+  byte_t const* buff = response.data;
+  size_t size = response.size;
+
+  for (size_t i = 0; i < size; ++i) {
+    if (i + 2 < size && buff[i] == 0x5F && buff[i + 1] == 0x2D) { // Language preference
+      i += 2;
+      byte_t len = buff[i++];
+      legacyCopy(app.language, sizeof(app.language) - 1, buff, size, i, len);
+      i += len - 1;
+    }
+    else if (i + 2 < size && buff[i] == 0x9F && buff[i + 1] == 0x38) { // PDOL, skipped
+      i += 2;
+      byte_t len = buff[i++];
+      i += len - 1;
+    }
+    else if (i + 2 < size && buff[i] == 0xBF && buff[i + 1] == 0x0C) { // File Control Information
+      i += 2;
+      byte_t len = buff[i++];
+      for (size_t j = 0; j < len && i + j + 1 < size; ++j) {
+	if (j + 1 < len && buff[i + j] == 0x9F && buff[i + j + 1] == 0x4D) { // Log Entry
+	  j += 3; // Size = 2 so we don't save it
+	  if (i + j + 1 >= size)
+	    break;
+	  app.logSFI = buff[i + j++];
+	  app.logCount = buff[i + j];
+	}
+      }
+      i += len - 1;
+    }
+  }
+}
+
+static void legacyBaseRecords(LegacyApp& app) {
+  byte_t readRecord[sizeof(Command::READ_RECORD)];
+  memcpy(readRecord, Command::READ_RECORD, sizeof(readRecord));
+
+  for (size_t sfi = 1; sfi <= 2; ++sfi) {
+    readRecord[5] = (sfi << 3) | (1 << 2);
+    for (size_t record = 1; record <= 2; ++record) {
+      readRecord[4] = record;
+      APDU res = ApplicationHelper::executeCommand(readRecord, sizeof(readRecord), "READ RECORD BASE");
+      byte_t const* buff = res.data;
+      size_t size = res.size;
+
+      for (size_t i = 0; i < size; ++i) {
+	if (buff[i] == 0x57 && app.track2.size == 0 && i + 1 < size) { // Track 2 equivalent data
+	  i++;
+	  byte_t len = buff[i++];
+	  app.track2.size = legacyCopy(app.track2.data, sizeof(app.track2.data), buff, size, i, len);
+	  i += len - 1;
+	}
+	else if (i + 2 < size && buff[i] == 0x5F && buff[i + 1] == 0x20) { // Cardholder name
+	  i += 2;
+	  byte_t len = buff[i++];
+	  if (len > 2) // We dont save when the name is "/"
+	    legacyCopy(app.cardholder, sizeof(app.cardholder) - 1, buff, size, i, len);
+	  i += len - 1;
+	}
+	else if (i + 2 < size && app.track1.size == 0 && buff[i] == 0x9F && buff[i + 1] == 0x1F) { // Track 1
+	  i += 2;
+	  byte_t len = buff[i++];
+	  app.track1.size = legacyCopy(app.track1.data, sizeof(app.track1.data), buff, size, i, len);
+	  i += len - 1;
+	}
+      }
+    }
+  }
+}
+
+static void legacyLogEntries(LegacyApp& app) {
+  app.logFormat = ApplicationHelper::executeCommand(Command::GET_DATA_LOG_FORMAT, sizeof(Command::GET_DATA_LOG_FORMAT),
+						    "GET DATA LOG FORMAT");
+  if (app.logFormat.size == 0)
+    return;
+
+  byte_t readRecord[sizeof(Command::READ_RECORD)];
+  memcpy(readRecord, Command::READ_RECORD, sizeof(readRecord));
+  readRecord[5] = (app.logSFI << 3) | (1 << 2);
+  for (size_t i = 0; i < app.logCount && i < 0x20; ++i) {
+    readRecord[4] = i + 1;
+    APDU entry = ApplicationHelper::executeCommand(readRecord, sizeof(readRecord), "READ RECORD: LOGFILE");
+    if (entry.size == 0)
+      return;
+    app.entries.push_back(entry);
+  }
+}
+
+// The log format walked byte by byte, as printPaylog did: the GET DATA answer is taken whole
+static void legacyEntry(DecodedFields& fields, size_t index, APDU const& format, APDU const& entry) {
+  size_t size = format.size;
+  byte_t const* f = format.data;
+  size_t e = 0;
+
+  auto take = [&entry, &e] (size_t len) {
+    size_t n = std::min(len, e < (size_t)entry.size ? entry.size - e : 0);
+    std::string value((char const*)entry.data + e, n);
+    e += len;
+    return value;
+  };
+  auto code = [&entry, &e] () {
+    return e + 1 < (size_t)entry.size ? (unsigned short)(entry.data[e] << 8 | entry.data[e + 1]) : 0;
+  };
+
+  for (size_t i = 0; i < size; ++i) {
+    unsigned short tag = f[i];
+    if (tag != 0x9A && tag != 0x9C) {
+      if (i + 1 >= size)
+	continue;
+      tag = f[i] << 8 | f[i + 1];
+      if (tag != 0x9F21 && tag != 0x5F2A && tag != 0x9F02 && tag != 0x9F4E && tag != 0x9F36 && tag != 0x9F1A
+	  && tag != 0x9F27)
+	continue;
+      i++;
+    }
+    if (++i >= size)
+      break;
+    size_t len = f[i];
+
+    switch (tag) {
+    case 0x9A:
+      fields.push_back(std::make_pair(entryField(index, "date"), take(len)));
+      break;
+    case 0x9C:
+      fields.push_back(std::make_pair(entryField(index, "type"), take(1)));
+      break;
+    case 0x9F21:
+      fields.push_back(std::make_pair(entryField(index, "time"), take(len)));
+      break;
+    case 0x5F2A:
+      fields.push_back(std::make_pair(entryField(index, "currency"), take(CCInfo::currencyName(code()) ? 2 : len)));
+      break;
+    case 0x9F1A:
+      fields.push_back(std::make_pair(entryField(index, "country"), take(CCInfo::countryName(code()) ? 2 : len)));
+      break;
+    case 0x9F02:
+      fields.push_back(std::make_pair(entryField(index, "amount"), take(len)));
+      break;
+    case 0x9F4E:
+      fields.push_back(std::make_pair(entryField(index, "merchant"), take(len)));
+      break;
+    case 0x9F36:
+      fields.push_back(std::make_pair(entryField(index, "atc"), take(len)));
+      break;
+    case 0x9F27:
+      fields.push_back(std::make_pair(entryField(index, "cid"), take(len)));
+      break;
+    }
+  }
+}
+
+static void decodeLegacy(byte_t const* session, size_t size, std::vector<DecodedFields>& apps) {
+  TraceDecoder::present(session, size);
+  AppList list = legacyGetAll();
+
+  apps.clear();
+  for (Application const& a : list) {
+    APDU res = ApplicationHelper::selectByPriority(list, a.priority);
+    if (res.size == 0)
+      continue;
+    LegacyApp app = LegacyApp();
+    app.application = a;
+    legacyAppResponse(app, res);
+    legacyBaseRecords(app);
+    legacyLogEntries(app);
+
+    apps.push_back(DecodedFields());
+    DecodedFields& fields = apps.back();
+    addField(fields, "aid", app.application.aid, sizeof(app.application.aid));
+    addField(fields, "name", app.application.name, strlen(app.application.name));
+    addField(fields, "priority", &app.application.priority, 1);
+    addField(fields, "language", app.language, strlen(app.language));
+    addField(fields, "cardholder", app.cardholder, strlen(app.cardholder));
+    addField(fields, "track1", app.track1.data, app.track1.size);
+    addField(fields, "track2", app.track2.data, app.track2.size);
+
+    // The PAN was printed as the first 8 bytes of track 2, the expiry taken right after them
+    std::string pan;
+    for (size_t i = 0; i < 8; ++i) {
+      char digits[2];
+      Tools::toHex(app.track2.data + i, 1, digits);
+      pan.append(digits, 2);
+    }
+    fields.push_back(std::make_pair("pan", pan));
+    byte_t const* t = app.track2.data;
+    byte_t const expiry[2] = {(byte_t)(t[8] << 4 | t[9] >> 4), (byte_t)(t[9] << 4 | t[10] >> 4)};
+    addField(fields, "expiry", expiry, sizeof(expiry));
+
+    addField(fields, "logcount", &app.logCount, 1);
+    std::string count = std::to_string((unsigned long long)app.entries.size());
+    addField(fields, "entries", count.data(), count.size());
+    for (size_t i = 0; i < app.entries.size(); ++i)
+      legacyEntry(fields, i, app.logFormat, app.entries[i]);
+  }
+}
+
+struct DiffDecoderEntry {
+  char const* name;
+  DiffDecoder decode;
+};
+
+static const DiffDecoderEntry DIFF_DECODERS[] = {
+  {"legacy", decodeLegacy},
+  {"ccinfo", decodeCCInfo}
+};
+
+DiffDecoder DiffHarness::find(std::string const& name) {
+  for (DiffDecoderEntry const& d : DIFF_DECODERS)
+    if (name == d.name)
+      return d.decode;
+  return NULL;
+}
+
+/*
+  Comparison
+*/
+
+struct DiffCounts {
+  unsigned long long compared;
+  unsigned long long mismatches;
+  unsigned long long onlyFirst;
+  unsigned long long onlySecond;
+};
+
+static void printValue(std::string const& value, std::ostream& out) {
+  std::string text(2 * value.size(), ' ');
+  Tools::toHex((byte_t const*)value.data(), value.size(), &text[0]);
+  out << text << " \"";
+  text.resize(value.size());
+  Tools::toPrintable((byte_t const*)value.data(), value.size(), &text[0]);
+  out << text << "\"";
+}
+
+int DiffHarness::run(std::vector<char const*> const& paths, char const* decoders, size_t details, std::ostream& out) {
+  std::string names[2];
+  char const* comma = strchr(decoders, ',');
+  names[0] = comma ? std::string(decoders, comma) : "legacy";
+  names[1] = comma ? std::string(comma + 1) : decoders;
+  DiffDecoder decode[2] = {find(names[0]), find(names[1])};
+  for (int d = 0; d < 2; ++d)
+    if (!decode[d]) {
+      std::cerr << "Unknown decoder: " << names[d] << " (legacy, ccinfo)" << std::endl;
+      return 1;
+    }
+
+  std::map<std::string, DiffCounts> counts;
+  std::vector<DecodedFields> apps[2];
+  double elapsed[2] = {0, 0};
+  unsigned long long sessions = 0, bytes = 0, applications[2] = {0, 0};
+  size_t printed = 0;
+
+  for (char const* path : paths) {
+    ApduFile file;
+    if (file.open(path))
+      return 1;
+
+    byte_t const* session;
+    size_t size;
+    for (size_t offset = file.tell(); file.nextSession(session, size); offset = file.tell()) {
+      ++sessions;
+      bytes += size;
+      for (int d = 0; d < 2; ++d) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	decode[d](session, size, apps[d]);
+	elapsed[d] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	applications[d] += apps[d].size();
+      }
+
+      // Applications are paired by AID, the first field, in order: one decoder may miss or repeat some
+      std::vector<std::pair<int, int> > pairs;
+      std::vector<bool> paired(apps[1].size(), false);
+      for (size_t a = 0; a < apps[0].size(); ++a) {
+	int match = -1;
+	for (size_t b = 0; b < apps[1].size() && match < 0; ++b)
+	  if (!paired[b] && apps[0][a][0].second == apps[1][b][0].second)
+	    match = b;
+	if (match >= 0)
+	  paired[match] = true;
+	pairs.push_back(std::make_pair((int)a, match));
+      }
+      for (size_t b = 0; b < apps[1].size(); ++b)
+	if (!paired[b])
+	  pairs.push_back(std::make_pair(-1, (int)b));
+
+      for (std::pair<int, int> const& p : pairs) {
+	static DecodedFields const none;
+	DecodedFields const& first = p.first >= 0 ? apps[0][p.first] : none;
+	DecodedFields const& second = p.second >= 0 ? apps[1][p.second] : none;
+	int a = p.first >= 0 ? p.first : p.second;
+	if ((p.first < 0 || p.second < 0) && printed++ < details) {
+	  out << path << "@" << offset << " application " << a << " only decoded by "
+	      << names[p.first >= 0 ? 0 : 1] << ", aid ";
+	  printValue((p.first >= 0 ? first : second)[0].second, out);
+	  out << std::endl;
+	}
+
+	std::map<std::string, std::string const*> values;
+	for (std::pair<std::string, std::string> const& f : second)
+	  values[f.first] = &f.second;
+	for (std::pair<std::string, std::string> const& f : first) {
+	  DiffCounts& c = counts[fieldKind(f.first)];
+	  std::map<std::string, std::string const*>::iterator it = values.find(f.first);
+	  if (it == values.end()) {
+	    c.onlyFirst++;
+	    continue;
+	  }
+	  c.compared++;
+	  if (*it->second != f.second) {
+	    c.mismatches++;
+	    if (printed++ < details) {
+	      out << path << "@" << offset << " application " << a << " " << f.first << ":" << std::endl << "  "
+		  << names[0] << ": ";
+	      printValue(f.second, out);
+	      out << std::endl << "  " << names[1] << ": ";
+	      printValue(*it->second, out);
+	      out << std::endl;
+	    }
+	  }
+	  values.erase(it);
+	}
+	for (std::map<std::string, std::string const*>::const_iterator it = values.begin(); it != values.end(); ++it)
+	  counts[fieldKind(it->first)].onlySecond++;
+      }
+    }
+  }
+
+  out << "-- Differential decoding: " << names[0] << " against " << names[1] << " --" << std::endl;
+  out << sessions << " session(s), " << bytes << " bytes" << std::endl;
+  for (int d = 0; d < 2; ++d)
+    out << names[d] << ": " << applications[d] << " application(s) in " << elapsed[d] << "s, "
+	<< (elapsed[d] > 0 ? sessions / elapsed[d] : 0) << " sessions/s, "
+	<< (elapsed[d] > 0 ? bytes / elapsed[d] / 1e6 : 0) << " MB/s" << std::endl;
+
+  unsigned long long mismatches = 0;
+  out << std::left << std::setw(18) << "field" << std::right << std::setw(12) << "compared" << std::setw(12)
+      << "mismatches" << std::setw(14) << "only first" << std::setw(14) << "only second" << std::endl;
+  for (std::map<std::string, DiffCounts>::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+    DiffCounts const& c = it->second;
+    out << std::left << std::setw(18) << it->first << std::right << std::setw(12) << c.compared << std::setw(12)
+	<< c.mismatches << std::setw(14) << c.onlyFirst << std::setw(14) << c.onlySecond << std::endl;
+    mismatches += c.mismatches + c.onlyFirst + c.onlySecond;
+  }
+  if (printed > details)
+    out << printed - details << " more mismatch(es) not shown, see --top" << std::endl;
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __DIFFHARNESS_HH__
+# define __DIFFHARNESS_HH__
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "tools.hh"
+
+// Fields decoded from one application, name and raw bytes, in the order they were decoded
+typedef std::vector<std::pair<std::string, std::string> > DecodedFields;
+
+// Decodes every application of a recorded session
+typedef void (*DiffDecoder)(byte_t const* session, size_t size, std::vector<DecodedFields>& apps);
+
+/* Runs two decoders side by side over recorded sessions (--record traces or corpora) and compares
+   what they extract, field by field: the applications from getAll, the SELECT answer, the base records,
+   track 2 and the paylog entries. Each decoder is timed on its own.
+     legacy  the parsing of the first release: byte scans for the tags, the PAN as the first 8 bytes of
+	     track 2, the paylog walked along the log format (copies bounded to the buffers)
+     ccinfo  the current read path, CardReader and CCInfo, every lazy field forced
+   A new implementation is added to the decoder table and compared with --diff-decoders ccinfo,NAME.
+*/
+class DiffHarness {
+
+public:
+  static int run(std::vector<char const*> const& paths, char const* decoders, size_t details,
+		 std::ostream& out = std::cout);
+  static DiffDecoder find(std::string const& name);
+};
+
+#endif // __DIFFHARNESS_HH__
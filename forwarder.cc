@@ -0,0 +1,662 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "forwarder.hh"
+
+const char Forwarder::_MAGIC[4] = {'R', 'C', 'C', 'B'};
+const std::chrono::milliseconds Forwarder::_FLUSH_INTERVAL(1000);
+const std::chrono::milliseconds Forwarder::_MAX_BACKOFF(30000);
+const std::chrono::seconds Forwarder::_STOP_TIMEOUT(5);
+
+static const std::chrono::milliseconds FIRST_BACKOFF(250);
+
+static void put16(std::string& out, unsigned short value) {
+  out += (char)value;
+  out += (char)(value >> 8);
+}
+
+static void put32(std::string& out, unsigned int value) {
+  for (int i = 0; i < 4; ++i)
+    out += (char)(value >> (8 * i));
+}
+
+static void put64(std::string& out, unsigned long long value) {
+  for (int i = 0; i < 8; ++i)
+    out += (char)(value >> (8 * i));
+}
+
+static void putVarint(std::string& out, unsigned long long value) {
+  for (; value >= 0x80; value >>= 7)
+    out += (char)(value | 0x80);
+  out += (char)value;
+}
+
+static void putBytes(std::string& out, void const* data, size_t size) {
+  size = std::min<size_t>(size, 0xFF);
+  out += (char)size;
+  if (size > 0)
+    out.append((char const*)data, size);
+}
+
+static unsigned long long get64(byte_t const* p) {
+  unsigned long long value = 0;
+  for (int i = 7; i >= 0; --i)
+    value = value << 8 | p[i];
+  return value;
+}
+
+// Bounds checked reading of a record, ok turns false past the end
+struct ForwardReader {
+  byte_t const* cursor;
+  byte_t const* end;
+  bool ok;
+
+  byte_t byte() {
+    if (cursor >= end) {
+      ok = false;
+      return 0;
+    }
+    return *cursor++;
+  }
+
+  unsigned short u16() {
+    unsigned short value = byte();
+    return value | byte() << 8;
+  }
+
+  unsigned long long varint() {
+    unsigned long long value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      byte_t b = byte();
+      value |= (unsigned long long)(b & 0x7F) << shift;
+      if (!(b & 0x80))
+	break;
+    }
+    return value;
+  }
+
+  void bytes(void* out, size_t size) {
+    if ((size_t)(end - cursor) < size) {
+      ok = false;
+      memset(out, 0, size);
+      return;
+    }
+    memcpy(out, cursor, size);
+    cursor += size;
+  }
+
+  std::string string() {
+    std::string value(byte(), 0);
+    bytes(&value[0], value.size());
+    return value;
+  }
+};
+
+static std::string hex(void const* data, size_t size) {
+  static char const digits[] = "0123456789ABCDEF";
+  std::string text;
+  for (size_t i = 0; i < size; ++i) {
+    text += digits[((byte_t const*)data)[i] >> 4];
+    text += digits[((byte_t const*)data)[i] & 0x0F];
+  }
+  return text;
+}
+
+/* One record per card:
+     applications (1) then for each: priority (1) | name | AID (7) | language | cardholder | track 1 | track 2
+       | log count (1) | entries (1) then for each entry:
+	 date (3) | time (3) | amount in minor units (varint) | currency (2) | country (2) | type (1)
+	 | ATC (2) | crypto info (1) | merchant
+   Variable fields are a length byte then the bytes. Entries dropped by --dedupe are left out.
+*/
+void Forwarder::encode(std::vector<CCInfo> const& infos, std::string& out) {
+  out += (char)std::min<size_t>(infos.size(), 0xFF);
+  for (size_t i = 0; i < infos.size() && i < 0xFF; ++i) {
+    CCInfo const& info = infos[i];
+    Application const& application = info.application();
+    size_t size;
+    byte_t const* data;
+
+    out += (char)application.priority;
+    putBytes(out, application.name, strnlen(application.name, sizeof(application.name)));
+    out.append((char const*)application.aid, sizeof(application.aid));
+    putBytes(out, info.languagePreference(), strlen(info.languagePreference()));
+    putBytes(out, info.cardholderName(), strlen(info.cardholderName()));
+    data = info.track1Data(size);
+    putBytes(out, data, size);
+    data = info.track2Data(size);
+    putBytes(out, data, size);
+    out += (char)info.logCount();
+
+    size_t entries = 0;
+    for (size_t j = 0; j < info.logEntryCount(); ++j)
+      entries += !info.logEntryDropped(j);
+    out += (char)entries;
+
+    for (size_t j = 0; j < info.logEntryCount(); ++j) {
+      if (info.logEntryDropped(j))
+	continue;
+      PaylogEntry const& e = info.logEntry(j);
+      out.append((char const*)e.date, sizeof(e.date));
+      out.append((char const*)e.time, sizeof(e.time));
+      putVarint(out, e.amountValue);
+      put16(out, e.currency);
+      put16(out, e.country);
+      out += (char)e.type;
+      put16(out, e.counter);
+      out += (char)e.cryptoInfo;
+      putBytes(out, e.merchant, e.merchantLength);
+    }
+  }
+}
+
+// Reads one record into card, as TextImport would have parsed it from the text of the card
+bool Forwarder::decode(byte_t const*& cursor, byte_t const* end, ImportedCard& card) {
+  ForwardReader in = {cursor, end, true};
+
+  card.apps.resize(in.byte());
+  for (ImportedApp& app : card.apps) {
+    byte_t aid[sizeof(((Application*)NULL)->aid)];
+
+    app.priority = in.byte();
+    app.name = in.string();
+    in.bytes(aid, sizeof(aid));
+    app.aid = hex(aid, sizeof(aid));
+    app.languagePreference = in.string();
+    app.cardholderName = in.string();
+    std::string track = in.string();
+    app.track1 = hex(track.data(), track.size());
+    track = in.string();
+    app.track2 = hex(track.data(), track.size());
+    CCInfo::decodeTrack2((byte_t const*)track.data(), track.size(), app.tracks);
+    app.logCount = in.byte();
+
+    app.paylog.resize(in.byte());
+    for (PaylogEntry& e : app.paylog) {
+      memset(&e, 0, sizeof(e));
+      in.bytes(e.date, sizeof(e.date));
+      in.bytes(e.time, sizeof(e.time));
+      e.amountValue = in.varint();
+      unsigned long long amount = e.amountValue;
+      for (int j = sizeof(e.amount) - 1; j >= 0; --j, amount /= 100)
+	e.amount[j] = (amount % 100 / 10) << 4 | amount % 10;
+      e.currency = in.u16();
+      e.currencyName = CCInfo::currencyName(e.currency);
+      e.country = in.u16();
+      e.countryName = CCInfo::countryName(e.country);
+      e.type = in.byte();
+      e.counter = in.u16();
+      e.cryptoInfo = in.byte();
+      std::string merchant = in.string();
+      e.merchantLength = std::min(merchant.size(), sizeof(e.merchant));
+      memcpy(e.merchant, merchant.data(), e.merchantLength);
+    }
+  }
+
+  cursor = in.cursor;
+  return in.ok;
+}
+
+bool Forwarder::parseHeader(byte_t const* header, unsigned& payload, unsigned long long& sequence,
+			    unsigned& records) {
+  if (memcmp(header, _MAGIC, sizeof(_MAGIC)))
+    return false;
+  payload = header[4] | header[5] << 8 | header[6] << 16 | (unsigned)header[7] << 24;
+  sequence = get64(header + 8);
+  records = header[16] | header[17] << 8 | header[18] << 16 | (unsigned)header[19] << 24;
+  return true;
+}
+
+Forwarder::Forwarder()
+  : _currentRecords(0),
+    _sequence(0),
+    _stopping(false),
+    _socket(-1),
+    _backoff(FIRST_BACKOFF),
+    _spool(-1),
+    _spoolSize(0),
+    _spoolSent(0),
+    _spoolAcked(0)
+{
+  memset(&_metrics, 0, sizeof(_metrics));
+}
+
+Forwarder::~Forwarder() {
+  stop();
+  if (_spool >= 0)
+    close(_spool);
+}
+
+int Forwarder::start(char const* address, char const* spool, char const* metrics) {
+  std::string a(address);
+  size_t colon = a.rfind(':');
+  if (colon == std::string::npos || colon == 0 || colon + 1 == a.size()) {
+    std::cerr << "Invalid collector address, expected HOST:PORT: " << address << std::endl;
+    return 1;
+  }
+  _host = a.substr(0, colon);
+  _port = a.substr(colon + 1);
+
+  if (spool && openSpool(spool))
+    return 1;
+  if (metrics)
+    _metricsPath = metrics;
+
+  // Sequences keep growing across restarts, the spool may hold older ones
+  _sequence = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  _started = _nextConnect = std::chrono::steady_clock::now();
+  _thread = std::thread(&Forwarder::run, this);
+  return 0;
+}
+
+// Keeps the complete frames left by a previous run, they are sent first
+int Forwarder::openSpool(char const* path) {
+  _spool = open(path, O_RDWR | O_CREAT, 0600);
+  if (_spool < 0) {
+    perror(path);
+    return 1;
+  }
+
+  byte_t header[HEADER_SIZE];
+  unsigned payload, records;
+  unsigned long long sequence;
+  off_t size = lseek(_spool, 0, SEEK_END);
+  off_t offset = 0;
+  while (pread(_spool, header, sizeof(header), offset) == sizeof(header)
+	 && parseHeader(header, payload, sequence, records)
+	 && offset + (off_t)sizeof(header) + payload <= size) {
+    offset += sizeof(header) + payload;
+    _metrics.spoolBatches++;
+  }
+  if (offset < size && ftruncate(_spool, offset) != 0) {
+    perror(path);
+    return 1;
+  }
+
+  _spoolSize = offset;
+  _metrics.spoolBytes = _spoolSize;
+  return 0;
+}
+
+void Forwarder::add(std::vector<CCInfo> const& infos) {
+  if (infos.empty())
+    return;
+
+  std::string record;
+  encode(infos, record);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_currentRecords == 0)
+    _currentStart = std::chrono::steady_clock::now();
+  _current += record;
+  _currentRecords++;
+  _metrics.records++;
+  if (_currentRecords >= _BATCH_RECORDS) {
+    seal();
+    _wake.notify_one();
+  }
+}
+
+// With the lock held
+void Forwarder::seal() {
+  if (_currentRecords == 0)
+    return;
+
+  ForwardBatch batch;
+  batch.sequence = _sequence++;
+  batch.records = _currentRecords;
+  batch.spoolEnd = -1;
+  batch.frame.reserve(HEADER_SIZE + _current.size());
+  batch.frame.append(_MAGIC, sizeof(_MAGIC));
+  put32(batch.frame, _current.size());
+  put64(batch.frame, batch.sequence);
+  put32(batch.frame, batch.records);
+  batch.frame += _current;
+  _queue.push_back(batch);
+
+  _current.clear();
+  _currentRecords = 0;
+}
+
+// Sends what is left for up to _STOP_TIMEOUT, then spools or drops it
+void Forwarder::stop() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _wake.notify_one();
+  if (_thread.joinable())
+    _thread.join();
+}
+
+/* With the lock held. Moves the queue to the spool, or bounds it when there is no spool.
+   The queue is taken out and the lock released while writing, so add() never waits for the disk.
+*/
+void Forwarder::spill(std::unique_lock<std::mutex>& lock) {
+  if (_spool < 0) {
+    while (_queue.size() > _MAX_QUEUE) {
+      _metrics.dropped += _queue.front().records;
+      _queue.pop_front();
+    }
+    return;
+  }
+  if (_queue.empty())
+    return;
+
+  std::deque<ForwardBatch> batches;
+  batches.swap(_queue);
+  lock.unlock();
+  size_t written = 0;
+  for (; written < batches.size(); ++written) {
+    std::string const& frame = batches[written].frame;
+    if (pwrite(_spool, frame.data(), frame.size(), _spoolSize) != (ssize_t)frame.size()) {
+      perror("Spool");
+      break;
+    }
+    _spoolSize += frame.size();
+  }
+  lock.lock();
+
+  // What could not be written stays ahead of the batches queued meanwhile
+  _queue.insert(_queue.begin(), batches.begin() + written, batches.end());
+  _metrics.spoolBatches += written;
+  _metrics.spoolBytes = _spoolSize;
+}
+
+// Without the lock, the spool belongs to the thread
+bool Forwarder::readSpool(ForwardBatch& batch) {
+  byte_t header[HEADER_SIZE];
+  unsigned payload;
+  if (pread(_spool, header, sizeof(header), _spoolSent) == sizeof(header)
+      && parseHeader(header, payload, batch.sequence, batch.records)) {
+    batch.frame.resize(sizeof(header) + payload);
+    if (pread(_spool, &batch.frame[0], batch.frame.size(), _spoolSent) == (ssize_t)batch.frame.size()) {
+      _spoolSent += batch.frame.size();
+      batch.spoolEnd = _spoolSent;
+      return true;
+    }
+  }
+  std::cerr << "Spool corrupted after " << _spoolSent << " bytes, dropped" << std::endl;
+  _spoolSize = _spoolSent;
+  if (ftruncate(_spool, _spoolSize) != 0)
+    perror("Spool");
+  return false;
+}
+
+// With the lock held, released while reading the spool. The spool goes first, it holds the oldest batches
+bool Forwarder::next(ForwardBatch& batch, std::unique_lock<std::mutex>& lock) {
+  if (_spool >= 0 && _spoolSent < _spoolSize) {
+    lock.unlock();
+    bool spooled = readSpool(batch);
+    lock.lock();
+    if (spooled)
+      return true;
+  }
+
+  if (_queue.empty())
+    return false;
+  batch = _queue.front();
+  _queue.pop_front();
+  return true;
+}
+
+// Without the lock, only the thread touches the socket
+bool Forwarder::connect() {
+  struct addrinfo hints;
+  struct addrinfo* addresses;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(_host.c_str(), _port.c_str(), &hints, &addresses) != 0)
+    return false;
+
+  for (struct addrinfo* a = addresses; a && _socket < 0; a = a->ai_next) {
+    int fd = socket(a->ai_family, a->ai_socktype | SOCK_NONBLOCK, a->ai_protocol);
+    if (fd < 0)
+      continue;
+
+    // Bounded wait, the host may drop the SYN
+    struct pollfd p = {fd, POLLOUT, 0};
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if ((::connect(fd, a->ai_addr, a->ai_addrlen) == 0 || errno == EINPROGRESS)
+	&& poll(&p, 1, 2000) == 1
+	&& getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) {
+      int one = 1;
+      struct timeval timeout = {5, 0};
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      _socket = fd;
+    }
+    else
+      close(fd);
+  }
+  freeaddrinfo(addresses);
+  return _socket >= 0;
+}
+
+// With the lock held. Unacknowledged batches are sent again after reconnecting
+void Forwarder::disconnect() {
+  close(_socket);
+  _socket = -1;
+  _acks.clear();
+
+  _spoolSent = _spoolAcked;
+  for (std::deque<ForwardBatch>::reverse_iterator it = _inFlight.rbegin(); it != _inFlight.rend(); ++it)
+    if (it->spoolEnd < 0)
+      _queue.push_front(*it);
+  _inFlight.clear();
+
+  _nextConnect = std::chrono::steady_clock::now() + _backoff;
+  _backoff = std::min(_backoff * 2, _MAX_BACKOFF);
+}
+
+// Without the lock
+bool Forwarder::send(ForwardBatch const& batch) {
+  for (size_t sent = 0; sent < batch.frame.size(); ) {
+    ssize_t n = ::send(_socket, batch.frame.data() + sent, batch.frame.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    sent += n;
+  }
+  return true;
+}
+
+// Without the lock. Waits up to timeout ms for answers, false when the connection is gone
+bool Forwarder::receiveAcks(int timeout) {
+  struct pollfd p = {_socket, POLLIN, 0};
+  if (poll(&p, 1, timeout) <= 0)
+    return true;
+
+  char buffer[4096];
+  ssize_t n = recv(_socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+  if (n < 0)
+    return errno == EINTR || errno == EAGAIN;
+  if (n == 0)
+    return false;
+  _acks.append(buffer, n);
+  return true;
+}
+
+void Forwarder::run() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  std::chrono::steady_clock::time_point deadline;
+  std::chrono::steady_clock::time_point lastMetrics = std::chrono::steady_clock::now();
+
+  while (true) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (_currentRecords > 0 && (_stopping || now - _currentStart >= _FLUSH_INTERVAL))
+      seal();
+    if (_stopping && deadline == std::chrono::steady_clock::time_point())
+      deadline = now + _STOP_TIMEOUT;
+    if (_stopping && ((_queue.empty() && _inFlight.empty() && _spoolAcked == _spoolSize) || now >= deadline))
+      break;
+
+    if (_socket < 0) {
+      spill(lock);
+      if (now >= _nextConnect) {
+	lock.unlock();
+	bool connected = connect();
+	lock.lock();
+	if (connected) {
+	  _metrics.reconnects += _metrics.batchesAcked > 0 || _metrics.reconnects > 0;
+	  _backoff = FIRST_BACKOFF;
+	}
+	else {
+	  _nextConnect = now + _backoff;
+	  _backoff = std::min(_backoff * 2, _MAX_BACKOFF);
+	}
+      }
+    }
+    else if (_queue.size() > _MAX_QUEUE)
+      spill(lock);
+
+    ForwardBatch batch;
+    while (_socket >= 0 && _inFlight.size() < _WINDOW && next(batch, lock)) {
+      _inFlight.push_back(batch);
+      lock.unlock();
+      bool sent = send(_inFlight.back());
+      lock.lock();
+      if (!sent)
+	disconnect();
+    }
+
+    if (_socket >= 0 && !_inFlight.empty()) {
+      lock.unlock();
+      bool connected = receiveAcks(50);
+      lock.lock();
+
+      for (; connected && _acks.size() >= 8; _acks.erase(0, 8)) {
+	unsigned long long sequence = get64((byte_t const*)_acks.data());
+	if (_inFlight.empty() || _inFlight.front().sequence != sequence) {
+	  std::cerr << "Collector acknowledged an unexpected batch " << sequence << std::endl;
+	  connected = false;
+	  break;
+	}
+
+	ForwardBatch const& acked = _inFlight.front();
+	_metrics.recordsAcked += acked.records;
+	_metrics.batchesAcked++;
+	_metrics.bytesAcked += acked.frame.size();
+	if (acked.spoolEnd >= 0) {
+	  _spoolAcked = acked.spoolEnd;
+	  _metrics.spoolBatches--;
+	}
+	_inFlight.pop_front();
+      }
+      if (!connected)
+	disconnect();
+
+      // Everything spooled went through
+      if (_spoolSize > 0 && _spoolAcked == _spoolSize) {
+	lock.unlock();
+	if (ftruncate(_spool, 0) != 0)
+	  perror("Spool");
+	lock.lock();
+	_spoolSize = _spoolSent = _spoolAcked = 0;
+      }
+    }
+    else
+      _wake.wait_for(lock, std::chrono::milliseconds(50));
+
+    _metrics.inFlight = _inFlight.size();
+    _metrics.queued = _queue.size();
+    _metrics.spoolBytes = _spoolSize - _spoolAcked;
+    if (!_metricsPath.empty() && now - lastMetrics >= std::chrono::seconds(1)) {
+      lastMetrics = now;
+      lock.unlock();
+      writeMetrics();
+      lock.lock();
+    }
+  }
+
+  if (_socket >= 0)
+    disconnect();
+  spill(lock);
+  for (ForwardBatch const& batch : _queue)
+    _metrics.dropped += batch.records;
+  _queue.clear();
+  _metrics.inFlight = 0;
+  _metrics.queued = 0;
+  _metrics.spoolBytes = _spoolSize - _spoolAcked;
+
+  lock.unlock();
+  if (!_metricsPath.empty())
+    writeMetrics();
+}
+
+ForwardMetrics Forwarder::metrics() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _metrics;
+}
+
+// Text exposition format, replaced atomically, for a node exporter textfile collector or a plain cat
+void Forwarder::writeMetrics() {
+  ForwardMetrics m = metrics();
+  std::string tmp = _metricsPath + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "w");
+  if (!file) {
+    perror(tmp.c_str());
+    return;
+  }
+
+  fprintf(file, "readcc_forward_records_total %llu\n", m.records);
+  fprintf(file, "readcc_forward_records_acked_total %llu\n", m.recordsAcked);
+  fprintf(file, "readcc_forward_batches_acked_total %llu\n", m.batchesAcked);
+  fprintf(file, "readcc_forward_bytes_acked_total %llu\n", m.bytesAcked);
+  fprintf(file, "readcc_forward_records_dropped_total %llu\n", m.dropped);
+  fprintf(file, "readcc_forward_reconnects_total %llu\n", m.reconnects);
+  fprintf(file, "readcc_forward_batches_in_flight %zu\n", m.inFlight);
+  fprintf(file, "readcc_forward_batches_queued %zu\n", m.queued);
+  fprintf(file, "readcc_forward_spool_batches %zu\n", m.spoolBatches);
+  fprintf(file, "readcc_forward_spool_bytes %llu\n", m.spoolBytes);
+  if (fclose(file) != 0 || rename(tmp.c_str(), _metricsPath.c_str()) != 0)
+    perror(_metricsPath.c_str());
+}
+
+void Forwarder::print(std::ostream& out) const {
+  ForwardMetrics m = metrics();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - _started).count();
+  out << "Forwarder: " << m.records << " card(s) added, " << m.recordsAcked << " acknowledged in "
+      << m.batchesAcked << " batch(es), " << m.bytesAcked << " bytes, "
+      << (elapsed > 0 ? m.recordsAcked / elapsed : 0) << " cards/s, "
+      << m.spoolBatches << " batch(es) spooled (" << m.spoolBytes << " bytes), "
+      << m.reconnects << " reconnect(s), " << m.dropped << " card(s) dropped" << std::endl;
+}
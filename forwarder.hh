@@ -0,0 +1,142 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __FORWARDER_HH__
+# define __FORWARDER_HH__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+
+#include "ccinfo.hh"
+#include "textimport.hh"
+
+// A sealed batch, in memory or in the spool
+struct ForwardBatch {
+  unsigned long long sequence;
+  unsigned int records;
+  std::string frame; // Header included
+  long long spoolEnd; // Spool offset after the frame, -1 if the batch is not spooled
+};
+
+struct ForwardMetrics {
+  unsigned long long records; // Handed to the forwarder
+  unsigned long long recordsAcked;
+  unsigned long long batchesAcked;
+  unsigned long long bytesAcked;
+  unsigned long long dropped; // Records lost, without spool or left at exit
+  unsigned long long reconnects;
+  size_t inFlight;
+  size_t queued; // Sealed batches in memory
+  size_t spoolBatches;
+  unsigned long long spoolBytes;
+};
+
+/* Sends finished cards to a collector over a persistent TCP connection.
+   Cards are encoded in a compact binary record and grouped in batches, sealed at _BATCH_RECORDS records
+   or after _FLUSH_INTERVAL. A frame is
+     "RCCB" | payload length (4) | sequence (8) | records (4) | records        integers little endian
+   and the collector answers with the sequence of each frame, in order. Up to _WINDOW frames are sent
+   before the first answer. When the collector cannot be reached, or the queue grows past _MAX_QUEUE,
+   sealed batches are appended to the spool file, which is sent first after reconnecting and emptied once
+   acknowledged. Batches not acknowledged when the connection drops are sent again, so a collector may see
+   a sequence twice.
+   A thread owns the connection and the spool: add() only encodes and queues, it never blocks on the network
+   or the disk.
+*/
+class Forwarder {
+
+public:
+  Forwarder();
+  ~Forwarder();
+
+public:
+  int start(char const* address, char const* spool = NULL, char const* metrics = NULL);
+  void add(std::vector<CCInfo> const& infos);
+  void stop();
+  ForwardMetrics metrics() const;
+  void print(std::ostream& out = std::cerr) const;
+
+  static void encode(std::vector<CCInfo> const& infos, std::string& out);
+  static bool decode(byte_t const*& cursor, byte_t const* end, ImportedCard& card);
+  static bool parseHeader(byte_t const* header, unsigned& payload, unsigned long long& sequence, unsigned& records);
+
+  static const size_t HEADER_SIZE = 20;
+
+private:
+  void run();
+  void seal();
+  bool connect();
+  void disconnect();
+  bool next(ForwardBatch& batch, std::unique_lock<std::mutex>& lock);
+  bool readSpool(ForwardBatch& batch);
+  bool send(ForwardBatch const& batch);
+  bool receiveAcks(int timeout);
+  void spill(std::unique_lock<std::mutex>& lock);
+  int openSpool(char const* path);
+  void writeMetrics();
+
+private:
+  std::string _host;
+  std::string _port;
+  std::string _metricsPath;
+  std::thread _thread;
+  std::chrono::steady_clock::time_point _started;
+
+  // Shared with the readers
+  mutable std::mutex _mutex;
+  std::condition_variable _wake;
+  std::string _current; // Records of the batch being filled
+  unsigned int _currentRecords;
+  std::chrono::steady_clock::time_point _currentStart;
+  std::deque<ForwardBatch> _queue;
+  unsigned long long _sequence;
+  bool _stopping;
+  ForwardMetrics _metrics;
+
+  // Owned by the thread
+  int _socket;
+  std::string _acks; // Partial answer
+  std::deque<ForwardBatch> _inFlight;
+  std::chrono::steady_clock::time_point _nextConnect;
+  std::chrono::milliseconds _backoff;
+  int _spool;
+  unsigned long long _spoolSize;
+  unsigned long long _spoolSent;
+  unsigned long long _spoolAcked;
+
+  static const unsigned _BATCH_RECORDS = 64;
+  static const unsigned _WINDOW = 8;
+  static const size_t _MAX_QUEUE = 256;
+  static const std::chrono::milliseconds _FLUSH_INTERVAL;
+  static const std::chrono::milliseconds _MAX_BACKOFF;
+  static const std::chrono::seconds _STOP_TIMEOUT;
+  static const char _MAGIC[4];
+};
+
+#endif // __FORWARDER_HH__
@@ -0,0 +1,417 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+#include "generator.hh"
+
+struct Brand {
+  byte_t aid[7];
+  char const* label;
+  char const* prefixes[4];
+  int panLength;
+};
+
+static const Brand brands[] = {
+  {{0xA0,0x00,0x00,0x00,0x03,0x10,0x10}, "VISA", {"4970", "4539", "4", "4485"}, 16},
+  {{0xA0,0x00,0x00,0x00,0x03,0x20,0x10}, "VISA ELECTRON", {"4175", "4508", "4844", "4917"}, 16},
+  {{0xA0,0x00,0x00,0x00,0x04,0x10,0x10}, "MASTERCARD", {"51", "53", "55", "2221"}, 16},
+  {{0xA0,0x00,0x00,0x00,0x04,0x30,0x60}, "MAESTRO", {"6759", "5018", "6304", "5020"}, 19}
+};
+
+// French cards are often co-badged with the domestic scheme
+static const Brand cb = {{0xA0,0x00,0x00,0x00,0x42,0x10,0x10}, "CB", {NULL, NULL, NULL, NULL}, 16};
+
+static char const* pdols[] = {
+  "", // No PDOL
+  "9F66049F02069F37045F2A02",
+  "9F66049F02069F03069F1A0295055F2A029A039C019F3704",
+  "9F59039F5A019F58019F66049F02069F03069F1A025F2A029A039C019F3704"
+};
+
+static char const* logFormats[] = {
+  "9A039F21039F02065F2A029F1A029C019F36029F4E14",
+  "9F27019F02065F2A029A039F36029F1A029C01",
+  "9A039F21039F02065F2A029F4E149C019F3602",
+  "9F02065F2A029A039F21039C019F1A02"
+};
+
+static char const* languages[] = {"fr", "en", "enfr", "frde", "de", "esen", "it"};
+
+static char const* surnames[] = {"DOE", "MARTIN", "SMITH", "BERNARD", "DUBOIS", "JONES", "O CONNOR",
+				 "VAN DER BERG", "NGUYEN", "LI", "GARCIA LOPEZ", "WILLIAMSON-HARGREAVES"};
+static char const* firstnames[] = {"JOHN", "MARIE", "A", "JEAN-PIERRE", "SARAH", "LEE", "ALEXANDRA", "TOM"};
+
+static char const* merchants[] = {"TESCO", "SAINSBURYS", "CARREFOUR", "SNCF", "AMAZON", "LIDL", "MONOPRIX",
+				  "STARBUCKS", "SHELL", "BOOTS", "PRET A MANGER", "FNAC", "MCDONALDS", "RATP",
+				  "TFL TRAVEL", "IKEA", "AUCHAN", "DECATHLON", "ZARA", "H&M"};
+static char const* places[] = {"", " STORES", " CANTERBURY", " PARIS 12", " LONDON", " LYON", " 0042",
+			       " GARE DU NORD", " KENT", " ONLINE"};
+
+// Currency, its most likely terminal country and a second one
+static const unsigned short currencies[][3] = {
+  {0x978, 0x250, 0x276}, // EUR: FRA, DEU
+  {0x978, 0x724, 0x380}, // EUR: ESP, ITA
+  {0x826, 0x826, 0x826}, // GBP
+  {0x840, 0x840, 0x840}, // USD
+  {0x756, 0x756, 0x756}, // CHF
+  {0x124, 0x124, 0x124}, // CAD
+  {0x392, 0x392, 0x392}, // JPY
+  {0x752, 0x752, 0x752}  // SEK
+};
+static const double currencyWeights[] = {35, 15, 20, 10, 5, 5, 5, 5};
+
+#define COUNT(array) (sizeof(array) / sizeof(*(array)))
+
+template <typename T>
+static T const& pick(std::mt19937& rng, T const* array, size_t size) {
+  return array[std::uniform_int_distribution<size_t>(0, size - 1)(rng)];
+}
+
+static bool chance(std::mt19937& rng, double p) {
+  return std::uniform_real_distribution<double>(0, 1)(rng) < p;
+}
+
+byte_t Generator::bcd(int n) {
+  return (n / 10) << 4 | n % 10;
+}
+
+Bytes Generator::tlv(unsigned short tag, Bytes const& value) {
+  Bytes ret;
+  if (tag > 0xFF)
+    ret.push_back(tag >> 8);
+  ret.push_back(tag);
+  if (value.size() > 0x7F)
+    ret.push_back(0x81);
+  ret.push_back(value.size());
+  ret.insert(ret.end(), value.begin(), value.end());
+  return ret;
+}
+
+Bytes Generator::tlv(unsigned short tag, std::string const& value) {
+  return tlv(tag, Bytes(value.begin(), value.end()));
+}
+
+Bytes Generator::hex(char const* str) {
+  byte_t buff[MAX_FRAME_LEN];
+  return Bytes(buff, buff + Tools::fromHex(str, buff, sizeof(buff)));
+}
+
+Bytes Generator::ok(Bytes response) {
+  response.push_back(0x90);
+  response.push_back(0x00);
+  return response;
+}
+
+static Bytes operator+(Bytes a, Bytes const& b) {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+// Luhn-valid PAN. The length is the brand's usual one most of the time, anything from 13 to 19 otherwise
+std::string Generator::pan(std::mt19937& rng, char const* prefix, int length) {
+  static const int lengths[] = {13, 14, 15, 16, 17, 18, 19};
+  if (chance(rng, 0.15))
+    length = pick(rng, lengths, COUNT(lengths));
+
+  std::string pan(prefix);
+  while ((int)pan.size() < length - 1)
+    pan += '0' + std::uniform_int_distribution<int>(0, 9)(rng);
+
+  int sum = 0;
+  for (size_t i = 0; i < pan.size(); ++i) {
+    int d = pan[pan.size() - 1 - i] - '0';
+    if (i % 2 == 0)
+      d = d * 2 > 9 ? d * 2 - 9 : d * 2;
+    sum += d;
+  }
+  pan += '0' + (10 - sum % 10) % 10;
+  return pan;
+}
+
+// PAN | D | YYMM | service code | discretionary data | F padding, at most 19 bytes
+Bytes Generator::track2(std::mt19937& rng, std::string const& pan) {
+  std::string digits = pan + "D";
+  digits += '0' + std::uniform_int_distribution<int>(1, 2)(rng); // 2010s or 2020s
+  digits += '0' + std::uniform_int_distribution<int>(0, 9)(rng);
+  int month = std::uniform_int_distribution<int>(1, 12)(rng);
+  digits += '0' + month / 10;
+  digits += '0' + month % 10;
+  digits += chance(rng, 0.8) ? "201" : "221";
+  int discretionary = std::uniform_int_distribution<int>(3, 38 - digits.size())(rng);
+  for (int i = 0; i < discretionary; ++i)
+    digits += '0' + std::uniform_int_distribution<int>(0, 9)(rng);
+  if (digits.size() & 1)
+    digits += 'F';
+
+  byte_t buff[32];
+  return Bytes(buff, buff + Tools::fromHex(digits.c_str(), buff, sizeof(buff)));
+}
+
+// SURNAME/FIRSTNAME, space padded to 26 characters on some cards, "/" on anonymous ones
+std::string Generator::holder(std::mt19937& rng) {
+  if (chance(rng, 0.15))
+    return "/";
+
+  std::string name = std::string(pick(rng, surnames, COUNT(surnames))) + "/" + pick(rng, firstnames, COUNT(firstnames));
+  if (chance(rng, 0.5))
+    name.resize(26, ' ');
+  return name.substr(0, 26);
+}
+
+Bytes Generator::logEntry(std::mt19937& rng, Bytes const& format, time_t when, int atc) {
+  Bytes entry;
+
+  struct tm date;
+  gmtime_r(&when, &date);
+
+  static std::discrete_distribution<size_t> currencyDistribution(currencyWeights, currencyWeights + COUNT(currencyWeights));
+  size_t c = currencyDistribution(rng);
+  unsigned short currency = currencies[c][0];
+  unsigned short country = currencies[c][chance(rng, 0.8) ? 1 : 2];
+
+  // Amounts in minor units, log-normal around 25.00
+  long amount = std::lognormal_distribution<double>(std::log(2500.0), 1.2)(rng);
+  if (amount < 10)
+    amount = 10;
+  if (amount > 99999999)
+    amount = 99999999;
+
+  for (size_t i = 0; i < format.size(); ) {
+    unsigned short tag = format[i++];
+    if ((tag & 0x1F) == 0x1F)
+      tag = tag << 8 | format[i++];
+    size_t len = format[i++];
+
+    Bytes value(len, 0);
+    switch (tag) {
+    case 0x9A:
+      value = {bcd(date.tm_year % 100), bcd(date.tm_mon + 1), bcd(date.tm_mday)};
+      break;
+    case 0x9F21:
+      value = {bcd(std::uniform_int_distribution<int>(6, 22)(rng)),
+	       bcd(std::uniform_int_distribution<int>(0, 59)(rng)),
+	       bcd(std::uniform_int_distribution<int>(0, 59)(rng))};
+      break;
+    case 0x9F02:
+      for (long a = amount, j = len; j > 0 && a > 0; a /= 100)
+	value[--j] = bcd(a % 100);
+      break;
+    case 0x5F2A:
+      value = {(byte_t)(currency >> 8), (byte_t)currency};
+      break;
+    case 0x9F1A:
+      value = {(byte_t)(country >> 8), (byte_t)country};
+      break;
+    case 0x9C:
+      value[0] = chance(rng, 0.1) ? 0x01 : 0x00;
+      break;
+    case 0x9F36:
+      value = {(byte_t)(atc >> 8), (byte_t)atc};
+      break;
+    case 0x9F27:
+      value[0] = chance(rng, 0.9) ? 0x40 : 0x80;
+      break;
+    case 0x9F4E: {
+      // Skewed towards the first merchants, like real traffic
+      double u = std::uniform_real_distribution<double>(0, 1)(rng);
+      size_t k = COUNT(merchants) * COUNT(places) * u * u * u;
+      std::string name = std::string(merchants[k % COUNT(merchants)]) + places[k / COUNT(merchants)];
+      name.resize(len, ' ');
+      value.assign(name.begin(), name.end());
+      break;
+    }
+    }
+    value.resize(len);
+    entry.insert(entry.end(), value.begin(), value.end());
+  }
+  return entry;
+}
+
+CardImage Generator::card(std::mt19937& rng, double malformedRate) {
+  CardImage card;
+
+  // Applications: main brand, sometimes co-badged with CB, rarely a third one
+  std::vector<Brand const*> apps;
+  Brand const& brand = pick(rng, brands, COUNT(brands));
+  apps.push_back(&brand);
+  if (chance(rng, 0.35))
+    apps.push_back(&cb);
+  if (chance(rng, 0.05))
+    apps.push_back(&pick(rng, brands, COUNT(brands)));
+
+  std::vector<byte_t> priorities;
+  for (size_t i = 0; i < apps.size(); ++i)
+    priorities.push_back(i + 1);
+  std::shuffle(priorities.begin(), priorities.end(), rng);
+
+  byte_t logSFI = _LOG_SFI;
+  int logCount = std::uniform_int_distribution<int>(0, _MAX_LOG_ENTRIES)(rng);
+  bool hasLog = chance(rng, 0.9);
+  Bytes pdol = hex(pick(rng, pdols, COUNT(pdols)));
+  std::string language = pick(rng, languages, COUNT(languages));
+
+  Bytes directory;
+  for (size_t i = 0; i < apps.size(); ++i) {
+    Bytes aid(apps[i]->aid, apps[i]->aid + sizeof(apps[i]->aid));
+    directory = directory + tlv(0x61, tlv(0x4F, aid) + tlv(0x50, std::string(apps[i]->label)) + tlv(0x87, Bytes(1, priorities[i])));
+
+    Bytes proprietary = tlv(0x50, std::string(apps[i]->label)) + tlv(0x87, Bytes(1, priorities[i]));
+    if (pdol.size())
+      proprietary = proprietary + tlv(0x9F38, pdol);
+    proprietary = proprietary + tlv(0x5F2D, language);
+    if (hasLog)
+      proprietary = proprietary + tlv(0xBF0C, tlv(0x9F4D, Bytes({logSFI, (byte_t)logCount})));
+
+    byte_t select[16];
+    memcpy(select, Command::SELECT_APP_HEADER, sizeof(Command::SELECT_APP_HEADER));
+    select[6] = sizeof(apps[i]->aid);
+    memcpy(select + 7, apps[i]->aid, sizeof(apps[i]->aid));
+    select[14] = 0x00;
+    card.add(select, 15, ok(tlv(0x6F, tlv(0x84, aid) + tlv(0xA5, proprietary))));
+  }
+  Bytes ppse = ok(tlv(0x6F, tlv(0x84, std::string("2PAY.SYS.DDF01")) + tlv(0xA5, tlv(0xBF0C, directory))));
+  card.add(Command::SELECT_PPSE, sizeof(Command::SELECT_PPSE), ppse);
+
+  // Records: track 2 and name are usually in SFI 1 record 1, sometimes elsewhere
+  std::string number = pan(rng, pick(rng, brand.prefixes, COUNT(brand.prefixes)), brand.panLength);
+  Bytes track = tlv(0x57, track2(rng, number));
+  Bytes name = chance(rng, 0.9) ? tlv(0x5F20, holder(rng)) : Bytes();
+  Bytes discretionary = chance(rng, 0.6) ? tlv(0x9F1F, std::string("0123456789012345").substr(0, std::uniform_int_distribution<int>(4, 16)(rng))) : Bytes();
+  Bytes dates = tlv(0x5F25, Bytes({bcd(12), bcd(1), bcd(1)})) + tlv(0x5F24, Bytes({bcd(25), bcd(12), bcd(31)})) + tlv(0x5F28, Bytes({0x02, 0x50}));
+
+  switch (std::uniform_int_distribution<int>(0, 9)(rng)) {
+  case 0:
+    card.addRecord(1, 1, ok(tlv(0x70, dates)));
+    card.addRecord(1, 2, ok(tlv(0x70, track + name + discretionary)));
+    break;
+  case 1:
+    card.addRecord(1, 1, ok(tlv(0x70, dates)));
+    card.addRecord(2, 1, ok(tlv(0x70, track + name)));
+    card.addRecord(2, 2, ok(tlv(0x70, discretionary + tlv(0x9F07, Bytes({0xFF, 0x00})))));
+    break;
+  default:
+    card.addRecord(1, 1, ok(tlv(0x70, track + name + discretionary)));
+    if (chance(rng, 0.7))
+      card.addRecord(1, 2, ok(tlv(0x70, dates)));
+  }
+
+  // Paylog
+  if (hasLog) {
+    Bytes format = hex(pick(rng, logFormats, COUNT(logFormats)));
+    card.add(Command::GET_DATA_LOG_FORMAT, sizeof(Command::GET_DATA_LOG_FORMAT), ok(tlv(0x9F4F, format)));
+    // Entries are most recent first: date and ATC go back in time together
+    int atc = std::uniform_int_distribution<int>(logCount * 5 + 1, 0xFFFF)(rng);
+    time_t when = 1420070400; // 2015-01-01
+    for (int i = 0; i < logCount; ++i) {
+      when -= std::uniform_int_distribution<int>(1, 4)(rng) * 86400;
+      card.addRecord(logSFI, i + 1, ok(logEntry(rng, format, when, atc)));
+      atc -= std::uniform_int_distribution<int>(1, 5)(rng);
+    }
+  }
+  else
+    card.add(Command::GET_DATA_LOG_FORMAT, sizeof(Command::GET_DATA_LOG_FORMAT), hex("6A88"));
+
+  if (chance(rng, malformedRate))
+    malform(rng, card, ppse, logSFI, logCount);
+
+  return card;
+}
+
+// One defect per malformed card
+void Generator::malform(std::mt19937& rng, CardImage& card, Bytes const& ppse, byte_t logSFI, int logCount) {
+  byte_t readRecord[sizeof(Command::READ_RECORD)];
+  memcpy(readRecord, Command::READ_RECORD, sizeof(readRecord));
+  readRecord[4] = 1;
+  readRecord[5] = (1 << 3) | (1 << 2);
+
+  Bytes response;
+  switch (std::uniform_int_distribution<int>(0, 4)(rng)) {
+  case 0: // Truncated record
+    card.answer(readRecord, sizeof(readRecord), response);
+    if (response.size() > 4) {
+      response.resize(std::uniform_int_distribution<size_t>(1, response.size() - 3)(rng));
+      card.add(readRecord, sizeof(readRecord), ok(response));
+    }
+    break;
+  case 1: // Random length byte
+    card.answer(readRecord, sizeof(readRecord), response);
+    if (response.size() > 4) {
+      response[std::uniform_int_distribution<size_t>(1, response.size() - 3)(rng)] = std::uniform_int_distribution<int>(0, 255)(rng);
+      card.add(readRecord, sizeof(readRecord), response);
+    }
+    break;
+  case 2: // Fewer log entries than announced
+    if (logCount > 0) {
+      readRecord[4] = logCount;
+      readRecord[5] = (logSFI << 3) | (1 << 2);
+      card.add(readRecord, sizeof(readRecord), hex("6A83"));
+    }
+    break;
+  case 3: // Unexpected status word on the log format
+    card.add(Command::GET_DATA_LOG_FORMAT, sizeof(Command::GET_DATA_LOG_FORMAT), hex(chance(rng, 0.5) ? "6985" : "6F00"));
+    break;
+  default: { // AID length other than 7 in the directory
+    Bytes bad = ppse;
+    for (size_t i = 0; i + 1 < bad.size(); ++i)
+      if (bad[i] == 0x4F && bad[i + 1] == 0x07) {
+	bad[i + 1] = chance(rng, 0.5) ? 0x05 : 0x08;
+	break;
+      }
+    card.add(Command::SELECT_PPSE, sizeof(Command::SELECT_PPSE), bad);
+  }
+  }
+}
+
+int Generator::generate(char const* path, size_t count, unsigned seed, double malformedRate) {
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+
+  static char buffer[1 << 20];
+  setvbuf(file, buffer, _IOFBF, sizeof(buffer));
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::mt19937 rng(seed);
+
+  ApduFile::writeHeader(file);
+  for (size_t n = 0; n < count; ++n)
+    card(rng, malformedRate).save(file);
+
+  long size = ftell(file);
+  if (fclose(file) != 0) {
+    perror(path);
+    return 1;
+  }
+
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << count << " card(s), " << size << " bytes written to " << path
+	    << " in " << elapsed << "s" << std::endl;
+  return 0;
+}
@@ -0,0 +1,59 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __GENERATOR_HH__
+# define __GENERATOR_HH__
+
+#include <ctime>
+#include <random>
+#include <string>
+
+#include "cardimage.hh"
+
+/* Synthetic card corpus: several AIDs with priorities, 13 to 19-digit PANs,
+   names of any length, several PDOLs and log formats, 0 to 30 log entries.
+   A share of the cards is malformed on purpose (truncated answers, bad lengths or status words).
+*/
+class Generator {
+
+public:
+  static int generate(char const* path, size_t count, unsigned seed, double malformedRate);
+  static CardImage card(std::mt19937& rng, double malformedRate);
+
+private:
+  static Bytes tlv(unsigned short tag, Bytes const& value);
+  static Bytes tlv(unsigned short tag, std::string const& value);
+  static Bytes hex(char const* str);
+  static Bytes ok(Bytes response);
+  static Bytes track2(std::mt19937& rng, std::string const& pan);
+  static std::string pan(std::mt19937& rng, char const* prefix, int length);
+  static std::string holder(std::mt19937& rng);
+  static Bytes logEntry(std::mt19937& rng, Bytes const& format, time_t when, int atc);
+  static void malform(std::mt19937& rng, CardImage& card, Bytes const& ppse, byte_t logSFI, int logCount);
+  static byte_t bcd(int n);
+
+private:
+  static const int _MAX_LOG_ENTRIES = 30;
+  static const byte_t _LOG_SFI = 0x0B;
+};
+
+#endif // __GENERATOR_HH__
@@ -0,0 +1,131 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+
+#include "livestats.hh"
+
+const char LiveStats::_MAGIC[8] = {'R', 'C', 'C', 'S', 'K', 'E', 'T', '1'};
+
+LiveStats::LiveStats()
+  : _reads(0)
+{
+}
+
+void LiveStats::add(std::vector<CCInfo> const& infos) {
+  _reads++;
+
+  // Applications of a card share the PAN and the paylog, the first one found is used
+  bool card = false;
+  bool paylog = false;
+  for (CCInfo const& info : infos) {
+    Track2 const& t = info.track2();
+    size_t digits = strlen(t.pan);
+    if (!card && digits > 0) {
+      _cards.add(Tools::hash(t.pan, digits));
+      _bins.add(std::string(t.pan, std::min<size_t>(digits, 6)));
+      card = true;
+    }
+
+    size_t count = info.logEntryCount();
+    if (!paylog && count > 0) {
+      for (size_t i = 0; i < count; ++i) {
+	if (info.logEntryDropped(i))
+	  continue;
+	PaylogEntry const& e = info.logEntry(i);
+	if (e.merchantLength > 0)
+	  _merchants.add(std::string(e.merchant, e.merchantLength));
+	_amounts.add(e.amountValue);
+      }
+      paylog = true;
+    }
+  }
+}
+
+void LiveStats::merge(LiveStats const& other) {
+  _reads += other._reads;
+  _cards.merge(other._cards);
+  _merchants.merge(other._merchants);
+  _bins.merge(other._bins);
+  _amounts.merge(other._amounts);
+}
+
+void LiveStats::print(std::ostream& out) const {
+  out << "-- Live statistics --" << std::endl;
+  out << _reads << " read(s), about " << (unsigned long long)(_cards.estimate() + 0.5) << " distinct card(s)" << std::endl;
+
+  out << "Amount (minor units, all currencies) over " << (unsigned long long)_amounts.count() << " entries:";
+  if (_amounts.count() > 0) {
+    double const quantiles[] = {0, 0.5, 0.9, 0.99, 0.999, 1};
+    char const* names[] = {"min", "p50", "p90", "p99", "p99.9", "max"};
+    for (size_t i = 0; i < 6; ++i)
+      out << (i ? ", " : " ") << names[i] << " " << (unsigned long long)(_amounts.quantile(quantiles[i]) + 0.5);
+  }
+  out << std::endl;
+
+  out << "Issuer BINs (of " << _bins.total() << "):" << std::endl;
+  for (std::pair<std::string, unsigned long long> const& b : _bins.top())
+    out << "  " << b.first << ": ~" << b.second << std::endl;
+
+  out << "Merchants (of " << _merchants.total() << "):" << std::endl;
+  for (std::pair<std::string, unsigned long long> const& m : _merchants.top())
+    out << "  " << m.first << ": ~" << m.second << std::endl;
+}
+
+int LiveStats::save(char const* path) const {
+  std::string temporary = std::string(path) + ".tmp";
+  FILE* file = fopen(temporary.c_str(), "wb");
+  if (file == NULL) {
+    perror(temporary.c_str());
+    return 1;
+  }
+
+  bool written = fwrite(_MAGIC, sizeof(_MAGIC), 1, file) == 1 && fwrite(&_reads, sizeof(_reads), 1, file) == 1 &&
+    !_cards.save(file) && !_merchants.save(file) && !_bins.save(file) && !_amounts.save(file);
+
+  if (fclose(file) != 0 || !written || rename(temporary.c_str(), path) != 0) {
+    perror(path);
+    unlink(temporary.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int LiveStats::load(char const* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+
+  char magic[sizeof(_MAGIC)];
+  int ret = fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, _MAGIC, sizeof(magic)) ||
+    fread(&_reads, sizeof(_reads), 1, file) != 1 ||
+    _cards.load(file) || _merchants.load(file) || _bins.load(file) || _amounts.load(file);
+  fclose(file);
+
+  if (ret)
+    std::cerr << path << ": not a statistics snapshot" << std::endl;
+  return ret;
+}
@@ -0,0 +1,61 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __LIVESTATS_HH__
+# define __LIVESTATS_HH__
+
+#include <vector>
+#include <iostream>
+
+#include "ccinfo.hh"
+#include "sketches.hh"
+
+/* Card population statistics updated on every read, in constant memory:
+   distinct cards (HyperLogLog of the PAN hash), most frequent merchants and issuer BINs
+   (Count-Min with top-k) and paylog amounts (t-digest).
+   Snapshots of several readers or hosts can be merged.
+*/
+class LiveStats {
+
+public:
+  LiveStats();
+
+public:
+  void add(std::vector<CCInfo> const& infos);
+  void merge(LiveStats const& other);
+  void print(std::ostream& out = std::cout) const;
+
+  // Written to a temporary file then renamed, so a snapshot is always complete
+  int save(char const* path) const;
+  int load(char const* path);
+
+private:
+  unsigned long long _reads;
+  HyperLogLog _cards;
+  CountMin _merchants;
+  CountMin _bins;
+  TDigest _amounts; // Minor units, all currencies
+
+  static const char _MAGIC[8];
+};
+
+#endif // __LIVESTATS_HH__
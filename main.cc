@@ -32,100 +32,386 @@ extern "C" {
 }
 
 #include <iostream>
+#include <cstring>
+#include <ctime>
+#include <csignal>
+
+#include <unistd.h>
 
 #include "tools.hh"
 #include "applicationhelper.hh"
 #include "ccinfo.hh"
+#include "cardreader.hh"
+#include "options.hh"
+#include "realtime.hh"
+#include "trace.hh"
+#include "simulator.hh"
+#include "generator.hh"
+#include "apdufile.hh"
+#include "tracedecoder.hh"
+#include "textimport.hh"
+#include "analytics.hh"
+#include "livestats.hh"
+#include "timeindex.hh"
+#include "merchantindex.hh"
+#include "query.hh"
+#include "dedupe.hh"
+#include "forwarder.hh"
+#include "collector.hh"
+#include "resultring.hh"
+#include "capturecipher.hh"
+#include "outputtemplate.hh"
+#include "paylogarchive.hh"
+#include "stageprofile.hh"
+#include "diffharness.hh"
+#include "readerhealth.hh"
+#include "bintable.hh"
 
-struct nfc_device* pnd;
-
-static void	init() {
+thread_local struct nfc_device* pnd;
 
-  nfc_context *context;
+static Options options;
+static LiveStats liveStats;
+static TimeIndex timeIndex;
+static PaylogDedupe dedupe;
+static Forwarder forwarder;
+static ResultRing ring;
+static OutputTemplate outputTemplate;
+static BinTable binTable;
+static volatile sig_atomic_t stopping = 0;
 
-  nfc_init(&context);
-  if (context == NULL) {
-    std::cerr << "Unable to init libnfc (malloc)" << std::endl;
-    exit(EXIT_FAILURE);
-  }
-
-  pnd = nfc_open(context, NULL);
+static void onStop(int) {
+  stopping = 1;
+}
 
-  if (pnd == NULL) {
-    std::cerr << "Unable to open NFC device." << std::endl;
-    nfc_exit(context);
-    exit(EXIT_FAILURE);
+// Flushes the last card, sealed if the capture is encrypted, and catches up the time index
+static int closeRecord(FILE* record) {
+  int ret = 0;
+  fflush(record);
+  if (options.timeIndex && (timeIndex.update() || timeIndex.flush()))
+    ret = 1;
+  if (fclose(record) != 0) {
+    perror(options.record);
+    ret = 1;
   }
+  return ret;
 }
 
-static void startTransmission() {
+// Longest poll when exchanges wait forever, so that a stop signal is seen between two polls
+static const int POLL_SLICE = 250; // ms
+
+// False when the poll timed out without a card
+static bool startTransmission() {
+  if (options.timeout == 0)
+    ApplicationHelper::setPolicy(POLL_SLICE, options.retries);
   ApplicationHelper::executeCommand(Command::START_14443A,
 					       sizeof(Command::START_14443A),
 					       "START 14443A");
+  if (options.timeout == 0)
+    ApplicationHelper::setPolicy(options.timeout, options.retries);
+  return ApplicationHelper::targetFound();
 }
 
 static int selectAndReadApplications() {
-  // Retrieve all available applications
-  AppList list = ApplicationHelper::getAll();
+  std::vector<CCInfo> infos;
+  int ret = CardReader::read(infos, options.dump);
+
+  if (options.dedupe)
+    dedupe.filter(infos, time(NULL));
+  if (options.forward)
+    forwarder.add(infos);
+  if (options.ring)
+    ring.publish(infos);
+  CardReader::print(infos);
 
-  if (list.size() == 0) {
-    std::cerr << "No application found using PPSE" << std::endl;
-    return 1;
+  if (options.stats) {
+    static unsigned reads = 0;
+    liveStats.add(infos);
+    if (++reads % options.statsEvery == 0)
+      liveStats.save(options.stats);
   }
+  return ret;
+}
 
-#ifdef DEBUG
-  ApplicationHelper::printList(list);
-#endif
-  
-  /* Create CCinfo object then extract all information.
-   */
-  CCInfo infos[list.size()];
-  size_t i = 0;
-  for (Application app : list) {
-    APDU res = ApplicationHelper::selectByPriority(list, app.priority);
-    if (res.size == 0) {
-      std::cerr << "Unable to select application " << app.name << std::endl;
-      continue;
+int	main(int argc, char **argv) {
+
+  if (options.parse(argc, argv))
+    return EXIT_FAILURE;
+
+  Trace::start(options.trace);
+
+  if (options.jitterProbe) {
+    Realtime::probe(options.cpu, options.priority);
+    return 0;
+  }
+
+  if (options.kernelBench)
+    return Tools::benchKernels(options.kernelBench);
+
+  if (options.outputTemplate) {
+    if (outputTemplate.compile(options.outputTemplate))
+      return EXIT_FAILURE;
+    CardReader::setTemplate(&outputTemplate);
+  }
+
+  if (options.binRanges) {
+    if (!options.binTable) {
+      std::cerr << "--bin-ranges needs --bin-table" << std::endl;
+      return EXIT_FAILURE;
     }
-    infos[i].extractAppResponse(app, res);
+    return BinTable::build(options.binRanges, options.binTable);
+  }
+  if (options.binTable) {
+    if (binTable.open(options.binTable))
+      return EXIT_FAILURE;
+    CCInfo::setBinTable(&binTable);
+  }
 
-    /* Prepare PDOL, print optional interesting fields (e.g. the prefered language) and send the GPO
-       THIS COMMAND ADDS AN ENTRY IN THE PAYLOG, BEWARE OF THIS
-    */
-    // if (infos[i].getProcessingOptions())
-    //   ;
+  ApplicationHelper::setPolicy(options.timeout, options.retries);
+  dedupe = PaylogDedupe(options.dedupeWindow * 24 * 3600);
 
-    infos[i].extractBaseRecords();
-    infos[i].extractLogEntries();
+  if (options.collect)
+    return Collector::run(options.collect);
 
-    std::cerr << "App" << (char) ('0' + app.priority) << " finished" << std::endl;
+  if (options.generateKey)
+    return CaptureCipher::generateKey(options.generateKey);
 
-    i++;
+  if (options.decrypt || options.encryptBench) {
+    byte_t key[CaptureCipher::KEY_SIZE] = {0}; // Any key will do for the benchmark
+    if (options.decrypt && !options.encryptKey) {
+      std::cerr << "--decrypt needs --encrypt-key" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (options.encryptKey && CaptureCipher::loadKey(options.encryptKey, key))
+      return EXIT_FAILURE;
+    if (options.decrypt)
+      return CaptureCipher::decrypt(options.decrypt, key, stdout);
+    if (!options.corpus) {
+      std::cerr << "--encrypt-bench needs --corpus" << std::endl;
+      return EXIT_FAILURE;
+    }
+    return CaptureCipher::bench(key, options.encryptBench, options.corpus);
   }
 
-  for (size_t i = 0; i < list.size(); ++i) {
-    infos[i].printAll();
+  if (options.followRing)
+    return ResultRingReader::follow(options.followRing);
+
+  if (options.generateCorpus)
+    return Generator::generate(options.generateCorpus, options.cards, options.faults.seed, options.malformed);
+
+  if (options.decodeTraces) {
+    if (options.files.empty()) {
+      std::cerr << "--decode-traces needs at least one APDU file" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (options.scaling)
+      return TraceDecoder::scaling(options.files, options.threads, options.dump);
+    if (options.perfStages)
+      return TraceDecoder::profile(options.files, options.dump);
+    return TraceDecoder::decode(options.files, options.threads, options.dump);
   }
-  
-  return 0;
-}
 
-int	main(__attribute__((unused)) int argc,
-	     __attribute__((unused)) char **argv) {
+  if (options.diffDecoders) {
+    if (options.files.empty()) {
+      std::cerr << "--diff-decoders needs at least one APDU file" << std::endl;
+      return EXIT_FAILURE;
+    }
+    return DiffHarness::run(options.files, options.diffDecoders, options.top);
+  }
 
-  init();
+  if (options.importText) {
+    if (options.files.empty()) {
+      std::cerr << "--import-text needs at least one text dump" << std::endl;
+      return EXIT_FAILURE;
+    }
+    return TextImport::import(options.files, options.threads);
+  }
 
-  while (1) {
+  if (options.analytics) {
+    if (options.files.empty()) {
+      std::cerr << "--analytics needs at least one APDU file" << std::endl;
+      return EXIT_FAILURE;
+    }
+    return Analytics::run(options.files, options.threads, options.top);
+  }
 
-    startTransmission();
+  if (options.mergeStats) {
+    LiveStats merged;
+    for (char const* path : options.files) {
+      LiveStats s;
+      if (s.load(path))
+	return EXIT_FAILURE;
+      merged.merge(s);
+    }
+    merged.print();
+    return options.stats ? merged.save(options.stats) : 0;
+  }
+
+  if (options.stats) {
+    if (access(options.stats, F_OK) == 0 && liveStats.load(options.stats))
+      return EXIT_FAILURE;
+    if (options.statsEvery == 0)
+      options.statsEvery = 1;
+  }
+
+  if (options.timeIndex && options.rangeFrom) {
+    long long from, to;
+    if (!TimeIndex::parseTime(options.rangeFrom, from) || !TimeIndex::parseTime(options.rangeTo, to, true)) {
+      std::cerr << "Invalid time range" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (timeIndex.open(options.timeIndex) || timeIndex.print(from, to))
+      return EXIT_FAILURE;
+    return 0;
+  }
+
+  if (options.merchantIndex && (options.prefix || options.fuzzy)) {
+    MerchantIndex merchants;
+    std::vector<unsigned> names;
+    if (merchants.open(options.merchantIndex))
+      return EXIT_FAILURE;
+    if (options.prefix)
+      merchants.prefix(options.prefix, names);
+    else
+      merchants.fuzzy(options.fuzzy, names);
+    merchants.print(names, options.top);
+    return 0;
+  }
+
+  if (options.query) {
+    Query query;
+    if (query.parse(options.query) || query.run(options.files, options.blockIndex, options.threads))
+      return EXIT_FAILURE;
+    return 0;
+  }
+
+  if (options.index) {
+    if (!options.timeIndex && !options.merchantIndex && !options.blockIndex && !options.archive) {
+      std::cerr << "--index needs --time-index, --merchant-index, --block-index or --archive" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (options.timeIndex && (timeIndex.open(options.timeIndex, options.index) || timeIndex.update() || timeIndex.flush()))
+      return EXIT_FAILURE;
+    if (options.merchantIndex && MerchantIndex::build(options.index, options.merchantIndex))
+      return EXIT_FAILURE;
+    if (options.blockIndex && Query::buildBlocks(options.index, options.blockIndex, options.threads))
+      return EXIT_FAILURE;
+    if (options.archive && PaylogArchive::build(options.index, options.archive, options.threads))
+      return EXIT_FAILURE;
+    return 0;
+  }
+
+  if (options.archive)
+    return PaylogArchive::print(options.archive) ? EXIT_FAILURE : 0;
+
+  if (options.timeIndex && options.encryptKey) {
+    std::cerr << "--time-index cannot read an encrypted capture" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (options.timeIndex && !options.record) {
+    std::cerr << "--time-index needs --record, --index or --time-range" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  FILE* record = NULL;
+  if (options.record) {
+    bool empty;
+    if (options.encryptKey) {
+      byte_t key[CaptureCipher::KEY_SIZE];
+      if (CaptureCipher::loadKey(options.encryptKey, key))
+	return EXIT_FAILURE;
+      record = CaptureCipher::open(options.record, key, &empty);
+      memset(key, 0, sizeof(key));
+      if (record == NULL)
+	return EXIT_FAILURE;
+    }
+    else {
+      record = fopen(options.record, "ab");
+      if (record == NULL) {
+	perror(options.record);
+	return EXIT_FAILURE;
+      }
+      empty = ftell(record) == 0;
+    }
+    if (empty)
+      ApduFile::writeHeader(record);
+    ApplicationHelper::setRecorder(record);
+    fflush(record);
+
+    // Catches up with what was recorded without the index
+    if (options.timeIndex && (timeIndex.open(options.timeIndex, options.record) || timeIndex.update()))
+      return EXIT_FAILURE;
+  }
+
+  if (options.forward && forwarder.start(options.forward, options.spool, options.forwardMetrics))
+    return EXIT_FAILURE;
+  if (options.ring && ring.open(options.ring, options.ringSize * 1024))
+    return EXIT_FAILURE;
+
+  if (options.simulate > 0) {
+    if (options.corpus && Simulator::loadCorpus(options.corpus))
+      return EXIT_FAILURE;
+    Simulator::configure(options.faults);
+    if (options.perfStages)
+      StageProfile::start();
+    int ret = Simulator::bench(options.simulate, selectAndReadApplications);
+    if (options.perfStages)
+      StageProfile::print();
+    if (options.dedupe)
+      dedupe.print();
+    if (options.forward) {
+      forwarder.stop();
+      forwarder.print();
+    }
+    if (options.stats && liveStats.save(options.stats))
+      ret = 1;
+    if (record && closeRecord(record))
+      ret = 1;
+    return ret;
+  }
+
+  ReaderHealth::configure(options.readerErrors, options.reconnectMax, options.readerMetrics);
+  ReaderHealth::connect();
+
+  // After opening the device so the libnfc allocations are locked as well
+  if (options.realtime)
+    Realtime::enable(options.cpu, options.priority);
+
+  // Ends the loop after the current card or poll, a second signal kills
+  struct sigaction stop = {};
+  stop.sa_handler = onStop;
+  stop.sa_flags = SA_RESETHAND;
+  sigaction(SIGINT, &stop, NULL);
+  sigaction(SIGTERM, &stop, NULL);
+
+  while (!stopping) {
+
+    if (!startTransmission()) {
+      if (ReaderHealth::failing())
+	ReaderHealth::recover();
+      continue;
+    }
 
     std::cerr << "Got a card...";
     
-    std::cout << "========================= NEW CARD =====" << std::endl;
+    CardReader::printMarker();
     selectAndReadApplications();
 
     std::cerr << "finished" << std::endl;
+
+    if (record) {
+      fflush(record);
+      if (options.timeIndex)
+	timeIndex.update();
+    }
   }
 
-  return 0;
+  int ret = 0;
+  if (options.forward) {
+    forwarder.stop();
+    forwarder.print();
+  }
+  if (record && closeRecord(record))
+    ret = 1;
+  return ret;
 }
@@ -0,0 +1,324 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <unordered_map>
+#include <deque>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "merchantindex.hh"
+#include "apdufile.hh"
+#include "paylogscan.hh"
+
+const char MerchantIndex::_MAGIC[8] = {'R', 'C', 'C', 'M', 'I', 'D', 'X', '1'};
+
+struct MerchantHeader {
+  char magic[8];
+  unsigned int nodes;
+  unsigned int names;
+  unsigned long long namesBytes;
+  unsigned long long postingsBytes;
+};
+
+static size_t align8(size_t size) {
+  return (size + 7) & ~(size_t)7;
+}
+
+MerchantIndex::MerchantIndex()
+  : _map(NULL),
+    _size(0)
+{
+}
+
+MerchantIndex::~MerchantIndex() {
+  if (_map)
+    munmap(_map, _size);
+}
+
+// Terminals pad names with spaces and lower case is rare, searches should not depend on either
+std::string MerchantIndex::normalize(char const* name, size_t length) {
+  while (length > 0 && (name[length - 1] == ' ' || name[length - 1] == 0))
+    --length;
+
+  std::string normalized(name, length);
+  for (char& c : normalized)
+    c = toupper((unsigned char)c);
+  return normalized;
+}
+
+// Names sharing a prefix form a range of the sorted names, each node is built from its range
+struct BuildRange {
+  size_t first;
+  size_t last;
+  size_t depth;
+  size_t node;
+};
+
+int MerchantIndex::build(char const* capturePath, char const* path) {
+  ApduFile capture;
+  if (capture.open(capturePath))
+    return 1;
+
+  std::unordered_map<std::string, std::vector<unsigned long long> > postings;
+  std::vector<PaylogEntry> entries;
+  byte_t const* session;
+  size_t size;
+  for (size_t offset = capture.tell(); capture.nextSession(session, size); offset = capture.tell()) {
+    entries.clear();
+    PaylogScan::scan(session, size, entries);
+    for (size_t i = 0; i < entries.size() && i < 0x100; ++i) {
+      std::string name = normalize(entries[i].merchant, entries[i].merchantLength);
+      if (!name.empty())
+	postings[name].push_back((unsigned long long)offset << 8 | i);
+    }
+  }
+
+  std::vector<std::string> names;
+  names.reserve(postings.size());
+  for (std::unordered_map<std::string, std::vector<unsigned long long> >::const_iterator it = postings.begin();
+       it != postings.end(); ++it)
+    names.push_back(it->first);
+  std::sort(names.begin(), names.end());
+
+  // Breadth-first, so the children of a node are created together
+  std::vector<Node> nodes(1);
+  std::deque<BuildRange> queue;
+  queue.push_back({0, names.size(), 0, 0});
+  while (!queue.empty()) {
+    BuildRange r = queue.front();
+    queue.pop_front();
+
+    size_t first = r.first;
+    nodes[r.node].name = ~0u;
+    if (first < r.last && names[first].size() == r.depth)
+      nodes[r.node].name = first++;
+    nodes[r.node].firstChild = nodes.size();
+    nodes[r.node].children = 0;
+
+    while (first < r.last) {
+      byte_t label = names[first][r.depth];
+      size_t last = first;
+      while (last < r.last && (byte_t)names[last][r.depth] == label)
+	++last;
+
+      Node child;
+      memset(&child, 0, sizeof(child));
+      child.label = label;
+      nodes.push_back(child);
+      nodes[r.node].children++;
+      queue.push_back({first, last, r.depth + 1, nodes.size() - 1});
+      first = last;
+    }
+  }
+
+  // Names, then postings as varint deltas
+  std::vector<unsigned> nameOffsets(1, 0);
+  std::string nameBytes;
+  std::vector<unsigned long long> postingOffsets(1, 0);
+  std::vector<byte_t> postingBytes;
+  for (std::string const& name : names) {
+    nameBytes += name;
+    nameOffsets.push_back(nameBytes.size());
+
+    unsigned long long previous = 0;
+    for (unsigned long long location : postings[name]) {
+      unsigned long long delta = location - previous;
+      previous = location;
+      do {
+	postingBytes.push_back((delta & 0x7F) | (delta > 0x7F ? 0x80 : 0));
+	delta >>= 7;
+      } while (delta);
+    }
+    postingOffsets.push_back(postingBytes.size());
+  }
+
+  static byte_t const padding[8] = {0};
+  MerchantHeader header;
+  memcpy(header.magic, _MAGIC, sizeof(_MAGIC));
+  header.nodes = nodes.size();
+  header.names = names.size();
+  header.namesBytes = nameBytes.size();
+  header.postingsBytes = postingBytes.size();
+  size_t nodePadding = align8(nodes.size() * sizeof(Node)) - nodes.size() * sizeof(Node);
+  size_t namePadding = align8(nameOffsets.size() * sizeof(unsigned)) - nameOffsets.size() * sizeof(unsigned);
+
+  std::string tmp = std::string(path) + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "wb");
+  if (file == NULL) {
+    perror(tmp.c_str());
+    return 1;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1
+    && fwrite(nodes.data(), sizeof(Node), nodes.size(), file) == nodes.size()
+    && fwrite(padding, 1, nodePadding, file) == nodePadding
+    && fwrite(nameOffsets.data(), sizeof(unsigned), nameOffsets.size(), file) == nameOffsets.size()
+    && fwrite(padding, 1, namePadding, file) == namePadding
+    && fwrite(postingOffsets.data(), sizeof(unsigned long long), postingOffsets.size(), file) == postingOffsets.size()
+    && fwrite(nameBytes.data(), 1, nameBytes.size(), file) == nameBytes.size()
+    && fwrite(postingBytes.data(), 1, postingBytes.size(), file) == postingBytes.size();
+  if (fclose(file) != 0 || !written || rename(tmp.c_str(), path) != 0) {
+    perror(path);
+    unlink(tmp.c_str());
+    return 1;
+  }
+
+  std::cerr << names.size() << " merchant(s), " << nodes.size() << " trie nodes, "
+	    << postingBytes.size() << " bytes of postings" << std::endl;
+  return 0;
+}
+
+int MerchantIndex::open(char const* path) {
+  int fd = ::open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    perror(path);
+    if (fd >= 0)
+      ::close(fd);
+    return 1;
+  }
+  _map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (_map == MAP_FAILED) {
+    _map = NULL;
+    perror(path);
+    return 1;
+  }
+  _size = st.st_size;
+
+  MerchantHeader const* header = (MerchantHeader const*)_map;
+  if (_size < sizeof(MerchantHeader) || memcmp(header->magic, _MAGIC, sizeof(_MAGIC))) {
+    std::cerr << path << ": not a merchant index" << std::endl;
+    return 1;
+  }
+
+  char const* p = (char const*)(header + 1);
+  _nodeCount = header->nodes;
+  _nameCount = header->names;
+  _nodes = (Node const*)p;
+  p += align8(_nodeCount * sizeof(Node));
+  _nameOffsets = (unsigned const*)p;
+  p += align8((_nameCount + 1) * sizeof(unsigned));
+  _postingOffsets = (unsigned long long const*)p;
+  p += (_nameCount + 1) * sizeof(unsigned long long);
+  _names = p;
+  _postings = (byte_t const*)(p + header->namesBytes);
+
+  if ((size_t)((char const*)_postings + header->postingsBytes - (char const*)_map) != _size) {
+    std::cerr << path << ": truncated merchant index" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+MerchantIndex::Node const* MerchantIndex::child(Node const& node, byte_t label) const {
+  Node const* first = _nodes + node.firstChild;
+  Node const* last = first + node.children;
+  Node const* it = std::lower_bound(first, last, label,
+				    [] (Node const& n, byte_t l) { return n.label < l; });
+  return it != last && it->label == label ? it : NULL;
+}
+
+void MerchantIndex::collect(Node const& node, std::vector<unsigned>& names) const {
+  if (node.name != ~0u)
+    names.push_back(node.name);
+  for (unsigned i = 0; i < node.children; ++i)
+    collect(_nodes[node.firstChild + i], names);
+}
+
+void MerchantIndex::prefix(std::string const& text, std::vector<unsigned>& names) const {
+  std::string key = normalize(text.data(), text.size());
+  Node const* node = _nodes;
+
+  for (size_t i = 0; node && i < key.size(); ++i)
+    node = child(*node, key[i]);
+  if (node)
+    collect(*node, names);
+}
+
+void MerchantIndex::fuzzy(Node const& node, std::string const& text, size_t position, bool edited,
+			  std::vector<unsigned>& names) const {
+  if (position == text.size() && node.name != ~0u)
+    names.push_back(node.name);
+
+  if (!edited && position < text.size()) // Extra character in the text
+    fuzzy(node, text, position + 1, true, names);
+
+  for (unsigned i = 0; i < node.children; ++i) {
+    Node const& c = _nodes[node.firstChild + i];
+    if (position < text.size() && c.label == (byte_t)text[position])
+      fuzzy(c, text, position + 1, edited, names);
+    else if (!edited) {
+      if (position < text.size()) // Different character
+	fuzzy(c, text, position + 1, true, names);
+      fuzzy(c, text, position, true, names); // Missing character
+    }
+  }
+}
+
+void MerchantIndex::fuzzy(std::string const& text, std::vector<unsigned>& names) const {
+  fuzzy(_nodes[0], normalize(text.data(), text.size()), 0, false, names);
+
+  // The same name can be reached with different edits
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+}
+
+std::string MerchantIndex::name(unsigned id) const {
+  return std::string(_names + _nameOffsets[id], _nameOffsets[id + 1] - _nameOffsets[id]);
+}
+
+void MerchantIndex::postings(unsigned id, std::vector<unsigned long long>& locations) const {
+  byte_t const* p = _postings + _postingOffsets[id];
+  byte_t const* end = _postings + _postingOffsets[id + 1];
+  unsigned long long location = 0;
+
+  while (p < end) {
+    unsigned long long delta = 0;
+    for (int shift = 0; p < end; shift += 7) {
+      delta |= (unsigned long long)(*p & 0x7F) << shift;
+      if (!(*p++ & 0x80))
+	break;
+    }
+    location += delta;
+    locations.push_back(location);
+  }
+}
+
+// Each name with its number of entries and the first top locations
+void MerchantIndex::print(std::vector<unsigned> const& names, size_t top, std::ostream& out) const {
+  std::vector<unsigned long long> locations;
+  for (unsigned id : names) {
+    locations.clear();
+    postings(id, locations);
+    out << name(id) << ": " << locations.size() << " entries";
+    for (size_t i = 0; i < locations.size() && (top == 0 || i < top); ++i)
+      out << (i ? ", " : " - ") << "card@" << (locations[i] >> 8) << " #" << (locations[i] & 0xFF);
+    out << std::endl;
+  }
+}
@@ -0,0 +1,83 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __MERCHANTINDEX_HH__
+# define __MERCHANTINDEX_HH__
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "tools.hh"
+
+/* Merchant names (9F4E) of a capture, upper case without trailing spaces, in a trie stored as arrays:
+   nodes in breadth-first order, the children of a node contiguous and sorted by label.
+   Each name maps to the posting list of its paylog entries (offset of the session << 8 | entry index),
+   delta and varint coded. The file is mapped and used in place.
+*/
+class MerchantIndex {
+
+public:
+  MerchantIndex();
+  ~MerchantIndex();
+
+public:
+  static int build(char const* capture, char const* path);
+
+  int open(char const* path);
+  void prefix(std::string const& text, std::vector<unsigned>& names) const;
+  void fuzzy(std::string const& text, std::vector<unsigned>& names) const; // Edit distance 1 at most
+  std::string name(unsigned id) const;
+  void postings(unsigned id, std::vector<unsigned long long>& locations) const;
+  void print(std::vector<unsigned> const& names, size_t top, std::ostream& out = std::cout) const;
+
+  static std::string normalize(char const* name, size_t length);
+
+public:
+  struct Node {
+    unsigned int firstChild;
+    unsigned int name; // ~0 if no name ends here
+    unsigned short children;
+    byte_t label;
+    byte_t pad;
+  };
+
+private:
+  Node const* child(Node const& node, byte_t label) const;
+  void collect(Node const& node, std::vector<unsigned>& names) const;
+  void fuzzy(Node const& node, std::string const& text, size_t position, bool edited, std::vector<unsigned>& names) const;
+
+private:
+  void* _map;
+  size_t _size;
+  Node const* _nodes;
+  unsigned _nodeCount;
+  unsigned const* _nameOffsets;
+  char const* _names;
+  unsigned _nameCount;
+  unsigned long long const* _postingOffsets;
+  byte_t const* _postings;
+
+  static const char _MAGIC[8];
+};
+
+#endif // __MERCHANTINDEX_HH__
@@ -0,0 +1,307 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+
+#include "options.hh"
+
+Options::Options()
+  : realtime(false),
+    cpu(-1),
+    priority(50),
+    jitterProbe(false),
+    kernelBench(0),
+    trace(0),
+    outputTemplate(NULL),
+    dump(false),
+    timeout(0),
+    retries(0),
+    readerErrors(3),
+    reconnectMax(30000),
+    readerMetrics(NULL),
+    simulate(0),
+    corpus(NULL),
+    generateCorpus(NULL),
+    cards(1000),
+    malformed(0.02),
+    record(NULL),
+    decodeTraces(false),
+    importText(false),
+    analytics(false),
+    top(20),
+    stats(NULL),
+    statsEvery(10),
+    mergeStats(false),
+    timeIndex(NULL),
+    index(NULL),
+    rangeFrom(NULL),
+    rangeTo(NULL),
+    merchantIndex(NULL),
+    prefix(NULL),
+    fuzzy(NULL),
+    archive(NULL),
+    binTable(NULL),
+    binRanges(NULL),
+    dedupe(false),
+    dedupeWindow(30),
+    forward(NULL),
+    spool(NULL),
+    forwardMetrics(NULL),
+    collect(0),
+    ring(NULL),
+    ringSize(4096),
+    followRing(NULL),
+    encryptKey(NULL),
+    generateKey(NULL),
+    decrypt(NULL),
+    encryptBench(0),
+    query(NULL),
+    blockIndex(NULL),
+    scaling(false),
+    perfStages(false),
+    diffDecoders(NULL),
+    threads(std::thread::hardware_concurrency())
+{
+  if (threads == 0)
+    threads = 1;
+}
+
+// Returns 0 on success, 1 if the command line is invalid
+int Options::parse(int argc, char** argv) {
+
+  for (int i = 1; i < argc; ++i) {
+    char const* arg = argv[i];
+
+    if (!strcmp(arg, "--realtime"))
+      realtime = true;
+    else if (!strcmp(arg, "--cpu") && i + 1 < argc)
+      cpu = atoi(argv[++i]);
+    else if (!strcmp(arg, "--priority") && i + 1 < argc)
+      priority = atoi(argv[++i]);
+    else if (!strcmp(arg, "--jitter-probe"))
+      jitterProbe = true;
+    else if (!strcmp(arg, "--template") && i + 1 < argc)
+      outputTemplate = argv[++i];
+    else if (!strcmp(arg, "--trace") && i + 1 < argc)
+      trace = atoi(argv[++i]);
+    else if (!strcmp(arg, "--dump"))
+      dump = true;
+    else if (!strcmp(arg, "--timeout") && i + 1 < argc)
+      timeout = atoi(argv[++i]);
+    else if (!strcmp(arg, "--retries") && i + 1 < argc)
+      retries = atoi(argv[++i]);
+    else if (!strcmp(arg, "--reader-errors") && i + 1 < argc)
+      readerErrors = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(arg, "--reconnect-max") && i + 1 < argc)
+      reconnectMax = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(arg, "--reader-metrics") && i + 1 < argc)
+      readerMetrics = argv[++i];
+    else if (!strcmp(arg, "--simulate") && i + 1 < argc)
+      simulate = atoi(argv[++i]);
+    else if (!strcmp(arg, "--rf-latency") && i + 1 < argc)
+      faults.rfLatency = atoi(argv[++i]);
+    else if (!strcmp(arg, "--fault-spike") && i + 1 < argc) {
+      char* end;
+      faults.spikeRate = strtod(argv[++i], &end);
+      if (*end == ':')
+	faults.spikeLatency = atoi(end + 1);
+    }
+    else if (!strcmp(arg, "--fault-drop") && i + 1 < argc)
+      faults.dropRate = atof(argv[++i]);
+    else if (!strcmp(arg, "--fault-corrupt") && i + 1 < argc)
+      faults.corruptRate = atof(argv[++i]);
+    else if (!strcmp(arg, "--fault-status") && i + 1 < argc)
+      faults.statusRate = atof(argv[++i]);
+    else if (!strcmp(arg, "--fault-removal") && i + 1 < argc)
+      faults.removalAfter = atoi(argv[++i]);
+    else if (!strcmp(arg, "--seed") && i + 1 < argc)
+      faults.seed = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(arg, "--corpus") && i + 1 < argc)
+      corpus = argv[++i];
+    else if (!strcmp(arg, "--generate-corpus") && i + 1 < argc)
+      generateCorpus = argv[++i];
+    else if (!strcmp(arg, "--cards") && i + 1 < argc)
+      cards = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(arg, "--malformed") && i + 1 < argc)
+      malformed = atof(argv[++i]);
+    else if (!strcmp(arg, "--record") && i + 1 < argc)
+      record = argv[++i];
+    else if (!strcmp(arg, "--decode-traces"))
+      decodeTraces = true;
+    else if (!strcmp(arg, "--import-text"))
+      importText = true;
+    else if (!strcmp(arg, "--analytics"))
+      analytics = true;
+    else if (!strcmp(arg, "--top") && i + 1 < argc)
+      top = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(arg, "--stats") && i + 1 < argc)
+      stats = argv[++i];
+    else if (!strcmp(arg, "--stats-every") && i + 1 < argc)
+      statsEvery = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(arg, "--merge-stats"))
+      mergeStats = true;
+    else if (!strcmp(arg, "--time-index") && i + 1 < argc)
+      timeIndex = argv[++i];
+    else if (!strcmp(arg, "--index") && i + 1 < argc)
+      index = argv[++i];
+    else if (!strcmp(arg, "--time-range") && i + 2 < argc) {
+      rangeFrom = argv[++i];
+      rangeTo = argv[++i];
+    }
+    else if (!strcmp(arg, "--merchant-index") && i + 1 < argc)
+      merchantIndex = argv[++i];
+    else if (!strcmp(arg, "--prefix") && i + 1 < argc)
+      prefix = argv[++i];
+    else if (!strcmp(arg, "--fuzzy") && i + 1 < argc)
+      fuzzy = argv[++i];
+    else if (!strcmp(arg, "--archive") && i + 1 < argc)
+      archive = argv[++i];
+    else if (!strcmp(arg, "--bin-table") && i + 1 < argc)
+      binTable = argv[++i];
+    else if (!strcmp(arg, "--bin-ranges") && i + 1 < argc)
+      binRanges = argv[++i];
+    else if (!strcmp(arg, "--dedupe"))
+      dedupe = true;
+    else if (!strcmp(arg, "--dedupe-window") && i + 1 < argc)
+      dedupeWindow = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(arg, "--forward") && i + 1 < argc)
+      forward = argv[++i];
+    else if (!strcmp(arg, "--spool") && i + 1 < argc)
+      spool = argv[++i];
+    else if (!strcmp(arg, "--forward-metrics") && i + 1 < argc)
+      forwardMetrics = argv[++i];
+    else if (!strcmp(arg, "--collect") && i + 1 < argc)
+      collect = atoi(argv[++i]);
+    else if (!strcmp(arg, "--ring") && i + 1 < argc)
+      ring = argv[++i];
+    else if (!strcmp(arg, "--ring-size") && i + 1 < argc)
+      ringSize = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(arg, "--follow-ring") && i + 1 < argc)
+      followRing = argv[++i];
+    else if (!strcmp(arg, "--encrypt-key") && i + 1 < argc)
+      encryptKey = argv[++i];
+    else if (!strcmp(arg, "--generate-key") && i + 1 < argc)
+      generateKey = argv[++i];
+    else if (!strcmp(arg, "--decrypt") && i + 1 < argc)
+      decrypt = argv[++i];
+    else if (!strcmp(arg, "--encrypt-bench") && i + 1 < argc)
+      encryptBench = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(arg, "--kernel-bench") && i + 1 < argc)
+      kernelBench = strtoul(argv[++i], NULL, 10);
+    else if (i == 1 && !strcmp(arg, "query") && i + 1 < argc)
+      query = argv[++i];
+    else if (!strcmp(arg, "--block-index") && i + 1 < argc)
+      blockIndex = argv[++i];
+    else if (!strcmp(arg, "--perf-stages"))
+      perfStages = true;
+    else if (!strcmp(arg, "--diff-decoders") && i + 1 < argc)
+      diffDecoders = argv[++i];
+    else if (!strcmp(arg, "--scaling"))
+      scaling = true;
+    else if (!strcmp(arg, "--threads") && i + 1 < argc)
+      threads = strtoul(argv[++i], NULL, 10);
+    else if (arg[0] != '-')
+      files.push_back(arg);
+    else if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) {
+      usage(argv[0]);
+      exit(EXIT_SUCCESS);
+    }
+    else {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void Options::usage(char const* name) {
+  std::cerr << "Usage: " << name << " [options] [files]" << std::endl
+	    << "       " << name << " query EXPRESSION [options] CAPTURE..." << std::endl
+	    << "  EXPRESSION: space separated terms that must all hold, values separated by commas:" << std::endl
+	    << "    aid=A000000004,...  expiry=YYYY-MM[..YYYY-MM]  country=FRA,...  currency=EUR,..." << std::endl
+	    << "    amount=MIN..MAX  date=YYYY-MM-DD[..YYYY-MM-DD]  merchant=NAME,PREFIX*,'TWO WORDS'" << std::endl
+	    << "  --realtime         Pin the reader to a CPU, use SCHED_FIFO and lock memory" << std::endl
+	    << "  --cpu N            CPU used by --realtime (default: last allowed CPU)" << std::endl
+	    << "  --priority N       SCHED_FIFO priority used by --realtime (default: 50)" << std::endl
+	    << "  --jitter-probe     Measure wake-up latency and APDU overhead with and without --realtime" << std::endl
+	    << "  --kernel-bench MB  Time the hex and printable kernels against the stream versions and exit" << std::endl
+	    << "  --trace N          APDU trace level on stderr: 0 off, 1 status words, 2 full frames" << std::endl
+	    << "                     (SIGUSR1 raises the level up to 2, SIGUSR2 turns tracing off)" << std::endl
+	    << "  --template TEXT    Print the cards as TEXT, e.g. \"{aid} {pan} {expiry} {paylog.amount}\"" << std::endl
+	    << "  --dump             Read and print every record of SFI 1-30, records 1-16" << std::endl
+	    << "  --timeout MS       Card exchange timeout (default: 0, wait forever)" << std::endl
+	    << "  --retries N        Extra attempts when an exchange fails (default: 0)" << std::endl
+	    << "  --reader-errors N  Consecutive failed exchanges before the NFC device is reopened (default: 3)" << std::endl
+	    << "  --reconnect-max MS Longest wait between two attempts to open the device (default: 30000)" << std::endl
+	    << "  --reader-metrics FILE  Write the NFC device counters and recovery times there" << std::endl
+	    << "  --simulate N       Read N simulated cards and print throughput and latency" << std::endl
+	    << "  --rf-latency MS    Simulated time of each exchange (default: 2)" << std::endl
+	    << "  --fault-spike P[:MS]  Probability of a latency spike per APDU (default: 50ms)" << std::endl
+	    << "  --fault-drop P     Probability of a lost answer per APDU" << std::endl
+	    << "  --fault-corrupt P  Probability of a corrupted answer per APDU" << std::endl
+	    << "  --fault-status P   Probability of an unexpected 6A82, 6985, 61xx or 6Cxx per APDU" << std::endl
+	    << "  --fault-removal N  Card leaves the field after N APDUs" << std::endl
+	    << "  --seed S           Seed of the simulated faults and of the generated corpus (default: 1)" << std::endl
+	    << "  --corpus FILE      Cards read by --simulate, in turn (default: one built-in card)" << std::endl
+	    << "  --generate-corpus FILE  Write a synthetic card corpus and exit" << std::endl
+	    << "  --cards N          Number of cards of the generated corpus (default: 1000)" << std::endl
+	    << "  --malformed P      Share of malformed cards in the generated corpus (default: 0.02)" << std::endl
+	    << "  --record FILE      Append every exchange with the card to an APDU file" << std::endl
+	    << "  --encrypt-key FILE  Encrypt --record with AES-256-GCM, data keys wrapped by this 32-byte master key" << std::endl
+	    << "  --generate-key FILE  Write a random master key and exit" << std::endl
+	    << "  --decrypt FILE     Write the plain APDU file of an encrypted capture to stdout and exit" << std::endl
+	    << "  --encrypt-bench MB  Time writing MB of the --corpus exchanges with and without encryption" << std::endl
+	    << "  --decode-traces FILE...  Decode recorded APDU files offline and exit" << std::endl
+	    << "  --import-text FILE...  Parse text dumps of readcc into tab separated records and exit" << std::endl
+	    << "  --analytics FILE...  Print paylog statistics of recorded APDU files and exit" << std::endl
+	    << "  --top N            Merchants and countries printed by --analytics (default: 20, 0 = all)" << std::endl
+	    << "  --dedupe           Print and count only the paylog entries not seen in a previous read" << std::endl
+	    << "  --dedupe-window D  Days after which an entry no longer seen is forgotten (default: 30)" << std::endl
+	    << "  --forward HOST:PORT  Send every card to a collector, in batches" << std::endl
+	    << "  --spool FILE       Keep the batches of --forward there while the collector is unreachable" << std::endl
+	    << "  --forward-metrics FILE  Write the counters of --forward there every second" << std::endl
+	    << "  --collect PORT     Run a local collector for --forward, print the cards it gets as --import-text does" << std::endl
+	    << "  --ring NAME        Publish every card in a shared memory ring (/dev/shm/NAME) for local readers" << std::endl
+	    << "  --ring-size KB     Capacity of --ring (default: 4096)" << std::endl
+	    << "  --follow-ring NAME  Print the cards published in a ring as --import-text does, until killed" << std::endl
+	    << "  --stats FILE       Keep distinct cards, top merchants and BINs and amount quantiles in a snapshot" << std::endl
+	    << "  --stats-every N    Reads between two snapshots of --stats (default: 10)" << std::endl
+	    << "  --merge-stats FILE...  Merge and print snapshots, saved to --stats if given, and exit" << std::endl
+	    << "  --time-index DIR   Time index of the paylog entries of --record, --index or --time-range" << std::endl
+	    << "  --index FILE       Update --time-index, build --merchant-index, --block-index and --archive of an APDU file and exit" << std::endl
+	    << "  --time-range FROM TO  Print the indexed entries between two dates (YYYY-MM-DD[THH:MM:SS]) and exit" << std::endl
+	    << "  --merchant-index FILE  Merchant name index built by --index or searched by --prefix and --fuzzy" << std::endl
+	    << "  --prefix TEXT      Print the merchants starting with TEXT, with --top of their entries, and exit" << std::endl
+	    << "  --fuzzy TEXT       Print the merchants at most one edit away from TEXT and exit" << std::endl
+	    << "  --block-index FILE  Block statistics built by --index, used by query to skip blocks" << std::endl
+	    << "  --archive FILE     Compressed paylogs built by --index, printed and exit otherwise" << std::endl
+	    << "  --bin-table FILE   Print the issuer, brand, card type and country of each PAN from this BIN table" << std::endl
+	    << "  --bin-ranges FILE  Build --bin-table from tab separated ranges (first last brand type country issuer) and exit" << std::endl
+	    << "  --threads N        Threads used to decode, import or analyse files (default: number of CPUs)" << std::endl
+	    << "  --scaling          With --decode-traces, benchmark from 1 to --threads threads" << std::endl
+	    << "  --perf-stages      With --decode-traces or --simulate, time and count cycles, instructions and misses per read stage" << std::endl
+	    << "  --diff-decoders A,B FILE...  Decode APDU files with two decoders (legacy, ccinfo), print the field mismatches and exit" << std::endl;
+}
@@ -0,0 +1,131 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __OPTIONS_HH__
+# define __OPTIONS_HH__
+
+#include <vector>
+
+#include "simulator.hh"
+
+// Command line options
+class Options {
+
+public:
+  Options();
+
+public:
+  int parse(int argc, char** argv);
+  static void usage(char const* name);
+
+public:
+  // Realtime reader mode
+  bool realtime;
+  int cpu; // -1 picks the last CPU the process may run on
+  int priority; // SCHED_FIFO priority
+  bool jitterProbe;
+  size_t kernelBench; // MB run through the hex and printable kernels
+
+  int trace; // Trace::Level
+  char const* outputTemplate; // --template, NULL = full print
+  bool dump; // Read every record of every SFI
+
+  // Card exchange policy
+  int timeout; // ms
+  int retries;
+  unsigned readerErrors; // Consecutive failed exchanges before the device is reopened
+  unsigned reconnectMax; // ms, longest wait between two attempts to open the device
+  char const* readerMetrics;
+
+  // Simulated card instead of the reader
+  int simulate; // Number of cards to read, 0 = use the reader
+  FaultConfig faults;
+  char const* corpus; // Cards for the simulation
+
+  // Synthetic corpus generation
+  char const* generateCorpus;
+  size_t cards;
+  double malformed; // Share of malformed cards
+
+  // Recorded traces
+  char const* record; // APDU file receiving every exchange
+  bool decodeTraces;
+  bool importText; // Legacy text dumps
+  bool analytics; // Paylog statistics
+  size_t top; // Rows of the largest tables
+
+  // Live statistics
+  char const* stats; // Snapshot, loaded at start when present
+  unsigned statsEvery; // Reads between two snapshots
+  bool mergeStats;
+
+  // Time index over the paylog entries of a capture
+  char const* timeIndex; // Directory
+  char const* index; // Capture to index
+  char const* rangeFrom;
+  char const* rangeTo;
+
+  // Merchant name index of a capture
+  char const* merchantIndex; // Index file
+  char const* prefix;
+  char const* fuzzy;
+
+  // Compressed paylog archive of a capture
+  char const* archive;
+
+  // Issuer lookup from the PAN, table built from --bin-ranges
+  char const* binTable;
+  char const* binRanges; // Tab separated source
+
+  // Cross-read paylog deduplication
+  bool dedupe;
+  unsigned dedupeWindow; // Days
+
+  // Push of the cards to a collector
+  char const* forward; // HOST:PORT
+  char const* spool;
+  char const* forwardMetrics;
+  int collect; // Port of the stand-in collector, 0 = off
+
+  // Shared memory ring of the cards for local readers
+  char const* ring; // shm name
+  size_t ringSize; // KB
+  char const* followRing;
+
+  // Encryption of --record
+  char const* encryptKey; // Master key file
+  char const* generateKey;
+  char const* decrypt;
+  size_t encryptBench; // MB
+
+  // readcc query EXPRESSION [--block-index FILE] CAPTURE...
+  char const* query;
+  char const* blockIndex;
+  bool scaling; // Decoding benchmark from 1 to --threads threads
+  bool perfStages; // Counters per read stage with --decode-traces or --simulate
+  char const* diffDecoders; // Two decoders compared over the positional APDU files, "legacy,ccinfo"
+  unsigned threads;
+
+  std::vector<char const*> files; // Positional arguments
+};
+
+#endif // __OPTIONS_HH__
@@ -0,0 +1,247 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstring>
+
+#include "outputtemplate.hh"
+
+const OutputTemplate::Field OutputTemplate::_FIELDS[] = {
+  {"aid", AID}, {"name", NAME}, {"priority", PRIORITY}, {"language", LANGUAGE}, {"cardholder", CARDHOLDER},
+  {"pan", PAN}, {"expiry", EXPIRY}, {"service", SERVICE_CODE}, {"track1", TRACK1}, {"track2", TRACK2},
+  {"issuer", ISSUER}, {"brand", BRAND}, {"cardtype", CARD_TYPE}, {"issuer.country", ISSUER_COUNTRY},
+  {"logcount", LOG_COUNT}, {"paylog.index", ENTRY_INDEX}, {"paylog.date", DATE}, {"paylog.time", TIME},
+  {"paylog.amount", AMOUNT}, {"paylog.currency", CURRENCY}, {"paylog.country", COUNTRY},
+  {"paylog.merchant", MERCHANT}, {"paylog.type", TYPE}, {"paylog.atc", ATC}, {"paylog.cid", CID}
+};
+
+const size_t OutputTemplate::_FIELD_COUNT = sizeof(_FIELDS) / sizeof(*_FIELDS);
+
+OutputTemplate::OutputTemplate()
+  : _perEntry(false) {
+}
+
+int OutputTemplate::compile(char const* text) {
+  _ops.clear();
+  _literals.clear();
+  _perEntry = false;
+
+  std::string literal;
+  for (char const* p = text; *p; ++p) {
+    if (*p == '\\' && p[1]) {
+      ++p;
+      literal += *p == 't' ? '\t' : *p == 'n' ? '\n' : *p;
+      continue;
+    }
+    if ((*p == '{' || *p == '}') && p[1] == *p) {
+      literal += *p++;
+      continue;
+    }
+    if (*p == '}') {
+      std::cerr << "Unmatched } in the template at column " << p - text + 1 << std::endl;
+      return 1;
+    }
+    if (*p != '{') {
+      literal += *p;
+      continue;
+    }
+
+    char const* end = strchr(p, '}');
+    if (!end) {
+      std::cerr << "Unterminated { in the template at column " << p - text + 1 << std::endl;
+      return 1;
+    }
+    std::string name(p + 1, end);
+    size_t f = 0;
+    while (f < _FIELD_COUNT && name != _FIELDS[f].name)
+      ++f;
+    if (f == _FIELD_COUNT) {
+      std::cerr << "Unknown template field: {" << name << "}" << std::endl;
+      return 1;
+    }
+
+    // Adjacent literal text is merged into one operation
+    if (!literal.empty()) {
+      Emit e = {LITERAL, (unsigned int)_literals.size(), (unsigned int)literal.size()};
+      _ops.push_back(e);
+      _literals += literal;
+      literal.clear();
+    }
+    Emit e = {_FIELDS[f].op, 0, 0};
+    _ops.push_back(e);
+    _perEntry |= e.op >= ENTRY_INDEX;
+    p = end;
+  }
+
+  literal += '\n';
+  Emit e = {LITERAL, (unsigned int)_literals.size(), (unsigned int)literal.size()};
+  _ops.push_back(e);
+  _literals += literal;
+  return 0;
+}
+
+void OutputTemplate::print(std::vector<CCInfo> const& infos, std::ostream& out) const {
+  std::string line;
+
+  for (CCInfo const& info : infos) {
+    if (!_perEntry) {
+      emit(info, 0, line);
+      continue;
+    }
+    size_t count = info.logEntryCount();
+    for (size_t index = 0; index < count; ++index)
+      if (!info.logEntryDropped(index))
+	emit(info, index, line);
+  }
+  out.write(line.data(), line.size());
+}
+
+static void appendHex(std::string& line, byte_t const* data, size_t size) {
+  size_t at = line.size();
+  line.resize(at + 2 * size);
+  Tools::toHex(data, size, &line[at]);
+}
+
+// BCD bytes joined by a separator, with a prefix: 20YY/MM/DD
+static void appendBcd(std::string& line, char const* prefix, byte_t const* bcd, size_t size, char separator) {
+  line += prefix;
+  for (size_t i = 0; i < size; ++i) {
+    if (i)
+      line += separator;
+    appendHex(line, bcd + i, 1);
+  }
+}
+
+// The name when known, the code as stored otherwise
+static void appendCode(std::string& line, char const* name, unsigned short code) {
+  if (name) {
+    line += name;
+    return;
+  }
+  byte_t const bytes[2] = {(byte_t)(code >> 8), (byte_t)code};
+  appendHex(line, bytes, sizeof(bytes));
+}
+
+void OutputTemplate::emit(CCInfo const& info, size_t entry, std::string& line) const {
+  size_t size;
+  byte_t const* data;
+
+  for (Emit const& e : _ops) {
+    switch (e.op) {
+    case LITERAL:
+      line.append(_literals, e.offset, e.length);
+      break;
+    case AID:
+      appendHex(line, info.application().aid, sizeof(info.application().aid));
+      break;
+    case NAME:
+      line += info.application().name;
+      break;
+    case PRIORITY:
+      line += (char)('0' + info.application().priority);
+      break;
+    case LANGUAGE:
+      line += info.languagePreference();
+      break;
+    case CARDHOLDER:
+      line += info.cardholderName();
+      break;
+    case PAN:
+      line += info.track2().pan;
+      break;
+    case EXPIRY: {
+      Track2 const& t = info.track2();
+      appendHex(line, &t.expiryMonth, 1);
+      line += "/20";
+      appendHex(line, &t.expiryYear, 1);
+      break;
+    }
+    case SERVICE_CODE:
+      line += info.track2().serviceCode;
+      break;
+    case TRACK1:
+      data = info.track1Data(size);
+      appendHex(line, data, size);
+      break;
+    case TRACK2:
+      data = info.track2Data(size);
+      appendHex(line, data, size);
+      break;
+    case ISSUER:
+      if (info.issuer().issuer)
+	line += info.issuer().issuer;
+      break;
+    case BRAND:
+      if (info.issuer().brand)
+	line += info.issuer().brand;
+      break;
+    case CARD_TYPE:
+      if (info.issuer().type)
+	line += info.issuer().type;
+      break;
+    case ISSUER_COUNTRY:
+      if (info.issuer().country)
+	appendCode(line, CCInfo::countryName(info.issuer().country), info.issuer().country);
+      break;
+    case LOG_COUNT:
+      line += std::to_string((unsigned int)info.logCount());
+      break;
+    case ENTRY_INDEX:
+      line += std::to_string((unsigned long long)entry);
+      break;
+    case DATE:
+      appendBcd(line, "20", info.logEntry(entry).date, 3, '/');
+      break;
+    case TIME:
+      appendBcd(line, "", info.logEntry(entry).time, 3, ':');
+      break;
+    case AMOUNT: {
+      unsigned long long amount = info.logEntry(entry).amountValue;
+      line += std::to_string(amount / 100);
+      line += '.';
+      line += (char)('0' + amount % 100 / 10);
+      line += (char)('0' + amount % 10);
+      break;
+    }
+    case CURRENCY:
+      appendCode(line, info.logEntry(entry).currencyName, info.logEntry(entry).currency);
+      break;
+    case COUNTRY:
+      appendCode(line, info.logEntry(entry).countryName, info.logEntry(entry).country);
+      break;
+    case MERCHANT:
+      line.append(info.logEntry(entry).merchant, info.logEntry(entry).merchantLength);
+      break;
+    case TYPE:
+      line += info.logEntry(entry).type ? "Withdrawal" : "Payment";
+      break;
+    case ATC: {
+      unsigned short counter = info.logEntry(entry).counter;
+      byte_t const bytes[2] = {(byte_t)(counter >> 8), (byte_t)counter};
+      appendHex(line, bytes, sizeof(bytes));
+      break;
+    }
+    case CID:
+      appendHex(line, &info.logEntry(entry).cryptoInfo, 1);
+      break;
+    }
+  }
+}
@@ -0,0 +1,105 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __OUTPUTTEMPLATE_HH__
+# define __OUTPUTTEMPLATE_HH__
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "ccinfo.hh"
+
+/* User layout of the cards, replacing CCInfo::printAll: "{aid} {pan} {expiry} {paylog.amount}".
+   Application fields: aid name priority language cardholder pan expiry service track1 track2 logcount
+		       issuer brand cardtype issuer.country (with --bin-table)
+   Paylog fields: paylog.index paylog.date paylog.time paylog.amount paylog.currency paylog.country
+		  paylog.merchant paylog.type paylog.atc paylog.cid
+   With a paylog field, one line is printed per paylog entry, none for an application without entries;
+   otherwise one line per application. {{ and }} print braces, \t \n and \\ the usual characters.
+   The text is compiled once into a list of operations, and a card only decodes what they use.
+*/
+class OutputTemplate {
+
+public:
+  OutputTemplate();
+
+public:
+  int compile(char const* text);
+  void print(std::vector<CCInfo> const& infos, std::ostream& out = std::cout) const;
+
+private:
+  enum Op {
+    LITERAL,
+    AID,
+    NAME,
+    PRIORITY,
+    LANGUAGE,
+    CARDHOLDER,
+    PAN,
+    EXPIRY,
+    SERVICE_CODE,
+    TRACK1,
+    TRACK2,
+    ISSUER,
+    BRAND,
+    CARD_TYPE,
+    ISSUER_COUNTRY,
+    LOG_COUNT,
+    ENTRY_INDEX, // First paylog field
+    DATE,
+    TIME,
+    AMOUNT,
+    CURRENCY,
+    COUNTRY,
+    MERCHANT,
+    TYPE,
+    ATC,
+    CID
+  };
+
+  struct Emit {
+    Op op;
+    unsigned int offset; // Literal text in _literals
+    unsigned int length;
+  };
+
+  struct Field {
+    char const* name;
+    Op op;
+  };
+
+private:
+  void emit(CCInfo const& info, size_t entry, std::string& line) const;
+
+private:
+  std::vector<Emit> _ops;
+  std::string _literals;
+  bool _perEntry;
+
+private:
+  static const Field _FIELDS[];
+  static const size_t _FIELD_COUNT;
+};
+
+#endif // __OUTPUTTEMPLATE_HH__
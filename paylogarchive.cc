@@ -0,0 +1,528 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <sstream>
+#include <unordered_map>
+
+#include "paylogarchive.hh"
+#include "blockcodec.hh"
+#include "apdufile.hh"
+#include "tracedecoder.hh"
+#include "workpool.hh"
+
+const char PaylogArchive::_MAGIC[8] = {'R', 'C', 'C', 'P', 'L', 'A', '0', '1'};
+
+static void putVarint(std::string& out, unsigned long long value) {
+  for (; value >= 0x80; value >>= 7)
+    out += (char)(value | 0x80);
+  out += (char)value;
+}
+
+static unsigned long long zigzag(long long value) {
+  return (unsigned long long)value << 1 ^ (unsigned long long)(value >> 63);
+}
+
+static long long unzigzag(unsigned long long value) {
+  return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+// False if a nibble is not a decimal digit
+static bool fromBcd(byte_t const* bcd, size_t size, unsigned long long& value) {
+  value = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if ((bcd[i] >> 4) > 9 || (bcd[i] & 0x0F) > 9)
+      return false;
+    value = value * 100 + (bcd[i] >> 4) * 10 + (bcd[i] & 0x0F);
+  }
+  return true;
+}
+
+static void toBcd(unsigned long long value, byte_t* bcd, size_t size) {
+  for (size_t i = size; i-- > 0; value /= 100)
+    bcd[i] = (value % 100 / 10) << 4 | value % 10;
+}
+
+static unsigned long long bytesValue(byte_t const* bytes, size_t size) {
+  unsigned long long value = 0;
+  for (size_t i = 0; i < size; ++i)
+    value = value << 8 | bytes[i];
+  return value;
+}
+
+static void valueBytes(unsigned long long value, byte_t* bytes, size_t size) {
+  for (size_t i = size; i-- > 0; value >>= 8)
+    bytes[i] = value;
+}
+
+struct ArchiveDictionary {
+  std::unordered_map<std::string, unsigned> ids;
+  std::vector<std::string> values;
+
+  unsigned id(std::string const& value) {
+    std::unordered_map<std::string, unsigned>::const_iterator it = ids.find(value);
+    if (it != ids.end())
+      return it->second;
+    ids[value] = values.size();
+    values.push_back(value);
+    return values.size() - 1;
+  }
+
+  void write(std::string& out) const {
+    putVarint(out, values.size());
+    for (std::string const& v : values) {
+      putVarint(out, v.size());
+      out += v;
+    }
+  }
+};
+
+// Columns of the segment being built
+struct ArchiveWriter {
+  ArchiveDictionary layouts, aids, currencies, countries, merchants;
+  std::string pan, aid, layout, count;
+  std::string date, time, amount, currency, country, merchant, type, atc, cid;
+  unsigned long long lastDate;
+  unsigned apps;
+  unsigned entries;
+
+  ArchiveWriter() : lastDate(0), apps(0), entries(0) {}
+
+  void add(CCInfo const& info) {
+    char const* digits = info.track2().pan;
+    size_t n = strlen(digits);
+    pan += (char)n;
+    for (size_t i = 0; i < n; i += 2)
+      pan += (char)((digits[i] - '0') << 4 | (i + 1 < n ? digits[i + 1] - '0' : 0x0F));
+
+    Application const& application = info.application();
+    putVarint(aid, aids.id(std::string((char const*)application.aid, sizeof(application.aid))));
+
+    std::string format;
+    for (LogField const& f : info.logLayout()) {
+      format += (char)(f.tag >> 8);
+      format += (char)f.tag;
+      format += (char)f.length;
+    }
+    putVarint(layout, layouts.id(format));
+
+    size_t logEntries = info.logEntryCount();
+    putVarint(count, logEntries);
+    unsigned lastCounter = 0;
+    for (size_t i = 0; i < logEntries; ++i) {
+      PaylogEntry const& e = info.logEntry(i);
+      addEntry(e, lastCounter);
+      lastCounter = e.counter;
+    }
+    ++apps;
+    entries += logEntries;
+  }
+
+  void addEntry(PaylogEntry const& e, unsigned lastCounter) {
+    unsigned long long d = bytesValue(e.date, sizeof(e.date));
+    putVarint(date, zigzag((long long)d - (long long)lastDate));
+    lastDate = d;
+
+    unsigned long long h, m, s;
+    if (fromBcd(e.time, 1, h) && fromBcd(e.time + 1, 1, m) && fromBcd(e.time + 2, 1, s) && h < 24 && m < 60 && s < 60)
+      putVarint(time, (h * 3600 + m * 60 + s) << 1);
+    else
+      putVarint(time, bytesValue(e.time, sizeof(e.time)) << 1 | 1);
+
+    unsigned long long value;
+    if (fromBcd(e.amount, sizeof(e.amount), value))
+      putVarint(amount, value << 1);
+    else
+      putVarint(amount, bytesValue(e.amount, sizeof(e.amount)) << 1 | 1);
+
+    putVarint(currency, currencies.id(std::string(1, (char)(e.currency >> 8)) + (char)e.currency));
+    putVarint(country, countries.id(std::string(1, (char)(e.country >> 8)) + (char)e.country));
+    putVarint(merchant, merchants.id(std::string(e.merchant, e.merchantLength)));
+    type += (char)e.type;
+    putVarint(atc, zigzag((long long)e.counter - (long long)lastCounter));
+    cid += (char)e.cryptoInfo;
+  }
+
+  void finish(std::string& raw) const {
+    layouts.write(raw);
+    aids.write(raw);
+    currencies.write(raw);
+    countries.write(raw);
+    merchants.write(raw);
+    std::string const* columns[] = {&pan, &aid, &layout, &count,
+				    &date, &time, &amount, &currency, &country, &merchant, &type, &atc, &cid};
+    for (std::string const* c : columns) {
+      putVarint(raw, c->size());
+      raw += *c;
+    }
+  }
+};
+
+// Bounds checked reading of a segment, ok turns false past the end
+struct ArchiveReader {
+  byte_t const* cursor;
+  byte_t const* end;
+  bool ok;
+
+  byte_t byte() {
+    if (cursor >= end) {
+      ok = false;
+      return 0;
+    }
+    return *cursor++;
+  }
+
+  unsigned long long varint() {
+    unsigned long long value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      byte_t b = byte();
+      value |= (unsigned long long)(b & 0x7F) << shift;
+      if (!(b & 0x80))
+	break;
+    }
+    return value;
+  }
+
+  byte_t const* bytes(size_t size) {
+    if ((size_t)(end - cursor) < size) {
+      ok = false;
+      cursor = end;
+      return NULL;
+    }
+    cursor += size;
+    return cursor - size;
+  }
+
+  // The next column, as a reader of its own
+  ArchiveReader column() {
+    size_t size = varint();
+    byte_t const* start = bytes(size);
+    ArchiveReader c = {start, start ? start + size : NULL, start != NULL};
+    return c;
+  }
+
+  bool dictionary(std::vector<std::string>& values) {
+    values.resize(varint());
+    for (std::string& v : values) {
+      size_t size = varint();
+      byte_t const* data = bytes(size);
+      if (!data)
+	return false;
+      v.assign((char const*)data, size);
+    }
+    return ok;
+  }
+
+  // Index in a dictionary of count values
+  unsigned index(size_t count) {
+    unsigned long long i = varint();
+    if (i >= count) {
+      ok = false;
+      return 0;
+    }
+    return i;
+  }
+};
+
+bool PaylogArchive::decodeSegment(byte_t const* raw, size_t size, unsigned apps, unsigned entries,
+				  ArchiveSegment& segment) {
+  ArchiveReader in = {raw, raw + size, true};
+  std::vector<std::string> layouts, aids, currencies, countries, merchants;
+  if (!in.dictionary(layouts) || !in.dictionary(aids) || !in.dictionary(currencies) || !in.dictionary(countries)
+      || !in.dictionary(merchants))
+    return false;
+
+  segment.layouts.resize(layouts.size());
+  for (size_t i = 0; i < layouts.size(); ++i) {
+    std::vector<LogField>& fields = segment.layouts[i];
+    fields.clear();
+    byte_t offset = 0;
+    for (size_t j = 0; j + 3 <= layouts[i].size(); j += 3) {
+      byte_t const* f = (byte_t const*)layouts[i].data() + j;
+      fields.push_back({(unsigned short)(f[0] << 8 | f[1]), offset, f[2]});
+      offset += f[2];
+    }
+  }
+
+  // Names are looked up once per dictionary entry, not per paylog entry
+  std::vector<unsigned short> currencyCodes(currencies.size()), countryCodes(countries.size());
+  std::vector<char const*> currencyNames(currencies.size()), countryNames(countries.size());
+  for (size_t i = 0; i < currencies.size(); ++i) {
+    currencyCodes[i] = bytesValue((byte_t const*)currencies[i].data(), currencies[i].size());
+    currencyNames[i] = CCInfo::currencyName(currencyCodes[i]);
+  }
+  for (size_t i = 0; i < countries.size(); ++i) {
+    countryCodes[i] = bytesValue((byte_t const*)countries[i].data(), countries[i].size());
+    countryNames[i] = CCInfo::countryName(countryCodes[i]);
+  }
+
+  ArchiveReader pan = in.column(), aid = in.column(), layout = in.column(), count = in.column();
+  ArchiveReader date = in.column(), time = in.column(), amount = in.column(), currency = in.column();
+  ArchiveReader country = in.column(), merchant = in.column(), type = in.column(), atc = in.column();
+  ArchiveReader cid = in.column();
+  if (!in.ok)
+    return false;
+
+  segment.apps.resize(apps);
+  segment.entries.resize(entries);
+  unsigned long long lastDate = 0;
+  size_t next = 0;
+  for (ArchivedApp& a : segment.apps) {
+    size_t digits = std::min<size_t>(pan.byte(), sizeof(a.pan) - 1);
+    for (size_t i = 0; i < digits; i += 2) {
+      byte_t b = pan.byte();
+      a.pan[i] = '0' + (b >> 4);
+      a.pan[i + 1] = '0' + (b & 0x0F);
+    }
+    a.pan[digits] = 0;
+
+    std::string const& aidBytes = aids[aid.index(aids.size())];
+    memset(a.aid, 0, sizeof(a.aid));
+    memcpy(a.aid, aidBytes.data(), std::min(aidBytes.size(), sizeof(a.aid)));
+    a.layout = layout.index(layouts.size());
+    a.firstEntry = next;
+    a.entries = count.varint();
+    if (a.entries > entries - next)
+      return false;
+
+    unsigned lastCounter = 0;
+    for (size_t k = next; k < next + a.entries; ++k) {
+      PaylogEntry& e = segment.entries[k];
+      memset(&e, 0, sizeof(e));
+
+      lastDate += unzigzag(date.varint());
+      valueBytes(lastDate, e.date, sizeof(e.date));
+
+      unsigned long long t = time.varint();
+      if (t & 1)
+	valueBytes(t >> 1, e.time, sizeof(e.time));
+      else {
+	t >>= 1;
+	toBcd(t / 3600, e.time, 1);
+	toBcd(t / 60 % 60, e.time + 1, 1);
+	toBcd(t % 60, e.time + 2, 1);
+      }
+
+      unsigned long long value = amount.varint();
+      if (value & 1)
+	valueBytes(value >> 1, e.amount, sizeof(e.amount));
+      else
+	toBcd(value >> 1, e.amount, sizeof(e.amount));
+      // As CCInfo::decodeLogEntry computes it, even from nibbles that are not digits
+      for (size_t j = 0; j < sizeof(e.amount); ++j)
+	e.amountValue = e.amountValue * 100 + (e.amount[j] >> 4) * 10 + (e.amount[j] & 0x0F);
+
+      unsigned c = currency.index(currencies.size());
+      e.currency = currencyCodes[c];
+      e.currencyName = currencyNames[c];
+      c = country.index(countries.size());
+      e.country = countryCodes[c];
+      e.countryName = countryNames[c];
+
+      std::string const& name = merchants[merchant.index(merchants.size())];
+      e.merchantLength = std::min(name.size(), sizeof(e.merchant) - 1);
+      memcpy(e.merchant, name.data(), e.merchantLength);
+
+      e.type = type.byte();
+      lastCounter += unzigzag(atc.varint());
+      e.counter = lastCounter;
+      e.cryptoInfo = cid.byte();
+    }
+    next += a.entries;
+  }
+
+  return next == entries && pan.ok && aid.ok && layout.ok && count.ok && date.ok && time.ok && amount.ok
+    && currency.ok && country.ok && merchant.ok && type.ok && atc.ok && cid.ok;
+}
+
+// The line before the paylog of each application, in the archive and in the text it is compared to
+static void printArchivedApp(char const* pan, byte_t const* aid, std::ostream& out) {
+  out << "PAN " << pan << " AID ";
+  Tools::printHex(aid, sizeof(((Application*)NULL)->aid), "", out);
+}
+
+int PaylogArchive::build(char const* capturePath, char const* path, unsigned threads) {
+  ApduFile capture;
+  if (capture.open(capturePath))
+    return 1;
+
+  struct Session {
+    byte_t const* data;
+    size_t size;
+  };
+  std::vector<Session> sessions;
+  Session s;
+  while (capture.nextSession(s.data, s.size))
+    sessions.push_back(s);
+  size_t chunks = (sessions.size() + _SEGMENT_SESSIONS - 1) / _SEGMENT_SESSIONS;
+
+  std::string tmp = std::string(path) + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "wb");
+  if (!file) {
+    perror(tmp.c_str());
+    return 1;
+  }
+  bool written = fwrite(_MAGIC, sizeof(_MAGIC), 1, file) == 1;
+
+  // The printPaylog text of each segment is only measured
+  std::vector<unsigned long long> textBytes(chunks);
+  unsigned long long apps = 0, entries = 0, rawBytes = 0, archiveBytes = sizeof(_MAGIC);
+  WorkPool::run(chunks, threads,
+		[&sessions, &textBytes] (size_t chunk, unsigned, ChunkOutput& output) {
+		  static thread_local std::ostringstream text;
+		  static thread_local std::ostringstream log;
+		  std::vector<CCInfo> infos;
+		  ArchiveWriter writer;
+
+		  text.str("");
+		  size_t last = std::min(sessions.size(), (chunk + 1) * _SEGMENT_SESSIONS);
+		  for (size_t i = chunk * _SEGMENT_SESSIONS; i < last; ++i) {
+		    log.str("");
+		    TraceDecoder::replay(sessions[i].data, sessions[i].size, infos, false, log);
+		    for (CCInfo const& info : infos) {
+		      writer.add(info);
+		      printArchivedApp(info.track2().pan, info.application().aid, text);
+		      info.printPaylog(text);
+		    }
+		  }
+		  textBytes[chunk] = text.tellp();
+
+		  std::string raw;
+		  writer.finish(raw);
+		  Header header = {(unsigned)raw.size(), 0, writer.apps, writer.entries};
+		  output.out.assign((char const*)&header, sizeof(header));
+		  BlockCodec::compress((byte_t const*)raw.data(), raw.size(), output.out);
+		  ((Header*)&output.out[0])->packedSize = output.out.size() - sizeof(header);
+		},
+		[&] (size_t, ChunkOutput& output) {
+		  Header const* header = (Header const*)output.out.data();
+		  apps += header->apps;
+		  entries += header->entries;
+		  rawBytes += header->rawSize;
+		  archiveBytes += output.out.size();
+		  written = written && fwrite(output.out.data(), 1, output.out.size(), file) == output.out.size();
+		});
+
+  if (fclose(file) != 0 || !written || rename(tmp.c_str(), path) != 0) {
+    perror(path);
+    return 1;
+  }
+
+  unsigned long long text = 0;
+  for (unsigned long long t : textBytes)
+    text += t;
+  std::cerr << sessions.size() << " session(s), " << apps << " application(s), " << entries << " paylog entries in "
+	    << chunks << " segment(s)" << std::endl
+	    << "printPaylog text " << text << " bytes, columns " << rawBytes << " bytes, archive " << archiveBytes
+	    << " bytes (" << (archiveBytes ? (double)text / archiveBytes : 0) << "x smaller than the text)" << std::endl;
+
+  // Decoding speed of what was just written
+  std::vector<byte_t> data;
+  if (load(path, data))
+    return 1;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  double unpacking = 0;
+  byte_t const* cursor = data.data() + sizeof(_MAGIC);
+  Header header;
+  std::string raw;
+  ArchiveSegment segment;
+  while (cursor < data.data() + data.size()) {
+    std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+    if (!nextSegment(cursor, data.data() + data.size(), header, raw))
+      return 1;
+    unpacking += std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+    if (!decodeSegment((byte_t const*)raw.data(), raw.size(), header.apps, header.entries, segment)) {
+      std::cerr << path << ": corrupted segment" << std::endl;
+      return 1;
+    }
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << "Decoded in " << elapsed << "s: unpacking " << (unpacking > 0 ? rawBytes / unpacking / 1e6 : 0)
+	    << " MB/s of columns, " << (elapsed > 0 ? entries / elapsed / 1e6 : 0) << " M entries/s, "
+	    << (elapsed > 0 ? text / elapsed / 1e6 : 0) << " MB/s of equivalent text" << std::endl;
+  return 0;
+}
+
+int PaylogArchive::load(char const* path, std::vector<byte_t>& data) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return 1;
+  }
+  fseek(file, 0, SEEK_END);
+  data.resize(ftell(file));
+  rewind(file);
+  bool valid = fread(data.data(), 1, data.size(), file) == data.size();
+  fclose(file);
+
+  if (!valid || data.size() < sizeof(_MAGIC) || memcmp(data.data(), _MAGIC, sizeof(_MAGIC))) {
+    std::cerr << path << ": not a paylog archive" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Unpacks the segment at cursor into raw
+bool PaylogArchive::nextSegment(byte_t const*& cursor, byte_t const* end, Header& header, std::string& raw) {
+  if ((size_t)(end - cursor) < sizeof(header)) {
+    std::cerr << "Truncated paylog archive" << std::endl;
+    return false;
+  }
+  memcpy(&header, cursor, sizeof(header));
+  cursor += sizeof(header);
+  raw.resize(header.rawSize);
+  if (header.packedSize > (size_t)(end - cursor)
+      || !BlockCodec::decompress(cursor, header.packedSize, (byte_t*)&raw[0], raw.size())) {
+    std::cerr << "Corrupted paylog archive segment" << std::endl;
+    return false;
+  }
+  cursor += header.packedSize;
+  return true;
+}
+
+int PaylogArchive::print(char const* path, std::ostream& out) {
+  std::vector<byte_t> data;
+  if (load(path, data))
+    return 1;
+
+  byte_t const* cursor = data.data() + sizeof(_MAGIC);
+  Header header;
+  std::string raw;
+  ArchiveSegment segment;
+  while (cursor < data.data() + data.size()) {
+    if (!nextSegment(cursor, data.data() + data.size(), header, raw))
+      return 1;
+    if (!decodeSegment((byte_t const*)raw.data(), raw.size(), header.apps, header.entries, segment)) {
+      std::cerr << path << ": corrupted segment" << std::endl;
+      return 1;
+    }
+    for (ArchivedApp const& a : segment.apps) {
+      printArchivedApp(a.pan, a.aid, out);
+      CCInfo::printPaylogHeader(out);
+      for (size_t i = 0; i < a.entries; ++i)
+	CCInfo::printLogEntry(i, segment.layouts[a.layout], segment.entries[a.firstEntry + i], out);
+    }
+  }
+  return 0;
+}
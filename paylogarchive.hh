@@ -0,0 +1,84 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __PAYLOGARCHIVE_HH__
+# define __PAYLOGARCHIVE_HH__
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "ccinfo.hh"
+
+struct ArchivedApp {
+  byte_t aid[7];
+  char pan[20]; // Digits, NUL terminated
+  unsigned int layout; // Index in the layouts of the segment
+  unsigned int firstEntry;
+  unsigned int entries;
+};
+
+// One decoded segment, the entries of each application contiguous
+struct ArchiveSegment {
+  std::vector<std::vector<LogField> > layouts;
+  std::vector<ArchivedApp> apps;
+  std::vector<PaylogEntry> entries;
+};
+
+/* Compact store of the applications and paylogs of a capture, in segments of _SEGMENT_SESSIONS sessions:
+     "RCCPLA01" | segments, each: raw size (4) | packed size (4) | applications (4) | entries (4) | packed
+   The raw segment holds the dictionaries of the segment (log formats, AIDs, currencies, countries,
+   merchant names) then one column per field, each prefixed with its byte length:
+     PAN (digit count, BCD) | AID | log format | entry count                     per application
+     date | time | amount | currency | country | merchant | type | ATC | CID    per entry
+   Dates are deltas from the previous entry and ATCs from the previous entry of the application, both
+   zigzag varints. Times are seconds of the day and amounts minor units, as varints, with the raw BCD as
+   fallback for values that are not valid BCD. The other fields are indexes in the dictionaries.
+   The raw segment is then packed with BlockCodec. Printing an archive gives back, for each application,
+   a PAN and AID line followed by exactly what CCInfo::printPaylog prints.
+*/
+class PaylogArchive {
+
+public:
+  static int build(char const* capture, char const* path, unsigned threads);
+  static int print(char const* path, std::ostream& out = std::cout);
+
+  static bool decodeSegment(byte_t const* raw, size_t size, unsigned apps, unsigned entries, ArchiveSegment& segment);
+
+private:
+  struct Header {
+    unsigned int rawSize;
+    unsigned int packedSize;
+    unsigned int apps;
+    unsigned int entries;
+  };
+
+  static int load(char const* path, std::vector<byte_t>& data);
+  static bool nextSegment(byte_t const*& cursor, byte_t const* end, Header& header, std::string& raw);
+
+private:
+  static const char _MAGIC[8];
+  static const size_t _SEGMENT_SESSIONS = 1024;
+};
+
+#endif // __PAYLOGARCHIVE_HH__
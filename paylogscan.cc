@@ -0,0 +1,119 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstring>
+#include <algorithm>
+
+#include "paylogscan.hh"
+#include "apdufile.hh"
+
+static bool matches(Exchange const& e, byte_t const* command, size_t size) {
+  return e.szCommand >= size && !memcmp(e.command, command, size);
+}
+
+// SFI of the log entry (9F4D) in the FCI of a SELECT answer, 0 if there is none
+static byte_t logSfi(byte_t const* buff, size_t size) {
+  for (size_t i = 0; i < size; ) {
+    if (buff[i] == 0x00 || buff[i] == 0xFF) { // Padding between objects
+      ++i;
+      continue;
+    }
+
+    unsigned short tag = buff[i++];
+    bool constructed = tag & 0x20;
+    if ((tag & 0x1F) == 0x1F && i < size)
+      tag = tag << 8 | buff[i++];
+    if (i >= size)
+      break;
+    size_t len = buff[i++];
+    if (len == 0x81 && i < size)
+      len = buff[i++];
+    len = std::min(len, size - i);
+
+    byte_t sfi = constructed ? logSfi(buff + i, len) : tag == 0x9F4D && len >= 2 ? buff[i] : 0;
+    if (sfi)
+      return sfi;
+    i += len;
+  }
+  return 0;
+}
+
+static bool succeeded(byte_t const* response, size_t size) {
+  return size >= 2 && response[size - 2] == 0x90 && response[size - 1] == 0x00;
+}
+
+// Returns the number of entries appended
+size_t PaylogScan::scan(byte_t const* session, size_t size, std::vector<PaylogEntry>& entries) {
+  byte_t const* end = session + size;
+  byte_t const* cursor;
+  Exchange e;
+
+  // The layout may come after the records in the session. The entries are the records of the SFIs named
+  // by the log entry of the applications, as CCInfo::extractLogEntries reads them
+  std::vector<LogField> layout;
+  unsigned logSfis = 0; // One bit per SFI
+  for (cursor = session; ApduFile::nextExchange(cursor, end, e); ) {
+    if (!succeeded(e.response, e.szResponse))
+      continue;
+    if (layout.empty() && matches(e, Command::GET_DATA_LOG_FORMAT, sizeof(Command::GET_DATA_LOG_FORMAT) - 1))
+      CCInfo::decodeLogFormat(e.response, e.szResponse, layout);
+    else if (matches(e, Command::SELECT_APP_HEADER, sizeof(Command::SELECT_APP_HEADER))) {
+      byte_t sfi = logSfi(e.response, e.szResponse - 2);
+      if (sfi > 0 && sfi < 32)
+	logSfis |= 1u << sfi;
+    }
+  }
+  if (layout.empty() || logSfis == 0)
+    return 0;
+
+  // Each application of a live read asks for the same records, only the first answer counts
+  unsigned seen[32] = {0}; // One bit per record, per SFI
+  byte_t const* pending = NULL; // READ RECORD answered with 61xx
+  size_t count = 0;
+
+  for (cursor = session; ApduFile::nextExchange(cursor, end, e); ) {
+    byte_t const* command = e.command;
+    if (matches(e, Command::GET_RESPONSE, 4) && pending)
+      command = pending;
+    else if (!matches(e, Command::READ_RECORD, 4) || e.szCommand < 6)
+      continue;
+    pending = NULL;
+
+    if (e.szResponse == 2 && e.response[0] == 0x61) {
+      pending = command;
+      continue;
+    }
+    if (!succeeded(e.response, e.szResponse))
+      continue;
+
+    byte_t record = command[4];
+    byte_t sfi = command[5] >> 3;
+    if (!(logSfis & (1u << sfi)) || record >= 32 || (seen[sfi] & (1u << record)))
+      continue;
+    seen[sfi] |= 1u << record;
+
+    entries.push_back(PaylogEntry());
+    CCInfo::decodeLogEntry(e.response, e.szResponse - 2, layout, entries.back());
+    ++count;
+  }
+  return count;
+}
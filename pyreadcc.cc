@@ -0,0 +1,829 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+/* Python module over the read path: readcc.Reader for the NFC device, readcc.Capture for recorded APDU
+   files and readcc.decode for one recorded session. Each read gives a Card, a sequence of Applications
+   that owns the CCInfo objects of the read. Raw answers, tracks and paylog columns are memoryviews on
+   that storage, the paylog columns strided over the decoded entries: nothing is copied, and a view keeps
+   its card alive.
+   Reads and decoding run without the GIL. ApplicationHelper keeps its exchange state per thread, so
+   captures are decoded in parallel from several Python threads. Each Reader owns its NFC device and a lock
+   over it: Readers on different devices read in parallel, while the calls on one Reader take turns.
+   Only opening a device is serialized, over the libnfc context they share.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "applicationhelper.hh"
+#include "apdufile.hh"
+#include "bintable.hh"
+#include "cardreader.hh"
+#include "ccinfo.hh"
+#include "readerhealth.hh"
+#include "tracedecoder.hh"
+
+thread_local struct nfc_device* pnd;
+
+static BinTable binTable;
+
+/*
+  Column: a read only buffer on memory owned by a card
+*/
+
+struct PyColumn {
+  PyObject_HEAD
+  PyObject* owner;
+  char* data;
+  char const* format;
+  int ndim;
+  Py_ssize_t itemsize;
+  Py_ssize_t shape[2];
+  Py_ssize_t strides[2];
+};
+
+static PyTypeObject ColumnType;
+
+static void columnDealloc(PyColumn* self) {
+  Py_XDECREF(self->owner);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int columnGetBuffer(PyColumn* self, Py_buffer* view, int flags) {
+  bool contiguous = self->strides[self->ndim - 1] == self->itemsize
+    && (self->ndim == 1 || self->strides[0] == self->shape[1] * self->itemsize);
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "card data is read only");
+    return -1;
+  }
+  if (!contiguous && (flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+    PyErr_SetString(PyExc_BufferError, "paylog columns are strided");
+    return -1;
+  }
+
+  view->obj = (PyObject*)self;
+  Py_INCREF(self);
+  view->buf = self->data;
+  view->len = self->itemsize * self->shape[0] * (self->ndim > 1 ? self->shape[1] : 1);
+  view->readonly = 1;
+  view->itemsize = self->itemsize;
+  view->format = (flags & PyBUF_FORMAT) ? (char*)self->format : NULL;
+  view->ndim = self->ndim;
+  view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  return 0;
+}
+
+static PyBufferProcs columnBuffer = {(getbufferproc)columnGetBuffer, NULL};
+
+// A memoryview of count items, stride bytes apart, each of width items of the format
+static PyObject* newView(PyObject* owner, void const* data, char const* format, Py_ssize_t itemsize,
+			 Py_ssize_t count, Py_ssize_t stride, Py_ssize_t width = 0) {
+  PyColumn* column = PyObject_New(PyColumn, &ColumnType);
+  if (column == NULL)
+    return NULL;
+  Py_INCREF(owner);
+  column->owner = owner;
+  column->data = (char*)data;
+  column->format = format;
+  column->itemsize = itemsize;
+  column->ndim = width ? 2 : 1;
+  column->shape[0] = count;
+  column->shape[1] = width;
+  column->strides[0] = stride;
+  column->strides[1] = itemsize;
+
+  PyObject* view = PyMemoryView_FromObject((PyObject*)column);
+  Py_DECREF(column);
+  return view;
+}
+
+static PyObject* bytesView(PyObject* owner, void const* data, size_t size) {
+  return newView(owner, data, "B", 1, size, 1);
+}
+
+/*
+  Card: the applications of one read
+*/
+
+struct PyCard {
+  PyObject_HEAD
+  std::vector<CCInfo>* infos;
+  std::string* log;
+  PyObject* capture; // Keeps the mapped session alive, NULL if none
+  byte_t const* session;
+  Py_ssize_t size;
+  Py_ssize_t offset; // In the capture, -1 if none
+};
+
+struct PyApplication {
+  PyObject_HEAD
+  PyCard* card;
+  CCInfo const* info;
+};
+
+struct PyPaylog {
+  PyObject_HEAD
+  PyCard* card;
+  CCInfo const* info;
+};
+
+static PyTypeObject CardType;
+static PyTypeObject ApplicationType;
+static PyTypeObject PaylogType;
+
+static PyCard* newCard() {
+  PyCard* card = PyObject_New(PyCard, &CardType);
+  if (card == NULL)
+    return NULL;
+  card->infos = new std::vector<CCInfo>();
+  card->log = new std::string();
+  card->capture = NULL;
+  card->session = NULL;
+  card->size = 0;
+  card->offset = -1;
+  return card;
+}
+
+static void cardDealloc(PyCard* self) {
+  delete self->infos;
+  delete self->log;
+  Py_XDECREF(self->capture);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static Py_ssize_t cardLength(PyCard* self) {
+  return self->infos->size();
+}
+
+static PyObject* cardItem(PyCard* self, Py_ssize_t index) {
+  if (index < 0 || (size_t)index >= self->infos->size()) {
+    PyErr_SetString(PyExc_IndexError, "application index out of range");
+    return NULL;
+  }
+  PyApplication* app = PyObject_New(PyApplication, &ApplicationType);
+  if (app == NULL)
+    return NULL;
+  Py_INCREF(self);
+  app->card = self;
+  app->info = &(*self->infos)[index];
+  return (PyObject*)app;
+}
+
+static PyObject* cardStr(PyCard* self) {
+  std::ostringstream out;
+  CardReader::print(*self->infos, out);
+  std::string text = out.str();
+  return PyUnicode_DecodeLatin1(text.data(), text.size(), NULL);
+}
+
+static PyObject* cardLog(PyCard* self, void*) {
+  return PyUnicode_DecodeLatin1(self->log->data(), self->log->size(), NULL);
+}
+
+static PyObject* cardSession(PyCard* self, void*) {
+  if (self->capture == NULL)
+    Py_RETURN_NONE;
+  return bytesView((PyObject*)self, self->session, self->size);
+}
+
+static PyObject* cardOffset(PyCard* self, void*) {
+  if (self->offset < 0)
+    Py_RETURN_NONE;
+  return PyLong_FromSsize_t(self->offset);
+}
+
+static PySequenceMethods cardSequence;
+
+static PyGetSetDef cardGetSet[] = {
+  {(char*)"log", (getter)cardLog, NULL, (char*)"Messages of the read", NULL},
+  {(char*)"session", (getter)cardSession, NULL, (char*)"Recorded exchanges of the card, None for live reads", NULL},
+  {(char*)"offset", (getter)cardOffset, NULL, (char*)"Offset of the session in its capture", NULL},
+  {NULL, NULL, NULL, NULL, NULL}
+};
+
+/*
+  Application: one CCInfo of a card
+*/
+
+static void applicationDealloc(PyApplication* self) {
+  Py_DECREF(self->card);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* text(char const* value) {
+  return PyUnicode_DecodeLatin1(value, strlen(value), NULL);
+}
+
+static PyObject* appAid(PyApplication* self, void*) {
+  return PyBytes_FromStringAndSize((char const*)self->info->application().aid, sizeof(self->info->application().aid));
+}
+
+static PyObject* appName(PyApplication* self, void*) {
+  return text(self->info->application().name);
+}
+
+static PyObject* appPriority(PyApplication* self, void*) {
+  return PyLong_FromLong(self->info->application().priority);
+}
+
+static PyObject* appLanguage(PyApplication* self, void*) {
+  return text(self->info->languagePreference());
+}
+
+static PyObject* appCardholder(PyApplication* self, void*) {
+  return text(self->info->cardholderName());
+}
+
+static PyObject* appPan(PyApplication* self, void*) {
+  return text(self->info->track2().pan);
+}
+
+static PyObject* appExpiry(PyApplication* self, void*) {
+  Track2 const& t = self->info->track2();
+  char expiry[16];
+  snprintf(expiry, sizeof(expiry), "20%02x-%02x", t.expiryYear, t.expiryMonth);
+  return PyUnicode_FromString(expiry);
+}
+
+static PyObject* appServiceCode(PyApplication* self, void*) {
+  return text(self->info->track2().serviceCode);
+}
+
+static PyObject* appTrack1(PyApplication* self, void*) {
+  size_t size;
+  byte_t const* data = self->info->track1Data(size);
+  return bytesView((PyObject*)self->card, data, size);
+}
+
+static PyObject* appTrack2(PyApplication* self, void*) {
+  size_t size;
+  byte_t const* data = self->info->track2Data(size);
+  return bytesView((PyObject*)self->card, data, size);
+}
+
+static PyObject* appLogCount(PyApplication* self, void*) {
+  return PyLong_FromLong(self->info->logCount());
+}
+
+static PyObject* appIssuer(PyApplication* self, void*) {
+  BinInfo const& bin = self->info->issuer();
+  if (bin.issuer == NULL)
+    Py_RETURN_NONE;
+  char code[8];
+  char const* country = CCInfo::countryName(bin.country);
+  if (country == NULL) {
+    snprintf(code, sizeof(code), "%03x", bin.country);
+    country = code;
+  }
+  return Py_BuildValue("(NNNN)", text(bin.issuer), text(bin.brand), text(bin.type), text(country));
+}
+
+static PyObject* appSelectResponse(PyApplication* self, void*) {
+  APDU const& response = self->info->selectResponse();
+  return bytesView((PyObject*)self->card, response.data, response.size);
+}
+
+static PyObject* appRecords(PyApplication* self, void*) {
+  std::vector<RawRecord> const& records = self->info->records();
+  PyObject* list = PyList_New(records.size());
+  if (list == NULL)
+    return NULL;
+  for (size_t i = 0; i < records.size(); ++i) {
+    RawRecord const& r = records[i];
+    PyObject* item = Py_BuildValue("(iiN)", r.sfi, r.record,
+				   bytesView((PyObject*)self->card, r.response.data, r.response.size));
+    if (item == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, item);
+  }
+  return list;
+}
+
+static PyObject* appLogEntries(PyApplication* self, void*) {
+  size_t count = self->info->logEntryCount();
+  PyObject* list = PyList_New(count);
+  if (list == NULL)
+    return NULL;
+  for (size_t i = 0; i < count; ++i) {
+    APDU const& entry = self->info->rawLogEntry(i);
+    PyObject* view = bytesView((PyObject*)self->card, entry.data, entry.size);
+    if (view == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, view);
+  }
+  return list;
+}
+
+static PyObject* appPaylog(PyApplication* self, void*) {
+  PyPaylog* paylog = PyObject_New(PyPaylog, &PaylogType);
+  if (paylog == NULL)
+    return NULL;
+  Py_INCREF(self->card);
+  paylog->card = self->card;
+  paylog->info = self->info;
+
+  // The columns are views on the decoded entries, every entry is decoded now
+  for (size_t i = 0; i < self->info->logEntryCount(); ++i)
+    self->info->logEntry(i);
+  return (PyObject*)paylog;
+}
+
+static PyObject* appStr(PyApplication* self) {
+  std::ostringstream out;
+  self->info->printAll(out);
+  std::string text = out.str();
+  return PyUnicode_DecodeLatin1(text.data(), text.size(), NULL);
+}
+
+static PyGetSetDef applicationGetSet[] = {
+  {(char*)"aid", (getter)appAid, NULL, (char*)"Application identifier, 7 bytes", NULL},
+  {(char*)"name", (getter)appName, NULL, (char*)"Application label", NULL},
+  {(char*)"priority", (getter)appPriority, NULL, NULL, NULL},
+  {(char*)"language", (getter)appLanguage, NULL, (char*)"Language preference", NULL},
+  {(char*)"cardholder", (getter)appCardholder, NULL, NULL, NULL},
+  {(char*)"pan", (getter)appPan, NULL, NULL, NULL},
+  {(char*)"expiry", (getter)appExpiry, NULL, (char*)"YYYY-MM", NULL},
+  {(char*)"service_code", (getter)appServiceCode, NULL, NULL, NULL},
+  {(char*)"track1", (getter)appTrack1, NULL, (char*)"Track 1 discretionary data, as on the card", NULL},
+  {(char*)"track2", (getter)appTrack2, NULL, (char*)"Track 2 equivalent data, as on the card", NULL},
+  {(char*)"log_count", (getter)appLogCount, NULL, (char*)"Paylog size announced by the card", NULL},
+  {(char*)"issuer", (getter)appIssuer, NULL, (char*)"(issuer, brand, type, country) from load_bin_table, or None", NULL},
+  {(char*)"select_response", (getter)appSelectResponse, NULL, (char*)"Answer to SELECT APP", NULL},
+  {(char*)"records", (getter)appRecords, NULL, (char*)"(sfi, record, answer) of every READ RECORD", NULL},
+  {(char*)"log_entries", (getter)appLogEntries, NULL, (char*)"Raw answer of each paylog entry", NULL},
+  {(char*)"paylog", (getter)appPaylog, NULL, (char*)"Decoded paylog, by column", NULL},
+  {NULL, NULL, NULL, NULL, NULL}
+};
+
+/*
+  Paylog: the decoded entries of an application, one view per field
+*/
+
+static void paylogDealloc(PyPaylog* self) {
+  Py_DECREF(self->card);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static Py_ssize_t paylogLength(PyPaylog* self) {
+  return self->info->logEntryCount();
+}
+
+static PyObject* paylogColumn(PyPaylog* self, size_t offset, char const* format, Py_ssize_t itemsize,
+			      Py_ssize_t width = 0) {
+  char const* first = (char const*)&self->info->logEntry(0);
+  return newView((PyObject*)self->card, first + offset, format, itemsize, self->info->logEntryCount(),
+		 sizeof(PaylogEntry), width);
+}
+
+static PyObject* paylogDate(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, date), "B", 1, 3);
+}
+
+static PyObject* paylogTime(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, time), "B", 1, 3);
+}
+
+static PyObject* paylogAmount(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, amountValue), "Q", sizeof(unsigned long long));
+}
+
+static PyObject* paylogCurrency(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, currency), "H", sizeof(unsigned short));
+}
+
+static PyObject* paylogCountry(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, country), "H", sizeof(unsigned short));
+}
+
+static PyObject* paylogType(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, type), "B", 1);
+}
+
+static PyObject* paylogCounter(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, counter), "H", sizeof(unsigned short));
+}
+
+static PyObject* paylogCid(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, cryptoInfo), "B", 1);
+}
+
+static PyObject* paylogMerchantLength(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, merchantLength), "B", 1);
+}
+
+static PyObject* paylogMerchant(PyPaylog* self, void*) {
+  return paylogColumn(self, offsetof(PaylogEntry, merchant), "B", 1, sizeof(((PaylogEntry*)0)->merchant));
+}
+
+static PyObject* paylogFields(PyPaylog* self, void*) {
+  std::vector<LogField> const& layout = self->info->logLayout();
+  PyObject* tags = PyTuple_New(layout.size());
+  if (tags == NULL)
+    return NULL;
+  for (size_t i = 0; i < layout.size(); ++i)
+    PyTuple_SET_ITEM(tags, i, PyLong_FromLong(layout[i].tag));
+  return tags;
+}
+
+// Copies, for plain Python; numpy.asarray(paylog.merchant) does not
+static PyObject* paylogMerchants(PyPaylog* self, PyObject*) {
+  size_t count = self->info->logEntryCount();
+  PyObject* list = PyList_New(count);
+  if (list == NULL)
+    return NULL;
+  for (size_t i = 0; i < count; ++i) {
+    PaylogEntry const& e = self->info->logEntry(i);
+    PyObject* name = PyUnicode_DecodeLatin1(e.merchant, e.merchantLength, NULL);
+    if (name == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, name);
+  }
+  return list;
+}
+
+static PySequenceMethods paylogSequence;
+
+static PyMethodDef paylogMethods[] = {
+  {"merchants", (PyCFunction)paylogMerchants, METH_NOARGS, "Merchant names of the entries, as text"},
+  {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef paylogGetSet[] = {
+  {(char*)"date", (getter)paylogDate, NULL, (char*)"BCD YY MM DD, one row per entry", NULL},
+  {(char*)"time", (getter)paylogTime, NULL, (char*)"BCD HH MM SS", NULL},
+  {(char*)"amount", (getter)paylogAmount, NULL, (char*)"Minor units", NULL},
+  {(char*)"currency", (getter)paylogCurrency, NULL, (char*)"ISO 4217 code as stored (0x978 = EUR)", NULL},
+  {(char*)"country", (getter)paylogCountry, NULL, (char*)"ISO 3166 code as stored (0x250 = FRA)", NULL},
+  {(char*)"type", (getter)paylogType, NULL, (char*)"0 = payment", NULL},
+  {(char*)"counter", (getter)paylogCounter, NULL, (char*)"ATC", NULL},
+  {(char*)"cid", (getter)paylogCid, NULL, (char*)"Cryptogram information data", NULL},
+  {(char*)"merchant", (getter)paylogMerchant, NULL, (char*)"Merchant name bytes, merchant_length of them used", NULL},
+  {(char*)"merchant_length", (getter)paylogMerchantLength, NULL, NULL, NULL},
+  {(char*)"fields", (getter)paylogFields, NULL, (char*)"Tags of the log format, absent fields are 0", NULL},
+  {NULL, NULL, NULL, NULL, NULL}
+};
+
+/*
+  Capture: the sessions of a recorded APDU file
+*/
+
+struct PyCapture {
+  PyObject_HEAD
+  ApduFile* file;
+  std::mutex* lock; // Over the position in the file
+  bool opened; // Cards point into the mapping, it is never replaced
+};
+
+static PyTypeObject CaptureType;
+
+static int captureInit(PyCapture* self, PyObject* args, PyObject*) {
+  char const* path;
+  if (!PyArg_ParseTuple(args, "s", &path))
+    return -1;
+  if (self->opened) {
+    PyErr_SetString(PyExc_RuntimeError, "Capture already open");
+    return -1;
+  }
+  if (self->file->open(path)) {
+    PyErr_Format(PyExc_OSError, "%s: cannot open the APDU file", path);
+    return -1;
+  }
+  self->opened = true;
+  return 0;
+}
+
+static PyObject* captureNew(PyTypeObject* type, PyObject*, PyObject*) {
+  PyCapture* self = (PyCapture*)type->tp_alloc(type, 0);
+  if (self == NULL)
+    return NULL;
+  self->file = new ApduFile();
+  self->lock = new std::mutex();
+  return (PyObject*)self;
+}
+
+static void captureDealloc(PyCapture* self) {
+  delete self->file;
+  delete self->lock;
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+// Replays a session into card, without the GIL
+static void decodeSession(PyCard* card, byte_t const* session, size_t size) {
+  static thread_local std::ostringstream log;
+  log.str("");
+  TraceDecoder::replay(session, size, *card->infos, false, log);
+  *card->log = log.str();
+}
+
+static PyObject* captureRead(PyCapture* self, PyObject*) {
+  PyCard* card = newCard();
+  if (card == NULL)
+    return NULL;
+
+  byte_t const* session;
+  size_t size, offset;
+  bool found;
+  Py_BEGIN_ALLOW_THREADS
+  {
+    std::lock_guard<std::mutex> guard(*self->lock);
+    offset = self->file->tell();
+    found = self->file->nextSession(session, size);
+  }
+  if (found)
+    decodeSession(card, session, size);
+  Py_END_ALLOW_THREADS
+
+  if (!found) {
+    Py_DECREF(card);
+    Py_RETURN_NONE;
+  }
+  Py_INCREF(self);
+  card->capture = (PyObject*)self;
+  card->session = session;
+  card->size = size;
+  card->offset = offset;
+  return (PyObject*)card;
+}
+
+static PyObject* captureNext(PyCapture* self) {
+  PyObject* card = captureRead(self, NULL);
+  if (card == Py_None) {
+    Py_DECREF(card);
+    return NULL; // StopIteration
+  }
+  return card;
+}
+
+static PyObject* captureRewind(PyCapture* self, PyObject*) {
+  std::lock_guard<std::mutex> guard(*self->lock);
+  self->file->rewind();
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef captureMethods[] = {
+  {"read", (PyCFunction)captureRead, METH_NOARGS, "Decode the next session, None at the end of the file"},
+  {"rewind", (PyCFunction)captureRewind, METH_NOARGS, "Go back to the first session"},
+  {NULL, NULL, 0, NULL}
+};
+
+/*
+  Reader: cards put on the NFC device
+*/
+
+struct PyReader {
+  PyObject_HEAD
+  int dump;
+  int timeout; // ms, applied to the thread of each read
+  int retries;
+  ReaderDevice* device;
+  std::mutex* lock; // Held by the thread using the device
+};
+
+static PyTypeObject ReaderType;
+
+static int readerInit(PyReader* self, PyObject* args, PyObject* kwargs) {
+  static char const* keywords[] = {"connstring", "timeout", "retries", "dump", NULL};
+  char const* connstring = NULL;
+  self->timeout = 0;
+  self->retries = 0;
+  self->dump = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ziip", (char**)keywords, &connstring, &self->timeout,
+				   &self->retries, &self->dump))
+    return -1;
+
+  int failed;
+  Py_BEGIN_ALLOW_THREADS
+  std::lock_guard<std::mutex> guard(*self->lock);
+  ReaderHealth::use(self->device);
+  ReaderHealth::close();
+  self->device->connstring = connstring ? connstring : "";
+  failed = ReaderHealth::open();
+  ReaderHealth::use(NULL);
+  Py_END_ALLOW_THREADS
+  if (failed) {
+    PyErr_Format(PyExc_OSError, "Unable to open NFC device %s", connstring ? connstring : "");
+    return -1;
+  }
+  return 0;
+}
+
+static PyObject* readerNew(PyTypeObject* type, PyObject*, PyObject*) {
+  PyReader* self = (PyReader*)type->tp_alloc(type, 0);
+  if (self == NULL)
+    return NULL;
+  self->device = new ReaderDevice();
+  self->lock = new std::mutex();
+  return (PyObject*)self;
+}
+
+static void readerDealloc(PyReader* self) {
+  ReaderHealth::use(self->device);
+  ReaderHealth::close();
+  ReaderHealth::use(NULL);
+  delete self->device;
+  delete self->lock;
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* readerRead(PyReader* self, PyObject*) {
+  PyCard* card = newCard();
+  if (card == NULL)
+    return NULL;
+
+  bool closed = false;
+  Py_BEGIN_ALLOW_THREADS
+  std::lock_guard<std::mutex> guard(*self->lock);
+  ReaderHealth::use(self->device);
+  ApplicationHelper::setTransceiver(NULL);
+  ApplicationHelper::setPolicy(self->timeout, self->retries);
+  // Polls again until a card answers, the read only starts then
+  while (pnd) {
+    ApplicationHelper::executeCommand(Command::START_14443A, sizeof(Command::START_14443A), "START 14443A");
+    if (ApplicationHelper::targetFound())
+      break;
+    if (ReaderHealth::failing())
+      ReaderHealth::recover();
+  }
+  if (pnd) {
+    std::ostringstream log;
+    CardReader::read(*card->infos, self->dump, log);
+    *card->log = log.str();
+  }
+  else
+    closed = true;
+  ReaderHealth::use(NULL);
+  Py_END_ALLOW_THREADS
+
+  if (closed) {
+    Py_DECREF(card);
+    PyErr_SetString(PyExc_OSError, "NFC device closed");
+    return NULL;
+  }
+  return (PyObject*)card;
+}
+
+static PyObject* readerClose(PyReader* self, PyObject*) {
+  Py_BEGIN_ALLOW_THREADS
+  std::lock_guard<std::mutex> guard(*self->lock);
+  ReaderHealth::use(self->device);
+  ReaderHealth::close();
+  ReaderHealth::use(NULL);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+static PyObject* readerMetrics(PyReader* self, PyObject*) {
+  ReaderMetrics m;
+  bool up;
+  Py_BEGIN_ALLOW_THREADS
+  std::lock_guard<std::mutex> guard(*self->lock);
+  m = self->device->metrics;
+  up = self->device->device != NULL;
+  Py_END_ALLOW_THREADS
+  return Py_BuildValue("{s:K,s:K,s:K,s:K,s:d,s:d,s:d,s:O}", "exchanges", m.exchanges, "failures", m.failures,
+		       "open_attempts", m.openAttempts, "recoveries", m.recoveries, "last_recovery",
+		       m.lastRecovery, "max_recovery", m.maxRecovery, "total_recovery", m.totalRecovery, "up",
+		       up ? Py_True : Py_False);
+}
+
+static PyMethodDef readerMethods[] = {
+  {"read", (PyCFunction)readerRead, METH_NOARGS, "Wait for a card and read it"},
+  {"close", (PyCFunction)readerClose, METH_NOARGS, "Close the NFC device of this Reader"},
+  {"metrics", (PyCFunction)readerMetrics, METH_NOARGS, "Exchanges, failures and recoveries of the device, after the read in progress"},
+  {NULL, NULL, 0, NULL}
+};
+
+/*
+  Module
+*/
+
+static PyObject* moduleDecode(PyObject*, PyObject* args) {
+  Py_buffer session;
+  if (!PyArg_ParseTuple(args, "y*", &session))
+    return NULL;
+  PyCard* card = newCard();
+  if (card != NULL) {
+    Py_BEGIN_ALLOW_THREADS
+    decodeSession(card, (byte_t const*)session.buf, session.len);
+    Py_END_ALLOW_THREADS
+  }
+  PyBuffer_Release(&session);
+  return (PyObject*)card;
+}
+
+static PyObject* moduleLoadBinTable(PyObject*, PyObject* args) {
+  char const* path;
+  if (!PyArg_ParseTuple(args, "s", &path))
+    return NULL;
+  if (binTable.size() > 0) {
+    PyErr_SetString(PyExc_RuntimeError, "a BIN table is already loaded");
+    return NULL;
+  }
+  if (binTable.open(path)) {
+    PyErr_Format(PyExc_OSError, "%s: cannot load the BIN table", path);
+    return NULL;
+  }
+  CCInfo::setBinTable(&binTable);
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef moduleMethods[] = {
+  {"decode", moduleDecode, METH_VARARGS, "Decode one recorded session (bytes-like, as in a capture) into a Card"},
+  {"load_bin_table", moduleLoadBinTable, METH_VARARGS, "Look the issuer of every PAN up in a --bin-table file"},
+  {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef module = {
+  PyModuleDef_HEAD_INIT, "readcc", "Contactless payment card reader", -1, moduleMethods, NULL, NULL, NULL, NULL
+};
+
+static int ready(PyTypeObject& type, char const* name, Py_ssize_t size, destructor dealloc, char const* doc) {
+  type.tp_name = name;
+  type.tp_basicsize = size;
+  type.tp_dealloc = dealloc;
+  type.tp_flags = Py_TPFLAGS_DEFAULT;
+  type.tp_doc = doc;
+  Py_INCREF(&type); // Static, never freed
+  return PyType_Ready(&type);
+}
+
+PyMODINIT_FUNC PyInit_readcc() {
+  ColumnType.tp_as_buffer = &columnBuffer;
+  cardSequence.sq_length = (lenfunc)cardLength;
+  cardSequence.sq_item = (ssizeargfunc)cardItem;
+  CardType.tp_as_sequence = &cardSequence;
+  CardType.tp_getset = cardGetSet;
+  CardType.tp_str = (reprfunc)cardStr;
+  ApplicationType.tp_getset = applicationGetSet;
+  ApplicationType.tp_str = (reprfunc)appStr;
+  paylogSequence.sq_length = (lenfunc)paylogLength;
+  PaylogType.tp_as_sequence = &paylogSequence;
+  PaylogType.tp_getset = paylogGetSet;
+  PaylogType.tp_methods = paylogMethods;
+  CaptureType.tp_new = captureNew;
+  CaptureType.tp_init = (initproc)captureInit;
+  CaptureType.tp_methods = captureMethods;
+  CaptureType.tp_iter = PyObject_SelfIter;
+  CaptureType.tp_iternext = (iternextfunc)captureNext;
+  ReaderType.tp_new = readerNew;
+  ReaderType.tp_init = (initproc)readerInit;
+  ReaderType.tp_methods = readerMethods;
+
+  if (ready(ColumnType, "readcc.Column", sizeof(PyColumn), (destructor)columnDealloc, "Card memory")
+      || ready(CardType, "readcc.Card", sizeof(PyCard), (destructor)cardDealloc, "Applications of one read")
+      || ready(ApplicationType, "readcc.Application", sizeof(PyApplication), (destructor)applicationDealloc,
+	       "One application of a card")
+      || ready(PaylogType, "readcc.Paylog", sizeof(PyPaylog), (destructor)paylogDealloc,
+	       "Paylog columns, as memoryviews")
+      || ready(CaptureType, "readcc.Capture", sizeof(PyCapture), (destructor)captureDealloc,
+	       "Capture(path): the sessions of a recorded APDU file, decoded by read() or iteration")
+      || ready(ReaderType, "readcc.Reader", sizeof(PyReader), (destructor)readerDealloc,
+	       "Reader(connstring=None, timeout=0, retries=0, dump=False): cards put on an NFC device"))
+    return NULL;
+
+  PyObject* m = PyModule_Create(&module);
+  if (m == NULL)
+    return NULL;
+  PyModule_AddObject(m, "Card", (PyObject*)&CardType);
+  PyModule_AddObject(m, "Application", (PyObject*)&ApplicationType);
+  PyModule_AddObject(m, "Paylog", (PyObject*)&PaylogType);
+  PyModule_AddObject(m, "Capture", (PyObject*)&CaptureType);
+  PyModule_AddObject(m, "Reader", (PyObject*)&ReaderType);
+  return m;
+}
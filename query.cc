@@ -0,0 +1,566 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+#include "query.hh"
+#include "apdufile.hh"
+#include "tracedecoder.hh"
+#include "textimport.hh"
+#include "merchantindex.hh"
+#include "workpool.hh"
+
+const char Query::_MAGIC[8] = {'R', 'C', 'C', 'Q', 'B', 'L', 'K', '1'};
+
+struct QueryHeader {
+  char magic[8];
+  unsigned long long indexed; // Capture offset covered by the blocks
+  unsigned int blocks;
+  unsigned int blockSessions;
+};
+
+struct QuerySession {
+  byte_t const* data;
+  size_t size;
+  size_t capture;
+  unsigned long long offset;
+};
+
+// Sessions decoded together, a block or part of the unindexed tail
+struct QueryChunk {
+  size_t first;
+  size_t last;
+};
+
+static unsigned bcd(byte_t b) {
+  return (b >> 4) * 10 + (b & 0x0F);
+}
+
+static unsigned expiryOf(Track2 const& t) {
+  return bcd(t.expiryYear) * 100 + bcd(t.expiryMonth);
+}
+
+static unsigned dateOf(PaylogEntry const& e) {
+  return bcd(e.date[0]) * 10000 + bcd(e.date[1]) * 100 + bcd(e.date[2]);
+}
+
+static std::string aidOf(Application const& application) {
+  static char const digits[] = "0123456789ABCDEF";
+  std::string hex;
+  for (byte_t b : application.aid) {
+    hex += digits[b >> 4];
+    hex += digits[b & 0x0F];
+  }
+  return hex;
+}
+
+static size_t bitOf(void const* data, size_t size, size_t bits) {
+  return Tools::hash(data, size) % bits;
+}
+
+static void setBit(unsigned long long* bitmap, size_t bit) {
+  bitmap[bit / 64] |= 1ull << (bit % 64);
+}
+
+static bool testBit(unsigned long long const* bitmap, size_t bit) {
+  return bitmap[bit / 64] >> (bit % 64) & 1;
+}
+
+// The RID identifies the scheme, shorter AID prefixes cannot be checked against a block
+static const size_t RID_DIGITS = 10;
+static const size_t MERCHANT_PREFIX = 3;
+
+Query::Query()
+  : _entryTerms(false)
+{
+  _expiry = {0, ~0ull};
+  _amount = {0, ~0ull};
+  _date = {0, ~0ull};
+}
+
+// Spaces separate terms, except between single quotes
+static std::vector<std::string> splitTerms(char const* text) {
+  std::vector<std::string> terms;
+  std::string term;
+  bool quoted = false;
+  for (char const* c = text; ; ++c) {
+    if (*c == '\'')
+      quoted = !quoted;
+    else if (*c && (quoted || !isspace((unsigned char)*c)))
+      term += *c;
+    else if (!term.empty()) {
+      terms.push_back(term);
+      term.clear();
+    }
+    if (!*c)
+      break;
+  }
+  return terms;
+}
+
+static std::vector<std::string> splitValues(std::string const& text) {
+  std::vector<std::string> values;
+  size_t begin = 0;
+  for (size_t comma; (comma = text.find(',', begin)) != std::string::npos; begin = comma + 1)
+    values.push_back(text.substr(begin, comma - begin));
+  values.push_back(text.substr(begin));
+  return values;
+}
+
+// Names as printed by CCInfo or numeric codes as stored (250 = FRA)
+static bool parseCodes(std::string const& text, unsigned short (*byName)(char const*, size_t),
+		       std::vector<unsigned short>& codes) {
+  for (std::string const& value : splitValues(text)) {
+    unsigned short code = 0;
+    if (!value.empty() && value.find_first_not_of("0123456789") == std::string::npos)
+      code = strtoul(value.c_str(), NULL, 16);
+    else
+      code = byName(value.c_str(), value.size());
+    if (code == 0)
+      return false;
+    codes.push_back(code);
+  }
+  return true;
+}
+
+int Query::parse(char const* text) {
+  std::vector<std::string> seen;
+
+  for (std::string const& term : splitTerms(text)) {
+    size_t equal = term.find('=');
+    std::string field = term.substr(0, equal);
+    std::string value = equal == std::string::npos ? "" : term.substr(equal + 1);
+    bool valid = true;
+    if (equal == std::string::npos || std::find(seen.begin(), seen.end(), field) != seen.end()) {
+      std::cerr << "Invalid query term: " << term << std::endl;
+      return 1;
+    }
+    seen.push_back(field);
+
+    if (field == "aid") {
+      for (std::string aid : splitValues(value)) {
+	std::transform(aid.begin(), aid.end(), aid.begin(), ::toupper);
+	valid = valid && !aid.empty() && aid.find_first_not_of("0123456789ABCDEF") == std::string::npos;
+	_aids.push_back(aid);
+      }
+    }
+    else if (field == "expiry")
+      valid = parseRange(value, _expiry, parseMonth);
+    else if (field == "country")
+      valid = parseCodes(value, CCInfo::countryCode, _countries);
+    else if (field == "currency")
+      valid = parseCodes(value, CCInfo::currencyCode, _currencies);
+    else if (field == "amount")
+      valid = parseRange(value, _amount, parseAmount);
+    else if (field == "date")
+      valid = parseRange(value, _date, parseDate);
+    else if (field == "merchant") {
+      for (std::string const& name : splitValues(value)) {
+	bool prefix = !name.empty() && name[name.size() - 1] == '*';
+	_merchants.push_back(MerchantIndex::normalize(name.data(), name.size() - prefix));
+	_merchantPrefixes.push_back(prefix);
+      }
+    }
+    else
+      valid = false;
+
+    if (!valid) {
+      std::cerr << "Invalid query term: " << term << std::endl;
+      return 1;
+    }
+  }
+
+  _entryTerms = !_countries.empty() || !_currencies.empty() || !_merchants.empty()
+    || _amount.min > 0 || _amount.max < ~0ull || _date.min > 0 || _date.max < ~0ull;
+  return 0;
+}
+
+// A single value, or bounds separated by .. where either bound may be left out
+bool Query::parseRange(std::string const& text, Range& range,
+		       bool (*parseValue)(std::string const&, unsigned long long&)) {
+  size_t dots = text.find("..");
+  if (dots == std::string::npos) {
+    if (!parseValue(text, range.min))
+      return false;
+    range.max = range.min;
+    return true;
+  }
+
+  std::string min = text.substr(0, dots);
+  std::string max = text.substr(dots + 2);
+  range.min = 0;
+  range.max = ~0ull;
+  return (min.empty() || parseValue(min, range.min)) && (max.empty() || parseValue(max, range.max))
+    && range.min <= range.max;
+}
+
+// Major units with up to 2 decimals, to minor units
+bool Query::parseAmount(std::string const& text, unsigned long long& value) {
+  unsigned long long units = 0, cents = 0;
+  int read = 0, decimals = 0;
+  if (sscanf(text.c_str(), "%llu%n", &units, &read) != 1)
+    return false;
+  if (text[read] == '.') {
+    char const* c = text.c_str() + read + 1;
+    for (; isdigit((unsigned char)*c) && decimals < 2; ++c, ++decimals)
+      cents = cents * 10 + (*c - '0');
+    read = c - text.c_str();
+  }
+  for (; decimals < 2; ++decimals)
+    cents *= 10;
+  value = units * 100 + cents;
+  return text[read] == 0;
+}
+
+// YYYY-MM-DD to YYMMDD
+bool Query::parseDate(std::string const& text, unsigned long long& value) {
+  int year, month, day, read = 0;
+  if (sscanf(text.c_str(), "%d-%d-%d%n", &year, &month, &day, &read) != 3 || text[read] != 0
+      || year < 2000 || year >= 2100 || month < 1 || month > 12 || day < 1 || day > 31)
+    return false;
+  value = (year - 2000) * 10000 + month * 100 + day;
+  return true;
+}
+
+// YYYY-MM to YYMM
+bool Query::parseMonth(std::string const& text, unsigned long long& value) {
+  int year, month, read = 0;
+  if (sscanf(text.c_str(), "%d-%d%n", &year, &month, &read) != 2 || text[read] != 0
+      || year < 2000 || year >= 2100 || month < 1 || month > 12)
+    return false;
+  value = (year - 2000) * 100 + month;
+  return true;
+}
+
+bool Query::skip(QueryBlock const& block) const {
+  if (block.expiryMin > _expiry.max || block.expiryMax < _expiry.min)
+    return true;
+
+  if (!_aids.empty()) {
+    bool possible = false;
+    for (std::string const& aid : _aids)
+      possible = possible || aid.size() < RID_DIGITS
+	|| testBit(&block.aids, bitOf(aid.data(), RID_DIGITS, 64));
+    if (!possible)
+      return true;
+  }
+
+  if (!_entryTerms)
+    return false;
+
+  if (block.entries == 0
+      || block.dateMin > _date.max || block.dateMax < _date.min
+      || block.amountMin > _amount.max || block.amountMax < _amount.min)
+    return true;
+
+  bool possible = _currencies.empty();
+  for (unsigned short code : _currencies)
+    possible = possible || testBit(&block.currencies, bitOf(&code, sizeof(code), 64));
+  if (!possible)
+    return true;
+
+  possible = _countries.empty();
+  for (unsigned short code : _countries)
+    possible = possible || testBit(&block.countries, bitOf(&code, sizeof(code), 64));
+  if (!possible)
+    return true;
+
+  possible = _merchants.empty();
+  for (std::string const& name : _merchants)
+    possible = possible || name.empty()
+      || testBit(block.merchants, bitOf(name.data(), std::min(name.size(), MERCHANT_PREFIX), 256));
+  return !possible;
+}
+
+bool Query::matches(CCInfo const& info) const {
+  if (!_aids.empty()) {
+    std::string aid = aidOf(info.application());
+    bool found = false;
+    for (std::string const& prefix : _aids)
+      found = found || !aid.compare(0, prefix.size(), prefix);
+    if (!found)
+      return false;
+  }
+
+  unsigned expiry = expiryOf(info.track2());
+  if (expiry < _expiry.min || expiry > _expiry.max)
+    return false;
+
+  if (!_entryTerms)
+    return true;
+  for (size_t i = 0; i < info.logEntryCount(); ++i)
+    if (matches(info.logEntry(i)))
+      return true;
+  return false;
+}
+
+bool Query::matches(PaylogEntry const& entry) const {
+  if (!_currencies.empty() && std::find(_currencies.begin(), _currencies.end(), entry.currency) == _currencies.end())
+    return false;
+  if (!_countries.empty() && std::find(_countries.begin(), _countries.end(), entry.country) == _countries.end())
+    return false;
+  if (entry.amountValue < _amount.min || entry.amountValue > _amount.max)
+    return false;
+
+  unsigned date = dateOf(entry);
+  if (date < _date.min || date > _date.max)
+    return false;
+
+  if (_merchants.empty())
+    return true;
+  std::string name = MerchantIndex::normalize(entry.merchant, entry.merchantLength);
+  for (size_t i = 0; i < _merchants.size(); ++i)
+    if (_merchantPrefixes[i] ? !name.compare(0, _merchants[i].size(), _merchants[i]) : name == _merchants[i])
+      return true;
+  return false;
+}
+
+// The application and the matching entries, with the labels of CCInfo::printAll
+void Query::print(CCInfo const& info, unsigned long long location, std::ostream& out) const {
+  Application const& application = info.application();
+
+  out << "----------------------------------" << std::endl;
+  out << "-- Application -- card@" << location << std::endl;
+  out << "----------------------------------" << std::endl;
+  out << "Name: " << application.name << std::endl;
+  Tools::printHex(application.aid, sizeof(application.aid), "AID", out);
+  info.printTracksInfo(out);
+
+  out << "-----------------" << std::endl;
+  out << "-- Paylog --" << std::endl;
+  out << "-----------------" << std::endl;
+  for (size_t i = 0; i < info.logEntryCount(); ++i)
+    if (!_entryTerms || matches(info.logEntry(i)))
+      info.printLogEntry(i, out);
+}
+
+static void addEntry(QueryBlock& block, PaylogEntry const& entry) {
+  unsigned date = dateOf(entry);
+  block.entries++;
+  block.dateMin = std::min(block.dateMin, date);
+  block.dateMax = std::max(block.dateMax, date);
+  block.amountMin = std::min(block.amountMin, entry.amountValue);
+  block.amountMax = std::max(block.amountMax, entry.amountValue);
+  setBit(&block.currencies, bitOf(&entry.currency, sizeof(entry.currency), 64));
+  setBit(&block.countries, bitOf(&entry.country, sizeof(entry.country), 64));
+
+  std::string name = MerchantIndex::normalize(entry.merchant, entry.merchantLength);
+  for (size_t length = 1; length <= std::min(name.size(), MERCHANT_PREFIX); ++length)
+    setBit(block.merchants, bitOf(name.data(), length, 256));
+}
+
+static void blockStats(std::vector<QuerySession> const& sessions, size_t first, size_t last,
+		       QueryBlock& block) {
+  static thread_local std::ostringstream log;
+  std::vector<CCInfo> infos;
+
+  memset(&block, 0, sizeof(block));
+  block.offset = sessions[first].offset;
+  block.end = sessions[last - 1].offset + sessions[last - 1].size;
+  block.sessions = last - first;
+  block.expiryMin = block.dateMin = ~0u;
+  block.amountMin = ~0ull;
+
+  for (size_t i = first; i < last; ++i) {
+    log.str("");
+    TraceDecoder::replay(sessions[i].data, sessions[i].size, infos, false, log);
+    for (CCInfo const& info : infos) {
+      std::string aid = aidOf(info.application());
+      unsigned expiry = expiryOf(info.track2());
+      block.expiryMin = std::min(block.expiryMin, expiry);
+      block.expiryMax = std::max(block.expiryMax, expiry);
+      setBit(&block.aids, bitOf(aid.data(), RID_DIGITS, 64));
+      for (size_t j = 0; j < info.logEntryCount(); ++j)
+	addEntry(block, info.logEntry(j));
+    }
+  }
+}
+
+// Sessions from the current position up to end, in chunks of at most count sessions
+static void addSessions(ApduFile& file, size_t capture, unsigned long long end, size_t count,
+			std::vector<QuerySession>& sessions, std::vector<QueryChunk>& chunks) {
+  QuerySession s;
+  s.capture = capture;
+  size_t first = sessions.size();
+  for (s.offset = file.tell(); s.offset < end && file.nextSession(s.data, s.size); s.offset = file.tell()) {
+    sessions.push_back(s);
+    if (sessions.size() - first == count) {
+      chunks.push_back({first, sessions.size()});
+      first = sessions.size();
+    }
+  }
+  if (first < sessions.size())
+    chunks.push_back({first, sessions.size()});
+}
+
+int Query::buildBlocks(char const* capturePath, char const* path, unsigned threads) {
+  ApduFile capture;
+  if (capture.open(capturePath))
+    return 1;
+
+  std::vector<QuerySession> sessions;
+  std::vector<QueryChunk> chunks;
+  addSessions(capture, 0, ~0ull, _BLOCK_SESSIONS, sessions, chunks);
+
+  std::vector<QueryBlock> blocks(chunks.size());
+  WorkPool::run(chunks.size(), threads,
+		[&sessions, &chunks, &blocks] (size_t chunk, unsigned, ChunkOutput&) {
+		  blockStats(sessions, chunks[chunk].first, chunks[chunk].last, blocks[chunk]);
+		},
+		[] (size_t, ChunkOutput&) {});
+
+  QueryHeader header;
+  memcpy(header.magic, _MAGIC, sizeof(_MAGIC));
+  header.indexed = capture.tell();
+  header.blocks = blocks.size();
+  header.blockSessions = _BLOCK_SESSIONS;
+
+  std::string tmp = std::string(path) + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "wb");
+  if (!file) {
+    perror(tmp.c_str());
+    return 1;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1
+    && fwrite(blocks.data(), sizeof(QueryBlock), blocks.size(), file) == blocks.size();
+  if (fclose(file) != 0 || !written || rename(tmp.c_str(), path) != 0) {
+    perror(path);
+    return 1;
+  }
+
+  std::cerr << blocks.size() << " block(s) of " << _BLOCK_SESSIONS << " sessions, "
+	    << header.indexed << " bytes of capture" << std::endl;
+  return 0;
+}
+
+static int loadBlocks(char const* path, char const* magic, std::vector<QueryBlock>& blocks,
+		      unsigned long long& indexed) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return 1;
+  }
+
+  QueryHeader header;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1 && !memcmp(header.magic, magic, sizeof(header.magic));
+  if (valid) {
+    blocks.resize(header.blocks);
+    valid = fread(blocks.data(), sizeof(QueryBlock), blocks.size(), file) == blocks.size();
+  }
+  fclose(file);
+
+  if (!valid) {
+    std::cerr << path << ": not a block index" << std::endl;
+    return 1;
+  }
+  indexed = header.indexed;
+  return 0;
+}
+
+int Query::run(std::vector<char const*> const& captures, char const* blockIndex, unsigned threads,
+	       std::ostream& out) const {
+  if (blockIndex && captures.size() != 1) {
+    std::cerr << "A block index covers a single capture" << std::endl;
+    return 1;
+  }
+
+  std::vector<ApduFile> files(captures.size());
+  std::vector<QuerySession> sessions;
+  std::vector<QueryChunk> chunks;
+  size_t skipped = 0, indexedBlocks = 0;
+
+  for (size_t c = 0; c < captures.size(); ++c) {
+    if (files[c].open(captures[c]))
+      return 1;
+
+    if (blockIndex) {
+      std::vector<QueryBlock> blocks;
+      unsigned long long indexed;
+      if (loadBlocks(blockIndex, _MAGIC, blocks, indexed))
+	return 1;
+
+      files[c].seek(indexed);
+      if (files[c].tell() != indexed) {
+	std::cerr << captures[c] << ": shorter than its block index" << std::endl;
+	return 1;
+      }
+
+      indexedBlocks = blocks.size();
+      for (QueryBlock const& block : blocks) {
+	if (skip(block)) {
+	  ++skipped;
+	  continue;
+	}
+	files[c].seek(block.offset);
+	addSessions(files[c], c, block.end, _BLOCK_SESSIONS, sessions, chunks);
+      }
+      files[c].seek(indexed);
+    }
+
+    // Not covered by the block index
+    addSessions(files[c], c, ~0ull, _BLOCK_SESSIONS, sessions, chunks);
+  }
+
+  std::vector<size_t> matched(chunks.size(), 0);
+  WorkPool::run(chunks.size(), threads,
+		[this, &captures, &sessions, &chunks, &matched] (size_t chunk, unsigned, ChunkOutput& output) {
+		  static thread_local std::ostringstream text;
+		  static thread_local std::ostringstream log;
+		  std::vector<CCInfo> infos;
+
+		  text.str("");
+		  for (size_t i = chunks[chunk].first; i < chunks[chunk].last; ++i) {
+		    QuerySession const& s = sessions[i];
+		    log.str("");
+		    TraceDecoder::replay(s.data, s.size, infos, false, log);
+
+		    bool first = true;
+		    for (CCInfo const& info : infos) {
+		      if (!matches(info))
+			continue;
+		      if (first)
+			text << TextImport::MARKER << " " << captures[s.capture] << std::endl;
+		      first = false;
+		      print(info, s.offset, text);
+		      matched[chunk]++;
+		    }
+		  }
+		  output.out = text.str();
+		},
+		[&out] (size_t, ChunkOutput& output) {
+		  out << output.out;
+		});
+  out.flush();
+
+  size_t total = 0;
+  for (size_t count : matched)
+    total += count;
+  std::cerr << total << " application(s) matched, " << sessions.size() << " session(s) decoded";
+  if (blockIndex)
+    std::cerr << ", " << skipped << " of " << indexedBlocks << " block(s) skipped";
+  std::cerr << std::endl;
+  return 0;
+}
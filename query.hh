@@ -0,0 +1,106 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __QUERY_HH__
+# define __QUERY_HH__
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "ccinfo.hh"
+
+// Statistics of a block of consecutive sessions of a capture
+struct QueryBlock {
+  unsigned long long offset; // Capture range of the sessions
+  unsigned long long end;
+  unsigned int sessions;
+  unsigned int entries;
+  unsigned int expiryMin; // YYMM
+  unsigned int expiryMax;
+  unsigned int dateMin; // YYMMDD
+  unsigned int dateMax;
+  unsigned long long amountMin; // Minor units
+  unsigned long long amountMax;
+  unsigned long long aids; // One bit per hash of the RID (5 first bytes of the AID)
+  unsigned long long currencies; // One bit per hash of the code
+  unsigned long long countries;
+  unsigned long long merchants[4]; // One bit per hash of the 1, 2 and 3 first characters of the names
+};
+
+/* Filters the applications and paylog entries of captures (APDU files):
+     aid=A0000000041010,A000000003  AID prefixes, in hex
+     expiry=2016-01..2018-12        expiry month, or a single month
+     country=FRA,GBR  currency=EUR  names or numeric codes
+     amount=10..99.99               in major units, bounds included, either bound may be left out
+     date=2014-12-01..2014-12-31    date of the entry, or a single day
+     merchant=TESCO  merchant=TES*  name or prefix, case and trailing spaces ignored
+   Terms are separated by spaces and must all hold. An application matches when it passes aid and expiry
+   and, if there are entry terms, one of its entries passes all of them; only those entries are printed.
+   With a block index, built by --index, blocks whose statistics cannot match are not read at all.
+*/
+class Query {
+
+public:
+  Query();
+
+public:
+  int parse(char const* text);
+  int run(std::vector<char const*> const& captures, char const* blockIndex, unsigned threads,
+	  std::ostream& out = std::cout) const;
+
+  static int buildBlocks(char const* capture, char const* path, unsigned threads);
+
+private:
+  struct Range {
+    unsigned long long min;
+    unsigned long long max;
+  };
+
+  bool skip(QueryBlock const& block) const;
+  bool matches(CCInfo const& info) const;
+  bool matches(PaylogEntry const& entry) const;
+  void print(CCInfo const& info, unsigned long long location, std::ostream& out) const;
+
+  static bool parseRange(std::string const& text, Range& range,
+			 bool (*parseValue)(std::string const&, unsigned long long&));
+  static bool parseAmount(std::string const& text, unsigned long long& value);
+  static bool parseDate(std::string const& text, unsigned long long& value);
+  static bool parseMonth(std::string const& text, unsigned long long& value);
+
+private:
+  std::vector<std::string> _aids; // Upper case hex
+  std::vector<unsigned short> _countries;
+  std::vector<unsigned short> _currencies;
+  std::vector<std::string> _merchants; // Normalized, without the *
+  std::vector<bool> _merchantPrefixes;
+  Range _expiry; // Everything when the term is absent
+  Range _amount;
+  Range _date;
+  bool _entryTerms;
+
+  static const size_t _BLOCK_SESSIONS = 64;
+  static const char _MAGIC[8];
+};
+
+#endif // __QUERY_HH__
@@ -0,0 +1,172 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+extern "C" {
+#include <nfc/nfc.h>
+}
+
+#include <cstdio>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <mutex>
+
+#include "readerhealth.hh"
+#include "tools.hh"
+
+unsigned ReaderHealth::_threshold = 3;
+unsigned ReaderHealth::_maxBackoff = 30000;
+char const* ReaderHealth::_metricsPath = NULL;
+ReaderDevice ReaderHealth::_main = ReaderDevice();
+thread_local ReaderDevice* ReaderHealth::_device = &ReaderHealth::_main;
+
+static std::mutex contextLock; // Over the libnfc context, shared by the devices
+static nfc_context* context = NULL;
+static std::chrono::steady_clock::time_point lastWrite;
+
+void ReaderHealth::configure(unsigned threshold, unsigned maxBackoff, char const* metrics) {
+  _threshold = std::max(threshold, 1u);
+  _maxBackoff = maxBackoff < _FIRST_BACKOFF ? _FIRST_BACKOFF : maxBackoff;
+  _metricsPath = metrics;
+}
+
+void ReaderHealth::use(ReaderDevice* device) {
+  _device = device ? device : &_main;
+  pnd = _device->device;
+}
+
+// One attempt: libnfc context, device, then the PN532 set up as initiator
+int ReaderHealth::open() {
+  _device->metrics.openAttempts++;
+
+  {
+    std::lock_guard<std::mutex> guard(contextLock);
+    if (context == NULL) {
+      nfc_init(&context);
+      if (context == NULL) {
+	std::cerr << "Unable to init libnfc (malloc)" << std::endl;
+	return 1;
+      }
+    }
+    std::string const& connstring = _device->connstring;
+    pnd = _device->device = nfc_open(context, connstring.empty() ? NULL : connstring.c_str());
+  }
+  if (pnd == NULL) {
+    std::cerr << "Unable to open NFC device." << std::endl;
+    return 1;
+  }
+
+  if (nfc_initiator_init(pnd) < 0) {
+    nfc_perror(pnd, "nfc_initiator_init");
+    close();
+    return 1;
+  }
+  return 0;
+}
+
+void ReaderHealth::close() {
+  if (_device->device)
+    nfc_close(_device->device);
+  pnd = _device->device = NULL;
+}
+
+// Opens the device, waiting as long as it takes
+void ReaderHealth::connect() {
+  unsigned backoff = _FIRST_BACKOFF;
+  while (open()) {
+    writeMetrics();
+    std::cerr << "Retrying in " << backoff << " ms" << std::endl;
+    std::this_thread::sleep_for(std::chrono::milliseconds(backoff));
+    backoff = std::min(backoff * 2, _maxBackoff);
+  }
+
+  _device->metrics.consecutiveFailures = 0;
+  _device->metrics.up = true;
+  writeMetrics();
+}
+
+void ReaderHealth::recover() {
+  ReaderMetrics& m = _device->metrics;
+  std::cerr << "NFC device failing after " << m.consecutiveFailures << " consecutive errors, reopening"
+	    << std::endl;
+  m.up = false;
+  writeMetrics();
+
+  close();
+  connect();
+
+  std::chrono::steady_clock::duration streak = std::chrono::steady_clock::now() - _device->failingSince;
+  double elapsed = std::chrono::duration<double>(streak).count();
+  m.recoveries++;
+  m.lastRecovery = elapsed;
+  m.maxRecovery = std::max(m.maxRecovery, elapsed);
+  m.totalRecovery += elapsed;
+  std::cerr << "NFC device back after " << elapsed << " s" << std::endl;
+  writeMetrics();
+}
+
+void ReaderHealth::report(int result, bool polling) {
+  if (polling && result == NFC_ETIMEOUT)
+    return;
+
+  ReaderMetrics& m = _device->metrics;
+  m.exchanges++;
+  if (result >= 0)
+    m.consecutiveFailures = 0;
+  else {
+    if (m.consecutiveFailures++ == 0)
+      _device->failingSince = std::chrono::steady_clock::now();
+    m.failures++;
+  }
+
+  if (_metricsPath && std::chrono::steady_clock::now() - lastWrite >= std::chrono::seconds(1))
+    writeMetrics();
+}
+
+// Text exposition format, replaced atomically, as the --forward-metrics file
+void ReaderHealth::writeMetrics() {
+  if (!_metricsPath)
+    return;
+  lastWrite = std::chrono::steady_clock::now();
+
+  std::string tmp = std::string(_metricsPath) + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "w");
+  if (!file) {
+    perror(tmp.c_str());
+    return;
+  }
+
+  ReaderMetrics const& m = _device->metrics;
+  fprintf(file, "readcc_reader_up %d\n", m.up ? 1 : 0);
+  fprintf(file, "readcc_reader_exchanges_total %llu\n", m.exchanges);
+  fprintf(file, "readcc_reader_failures_total %llu\n", m.failures);
+  fprintf(file, "readcc_reader_consecutive_failures %llu\n", m.consecutiveFailures);
+  fprintf(file, "readcc_reader_open_attempts_total %llu\n", m.openAttempts);
+  fprintf(file, "readcc_reader_recoveries_total %llu\n", m.recoveries);
+  fprintf(file, "readcc_reader_last_recovery_seconds %.3f\n", m.lastRecovery);
+  fprintf(file, "readcc_reader_max_recovery_seconds %.3f\n", m.maxRecovery);
+  fprintf(file, "readcc_reader_recovery_seconds_total %.3f\n", m.totalRecovery);
+
+  if (fclose(file) != 0 || rename(tmp.c_str(), _metricsPath) != 0)
+    perror(_metricsPath);
+}
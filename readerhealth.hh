@@ -0,0 +1,91 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+
+#ifndef __READERHEALTH_HH__
+# define __READERHEALTH_HH__
+
+#include <string>
+#include <chrono>
+
+struct nfc_device;
+
+struct ReaderMetrics {
+  unsigned long long exchanges; // Transceives with the PN532, polling timeouts excluded
+  unsigned long long failures;
+  unsigned long long consecutiveFailures;
+  unsigned long long openAttempts;
+  unsigned long long recoveries;
+  double lastRecovery; // s, from the first failure of the streak to the reopened device
+  double maxRecovery;
+  double totalRecovery;
+  bool up;
+};
+
+// An NFC device and its health: the live loop has one, each Python Reader its own
+struct ReaderDevice {
+  std::string connstring; // Empty for the first device libnfc finds
+  struct nfc_device* device;
+  ReaderMetrics metrics;
+  std::chrono::steady_clock::time_point failingSince;
+};
+
+/* Health of the NFC device in the live reading loop, so that a PN532 brown out or a USB serial adapter
+   reset costs a reopen instead of a restart of the process.
+   Every pn53x_transceive result is reported; a timeout while polling for a card is not an error, and
+   the loops only exchange with a card once a poll found one, so an idle reader never counts failures.
+   After _threshold consecutive failures the device is failing: recover() closes it and opens it again,
+   PN532 initialisation included, waiting between attempts from _FIRST_BACKOFF doubling up to
+   _maxBackoff. The time to recover runs from the first failure of the streak to the reopened device.
+   The counters are written in text exposition format to the metrics file, if any, at most every second
+   and on every change of state.
+   A thread works on the device it last passed to use(), the one of the live loop by default, and pnd
+   follows it so the transceiver talks to that device. A device is used by one thread at a time.
+*/
+class ReaderHealth {
+
+public:
+  static void configure(unsigned threshold, unsigned maxBackoff, char const* metrics);
+  static void use(ReaderDevice* device); // NULL = the device of the live loop
+  static int open();
+  static void close();
+  static void connect();
+  static void recover();
+  static void report(int result, bool polling);
+  static bool failing() { return _device->metrics.consecutiveFailures >= _threshold; }
+  static ReaderMetrics const& metrics() { return _device->metrics; }
+
+private:
+  static void writeMetrics();
+
+private:
+  static unsigned _threshold;
+  static unsigned _maxBackoff; // ms
+  static char const* _metricsPath;
+  static ReaderDevice _main;
+  static thread_local ReaderDevice* _device;
+
+  static const unsigned _FIRST_BACKOFF = 100; // ms
+};
+
+#endif // __READERHEALTH_HH__
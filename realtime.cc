@@ -0,0 +1,185 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#include <sched.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <sys/mman.h>
+
+#include "realtime.hh"
+#include "applicationhelper.hh"
+
+// Scheduling state saved by enable() so disable() can put it back
+static cpu_set_t savedAffinity;
+static int savedPolicy = -1;
+static struct sched_param savedParam;
+
+int Realtime::lastAllowedCpu() {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0)
+    return 0;
+
+  for (int cpu = CPU_SETSIZE - 1; cpu >= 0; --cpu)
+    if (CPU_ISSET(cpu, &set))
+      return cpu;
+  return 0;
+}
+
+// To be called by every reader thread
+int Realtime::pinThread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (err != 0) {
+    std::cerr << "Unable to pin thread to CPU " << cpu << ": " << strerror(err) << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Grow the stack once now so the reader loop never faults on it: this covers the call depth of the read
+// path and the locals of CardReader::read, the CCInfo objects themselves are in a vector on the heap
+void Realtime::prefaultStack() {
+  volatile byte_t stack[_STACK_PREFAULT];
+
+  for (size_t i = 0; i < sizeof(stack); i += _PAGE_SIZE)
+    stack[i] = 0;
+}
+
+/* Every step is best effort: without the privileges (CAP_SYS_NICE, CAP_IPC_LOCK)
+   we warn and keep reading with whatever could be applied.
+*/
+int Realtime::enable(int cpu, int priority) {
+
+  if (cpu < 0)
+    cpu = lastAllowedCpu();
+
+  CPU_ZERO(&savedAffinity);
+  sched_getaffinity(0, sizeof(savedAffinity), &savedAffinity);
+  savedPolicy = sched_getscheduler(0);
+  sched_getparam(0, &savedParam);
+
+  // Freed memory stays in the process, later allocations do not fault
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    std::cerr << "mlockall failed: " << strerror(errno) << ". Memory is not locked." << std::endl;
+
+  prefaultStack();
+  ApplicationHelper::prefaultBuffers();
+
+  int ret = pinThread(cpu);
+
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = priority;
+  if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+    std::cerr << "SCHED_FIFO not allowed: " << strerror(errno) << ". Using the default scheduler." << std::endl;
+    ret = 1;
+  }
+
+  std::cerr << "Realtime mode on CPU " << cpu << std::endl;
+  return ret;
+}
+
+void Realtime::disable() {
+  if (savedPolicy < 0)
+    return;
+
+  sched_setscheduler(0, savedPolicy, &savedParam);
+  sched_setaffinity(0, sizeof(savedAffinity), &savedAffinity);
+  munlockall();
+  savedPolicy = -1;
+}
+
+// Answers 9000 to everything: what remains is the host side of executeCommand
+int Realtime::loopbackTransceive(__attribute__((unused)) byte_t const* tx,
+				 __attribute__((unused)) size_t szTx,
+				 byte_t* rx,
+				 __attribute__((unused)) size_t szRx,
+				 __attribute__((unused)) int timeout) {
+  rx[0] = 0x00; // PN532 status
+  rx[1] = 0x90;
+  rx[2] = 0x00;
+  return 3;
+}
+
+static long elapsedNs(struct timespec const& from, struct timespec const& to) {
+  return (to.tv_sec - from.tv_sec) * 1000000000L + (to.tv_nsec - from.tv_nsec);
+}
+
+void Realtime::measure(char const* label) {
+
+  std::vector<long> wakeup;
+  std::vector<long> apdu;
+  wakeup.reserve(_PROBE_SAMPLES);
+  apdu.reserve(_PROBE_SAMPLES);
+
+  // Wake-up latency of a periodic absolute sleep
+  struct timespec next, now;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  for (int n = 0; n < _PROBE_SAMPLES; ++n) {
+    next.tv_nsec += _PROBE_PERIOD_NS;
+    if (next.tv_nsec >= 1000000000L) {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    wakeup.push_back(elapsedNs(next, now));
+  }
+
+  // Host overhead of one APDU, the card being replaced by a loopback
+  Transceiver old = ApplicationHelper::setTransceiver(loopbackTransceive);
+  struct timespec start, end;
+  for (int n = 0; n < _PROBE_SAMPLES; ++n) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ApplicationHelper::executeCommand(Command::SELECT_PPSE,
+				      sizeof(Command::SELECT_PPSE),
+				      "SELECT PPSE");
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    apdu.push_back(elapsedNs(start, end));
+  }
+  ApplicationHelper::setTransceiver(old);
+
+  std::cout << "-- " << label << " --" << std::endl;
+  Tools::printDistribution("Wake-up latency", wakeup);
+  Tools::printDistribution("APDU host overhead", apdu);
+}
+
+// Runs the probe without then with the realtime mode
+void Realtime::probe(int cpu, int priority) {
+  measure("Default scheduling");
+  enable(cpu, priority);
+  measure("Realtime mode");
+  disable();
+}
@@ -0,0 +1,278 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#include <cstring>
+#include <climits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "resultring.hh"
+#include "forwarder.hh"
+
+static const char RING_MAGIC[8] = {'R', 'C', 'C', 'R', 'I', 'N', 'G', '1'};
+static const size_t RING_HEADER_SIZE = 4096;
+static const unsigned PADDING = ~0u;
+
+struct RingRecord {
+  unsigned int length; // PADDING up to the end of the ring
+  unsigned int reserved;
+  unsigned long long sequence;
+};
+
+static size_t align16(size_t size) {
+  return (size + 15) & ~(size_t)15;
+}
+
+ResultRing::ResultRing()
+  : _header(NULL),
+    _data(NULL),
+    _size(0)
+{
+}
+
+ResultRing::~ResultRing() {
+  if (_header)
+    munmap(_header, _size);
+}
+
+// A ring of the same capacity left by a previous run is continued, so its readers keep following
+int ResultRing::open(char const* name, size_t capacity) {
+  size_t rounded = 1 << 16;
+  while (rounded < capacity)
+    rounded *= 2;
+
+  // Card numbers: owner only, a segment left by an older build included
+  int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+  if (fd < 0 || fchmod(fd, 0600) != 0 || ftruncate(fd, RING_HEADER_SIZE + rounded) != 0) {
+    perror(name);
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+
+  _size = RING_HEADER_SIZE + rounded;
+  void* map = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(name);
+    return 1;
+  }
+
+  _header = (RingHeader*)map;
+  _data = (byte_t*)map + RING_HEADER_SIZE;
+  if (memcmp(_header->magic, RING_MAGIC, sizeof(RING_MAGIC)) || _header->capacity != rounded
+      || _header->reserved != _header->published) {
+    _header->capacity = rounded;
+    _header->reserved = 0;
+    _header->published = 0;
+    _header->sequence = 0;
+    _header->futex = 0;
+    memcpy(_header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+  }
+  return 0;
+}
+
+int ResultRing::publish(std::vector<CCInfo> const& infos) {
+  _buffer.clear();
+  Forwarder::encode(infos, _buffer);
+  return publish(_buffer.data(), _buffer.size());
+}
+
+/* Readers check the reserved counter after copying a record: the bytes are announced there before
+   they are overwritten, and only counted as published once complete.
+*/
+int ResultRing::publish(void const* data, size_t size) {
+  unsigned long long capacity = _header->capacity;
+  size_t total = align16(sizeof(RingRecord) + size);
+  if (total > capacity / 2)
+    return 1;
+
+  unsigned long long head = _header->published.load(std::memory_order_relaxed);
+  size_t offset = head & (capacity - 1);
+  size_t padding = offset + total > capacity ? capacity - offset : 0;
+
+  _header->reserved.store(head + padding + total, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  RingRecord* record = (RingRecord*)(_data + offset);
+  if (padding) {
+    record->length = PADDING;
+    record = (RingRecord*)_data;
+  }
+  record->length = size;
+  record->sequence = _header->sequence.load(std::memory_order_relaxed);
+  memcpy(record + 1, data, size);
+
+  _header->published.store(head + padding + total, std::memory_order_release);
+  _header->sequence.store(record->sequence + 1, std::memory_order_release);
+  _header->futex.fetch_add(1, std::memory_order_release);
+  syscall(SYS_futex, &_header->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  return 0;
+}
+
+ResultRingReader::ResultRingReader()
+  : _header(NULL),
+    _data(NULL),
+    _size(0),
+    _position(0),
+    _expected(0),
+    _synced(false)
+{
+}
+
+ResultRingReader::~ResultRingReader() {
+  if (_header)
+    munmap((void*)_header, _size);
+}
+
+int ResultRingReader::open(char const* name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    perror(name);
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+
+  void* map = st.st_size > (off_t)RING_HEADER_SIZE
+    ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << name << ": not a result ring" << std::endl;
+    return 1;
+  }
+
+  _header = (RingHeader const*)map;
+  _data = (byte_t const*)map + RING_HEADER_SIZE;
+  _size = st.st_size;
+  if (memcmp(_header->magic, RING_MAGIC, sizeof(RING_MAGIC)) || RING_HEADER_SIZE + _header->capacity != _size) {
+    std::cerr << name << ": not a result ring" << std::endl;
+    return 1;
+  }
+
+  // New records only
+  resync();
+  return 0;
+}
+
+void ResultRingReader::resync() {
+  _position = _header->published.load(std::memory_order_acquire);
+  _synced = false;
+}
+
+ResultRingReader::Status ResultRingReader::next(std::string& out, unsigned long long& sequence,
+						unsigned long long& lost, int timeout) {
+  unsigned long long capacity = _header->capacity;
+
+  while (true) {
+    unsigned int futex = _header->futex.load(std::memory_order_acquire);
+    unsigned long long published = _header->published.load(std::memory_order_acquire);
+
+    if (published < _position) { // The writer started over
+      resync();
+      continue;
+    }
+    if (published == _position) {
+      if (timeout <= 0)
+	return EMPTY;
+      struct timespec wait = {timeout / 1000, (timeout % 1000) * 1000000L};
+      syscall(SYS_futex, &_header->futex, FUTEX_WAIT, futex, &wait, NULL, 0);
+      timeout = 0;
+      continue;
+    }
+
+    // A padding record sends the next one to the start of the ring
+    RingRecord record;
+    size_t offset = _position & (capacity - 1);
+    unsigned long long start = _position;
+    bool valid = published - _position <= capacity;
+    if (valid) {
+      memcpy(&record, _data + offset, sizeof(record));
+      if (record.length == PADDING) {
+	start += capacity - offset;
+	offset = 0;
+	memcpy(&record, _data, sizeof(record));
+      }
+      valid = sizeof(record) + record.length <= capacity - offset;
+      if (valid)
+	out.assign((char const*)_data + offset + sizeof(record), record.length);
+    }
+
+    // Overwritten while copying if the writer announced bytes a whole ring past its start
+    std::atomic_thread_fence(std::memory_order_acquire);
+    unsigned long long reserved = _header->reserved.load(std::memory_order_relaxed);
+    valid = valid && reserved - start <= capacity && (!_synced || record.sequence == _expected);
+    if (!valid) {
+      unsigned long long current = _header->sequence.load(std::memory_order_acquire);
+      lost = _synced && current > _expected ? current - _expected : 0;
+      resync();
+      return OVERRUN;
+    }
+
+    _position = start + align16(sizeof(record) + record.length);
+    sequence = record.sequence;
+    _expected = sequence + 1;
+    _synced = true;
+    return RECORD;
+  }
+}
+
+int ResultRingReader::follow(char const* name, std::ostream& out) {
+  ResultRingReader reader;
+  if (reader.open(name))
+    return 1;
+
+  std::string record;
+  std::string text;
+  unsigned long long sequence, lost;
+  while (true) {
+    switch (reader.next(record, sequence, lost, 1000)) {
+    case RECORD: {
+      ImportedCard card;
+      byte_t const* cursor = (byte_t const*)record.data();
+      card.offset = sequence;
+      if (!Forwarder::decode(cursor, cursor + record.size(), card)) {
+	std::cerr << "Malformed record " << sequence << std::endl;
+	break;
+      }
+      text.clear();
+      TextImport::write(card, text);
+      out << text;
+      out.flush();
+      break;
+    }
+    case OVERRUN:
+      std::cerr << "Overrun, " << lost << " record(s) lost" << std::endl;
+      break;
+    case EMPTY:
+      break;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,96 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __RESULTRING_HH__
+# define __RESULTRING_HH__
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "ccinfo.hh"
+
+/* Shared memory ring of card records (as encoded by Forwarder::encode) for local consumers.
+   One writer, any number of readers mapping it read-only, each following at its own pace.
+   The writer never waits: a reader that falls more than the capacity behind finds its records
+   overwritten, which it detects from the byte counters and the sequence numbers, and skips ahead.
+     header (one page) | records
+   Each record is a 16-byte header (length, sequence) then the payload, 16-byte aligned, and never
+   wraps: the end of the ring is skipped with a padding record instead.
+*/
+struct RingHeader {
+  char magic[8];
+  unsigned long long capacity; // Bytes of records, a power of 2
+  std::atomic<unsigned long long> reserved; // Bytes written or being written
+  std::atomic<unsigned long long> published; // Bytes readable
+  std::atomic<unsigned long long> sequence; // Of the next record
+  std::atomic<unsigned int> futex; // Changes on every record, readers wait on it
+};
+
+class ResultRing {
+
+public:
+  ResultRing();
+  ~ResultRing();
+
+public:
+  int open(char const* name, size_t capacity);
+  int publish(std::vector<CCInfo> const& infos);
+  int publish(void const* data, size_t size);
+
+private:
+  RingHeader* _header;
+  byte_t* _data;
+  size_t _size;
+  std::string _buffer;
+};
+
+class ResultRingReader {
+
+public:
+  ResultRingReader();
+  ~ResultRingReader();
+
+public:
+  enum Status {RECORD, EMPTY, OVERRUN};
+
+  int open(char const* name);
+  // Copies the next record, waits up to timeout ms for one. lost is set on OVERRUN
+  Status next(std::string& record, unsigned long long& sequence, unsigned long long& lost, int timeout);
+
+  // Prints the records as --import-text does, until killed
+  static int follow(char const* name, std::ostream& out = std::cout);
+
+private:
+  void resync();
+
+private:
+  RingHeader const* _header;
+  byte_t const* _data;
+  size_t _size;
+  unsigned long long _position; // In bytes since the creation of the ring
+  unsigned long long _expected; // Next sequence
+  bool _synced;
+};
+
+#endif // __RESULTRING_HH__
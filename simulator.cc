@@ -0,0 +1,217 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <iostream>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <cstring>
+
+#include "simulator.hh"
+#include "applicationhelper.hh"
+
+FaultConfig::FaultConfig()
+  : rfLatency(2),
+    spikeRate(0),
+    spikeLatency(50),
+    dropRate(0),
+    corruptRate(0),
+    statusRate(0),
+    removalAfter(0),
+    seed(1)
+{
+}
+
+static FaultConfig config;
+static std::mt19937 rng;
+static std::vector<CardImage> cards;
+static size_t current = 0;
+static ApduFile corpus; // Streamed one card at a time, replaces the card list when open
+static bool useCorpus = false;
+static CardImage inField;
+static int apduCount = 0; // Since the card entered the field
+static Bytes pending; // Answer held back by an injected 61xx
+
+static struct {
+  long apdus;
+  long spikes;
+  long drops;
+  long corruptions;
+  long statuses;
+  long removals;
+} faults;
+
+static bool draw(double rate) {
+  return rate > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < rate;
+}
+
+static void sleepMs(int ms) {
+  if (ms > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void Simulator::configure(FaultConfig const& c) {
+  config = c;
+  rng.seed(config.seed);
+  memset(&faults, 0, sizeof(faults));
+  ApplicationHelper::setTransceiver(transceive);
+}
+
+void Simulator::addCard(CardImage const& card) {
+  cards.push_back(card);
+}
+
+int Simulator::loadCorpus(char const* path) {
+  byte_t const* session;
+  size_t size;
+  if (corpus.open(path))
+    return 1;
+  if (!corpus.nextSession(session, size)) {
+    std::cerr << path << ": no session to replay" << std::endl;
+    return 1;
+  }
+  corpus.rewind();
+  useCorpus = true;
+  return 0;
+}
+
+// Nothing comes back: the reader notices after its timeout
+int Simulator::fail(int timeout) {
+  sleepMs(timeout > 0 ? timeout : _DEFAULT_DROP_TIMEOUT);
+  return -1;
+}
+
+int Simulator::transceive(byte_t const* tx, size_t szTx, byte_t* rx, size_t szRx, int timeout) {
+
+  sleepMs(config.rfLatency);
+
+  if (tx[0] != Command::IN_DATA_EXCHANGE) { // START 14443A: next card enters the field
+    if (useCorpus) {
+      byte_t const* session;
+      size_t size;
+      if (!corpus.nextSession(session, size)) { // Start over at the end of the corpus
+	corpus.rewind();
+	if (!corpus.nextSession(session, size)) // Checked by loadCorpus, no card rather than garbage
+	  return -1;
+      }
+      inField.load(session, size);
+    }
+    else {
+      if (apduCount > 0)
+	current = (current + 1) % cards.size();
+      inField = cards[current];
+    }
+    apduCount = 0;
+    pending.clear();
+    byte_t const target[] = {0x01, 0x01, 0x00, 0x04, 0x20, 0x04, 0x12, 0x34, 0x56, 0x78};
+    memcpy(rx, target, sizeof(target));
+    return sizeof(target);
+  }
+
+  faults.apdus++;
+  if (config.removalAfter > 0 && apduCount >= config.removalAfter) {
+    if (apduCount++ == config.removalAfter)
+      faults.removals++;
+    return fail(timeout);
+  }
+  apduCount++;
+
+  if (draw(config.spikeRate)) {
+    faults.spikes++;
+    sleepMs(config.spikeLatency);
+  }
+  if (draw(config.dropRate)) {
+    faults.drops++;
+    return fail(timeout);
+  }
+
+  Bytes response;
+  if (tx[3] == Command::GET_RESPONSE[3] && !pending.empty()) {
+    response.swap(pending);
+  }
+  else {
+    inField.answer(tx, szTx, response);
+
+    if (draw(config.statusRate)) {
+      faults.statuses++;
+      byte_t available = response.size() - 2;
+      switch (std::uniform_int_distribution<int>(0, 3)(rng)) {
+      case 0: response = {0x6A, 0x82}; break;
+      case 1: response = {0x69, 0x85}; break;
+      case 2: pending.swap(response); response = {0x61, available}; break;
+      default: response = {0x6C, available}; break;
+      }
+    }
+  }
+
+  if (response.size() + 1 > szRx)
+    return -1;
+
+  if (draw(config.corruptRate)) {
+    faults.corruptions++;
+    size_t byte = std::uniform_int_distribution<size_t>(0, response.size() - 1)(rng);
+    response[byte] ^= 1 << std::uniform_int_distribution<int>(0, 7)(rng);
+  }
+
+  rx[0] = 0x00; // PN532 status
+  memcpy(rx + 1, response.data(), response.size());
+  return response.size() + 1;
+}
+
+// Reads the given number of cards and prints throughput and latency distribution
+int Simulator::bench(int count, int (*readCard)()) {
+  if (cards.empty() && !useCorpus)
+    addCard(CardImage::defaultCard());
+
+  std::vector<long> latencies;
+  int failures = 0;
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+  for (int n = 0; n < count; ++n) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ApplicationHelper::executeCommand(Command::START_14443A,
+				      sizeof(Command::START_14443A),
+				      "START 14443A");
+    if (readCard())
+      failures++;
+    latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  std::cout << "-- Simulation --" << std::endl;
+  std::cout << count << " card(s), " << failures << " failed, "
+	    << (elapsed > 0 ? (count - failures) * 60 / elapsed : 0) << " good cards/min, "
+	    << faults.apdus / (count ? count : 1) << " APDUs/card" << std::endl;
+  Tools::printDistribution("Card read time", latencies, 1000.0, "ms");
+  printFaults();
+  return failures ? 1 : 0;
+}
+
+void Simulator::printFaults() {
+  std::cout << "Faults injected over " << faults.apdus << " APDUs: "
+	    << faults.spikes << " latency spikes, "
+	    << faults.drops << " drops, "
+	    << faults.corruptions << " corruptions, "
+	    << faults.statuses << " status words, "
+	    << faults.removals << " removals" << std::endl;
+}
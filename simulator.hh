@@ -0,0 +1,65 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __SIMULATOR_HH__
+# define __SIMULATOR_HH__
+
+#include <vector>
+
+#include "cardimage.hh"
+
+// Probabilities are per APDU, durations in ms
+struct FaultConfig {
+  FaultConfig();
+
+  int rfLatency; // Time taken by every exchange
+  double spikeRate;
+  int spikeLatency;
+  double dropRate; // No answer, the reader waits for its timeout
+  double corruptRate; // One bit flipped in the answer
+  double statusRate; // 6A82, 6985, 61xx or 6Cxx instead of the answer
+  int removalAfter; // Card leaves the field after N APDUs, 0 = never
+  unsigned seed;
+};
+
+/* Simulated card and transport plugged under ApplicationHelper::executeCommand.
+   Each START 14443A presents the next card of the list, faults are drawn from a seeded generator
+   so runs are reproducible.
+*/
+class Simulator {
+
+public:
+  static void configure(FaultConfig const& config);
+  static void addCard(CardImage const& card);
+  static int loadCorpus(char const* path);
+  static int transceive(byte_t const* tx, size_t szTx, byte_t* rx, size_t szRx, int timeout);
+  static int bench(int cards, int (*readCard)());
+
+private:
+  static int fail(int timeout);
+  static void printFaults();
+
+private:
+  static const int _DEFAULT_DROP_TIMEOUT = 1000; // When the reader waits forever
+};
+
+#endif // __SIMULATOR_HH__
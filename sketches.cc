@@ -0,0 +1,321 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cmath>
+#include <algorithm>
+
+#include "sketches.hh"
+#include "tools.hh"
+
+template <typename T>
+static bool put(FILE* file, T const& value) {
+  return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+template <typename T>
+static bool get(FILE* file, T& value) {
+  return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+/*
+  HyperLogLog
+*/
+
+HyperLogLog::HyperLogLog()
+  : _registers(_REGISTERS, 0)
+{
+}
+
+// The first bits pick the register, the rank of the first 1 in the others is kept
+void HyperLogLog::add(unsigned long long hash) {
+  size_t index = hash >> (64 - _PRECISION);
+  unsigned long long rest = hash << _PRECISION | (1ull << (_PRECISION - 1));
+  unsigned char rank = __builtin_clzll(rest) + 1;
+
+  if (rank > _registers[index])
+    _registers[index] = rank;
+}
+
+void HyperLogLog::merge(HyperLogLog const& other) {
+  for (size_t i = 0; i < _REGISTERS; ++i)
+    _registers[i] = std::max(_registers[i], other._registers[i]);
+}
+
+double HyperLogLog::estimate() const {
+  double sum = 0;
+  size_t zeros = 0;
+
+  for (unsigned char r : _registers) {
+    sum += std::ldexp(1.0, -r);
+    if (r == 0)
+      ++zeros;
+  }
+
+  double m = _REGISTERS;
+  double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+
+  // Small cardinalities: linear counting is more precise
+  if (estimate <= 2.5 * m && zeros > 0)
+    estimate = m * std::log(m / zeros);
+  return estimate;
+}
+
+int HyperLogLog::save(FILE* file) const {
+  return fwrite(_registers.data(), 1, _registers.size(), file) == _registers.size() ? 0 : 1;
+}
+
+int HyperLogLog::load(FILE* file) {
+  return fread(_registers.data(), 1, _registers.size(), file) == _registers.size() ? 0 : 1;
+}
+
+/*
+  Count-Min
+*/
+
+CountMin::CountMin(size_t top)
+  : _counters(_DEPTH * _WIDTH, 0),
+    _total(0),
+    _k(top)
+{
+}
+
+// Row i uses h1 + i * h2, the usual double hashing
+unsigned long long CountMin::add(std::string const& key, unsigned long long count) {
+  unsigned long long h = Tools::hash(key.data(), key.size());
+  unsigned long long h2 = h >> 32 | 1;
+  unsigned long long estimate = ~0ull;
+
+  for (size_t i = 0; i < _DEPTH; ++i) {
+    unsigned long long& c = _counters[i * _WIDTH + (h + i * h2) % _WIDTH];
+    c += count;
+    estimate = std::min(estimate, c);
+  }
+  _total += count;
+
+  offer(key, estimate);
+  return estimate;
+}
+
+unsigned long long CountMin::estimate(std::string const& key) const {
+  unsigned long long h = Tools::hash(key.data(), key.size());
+  unsigned long long h2 = h >> 32 | 1;
+  unsigned long long estimate = ~0ull;
+
+  for (size_t i = 0; i < _DEPTH; ++i)
+    estimate = std::min(estimate, _counters[i * _WIDTH + (h + i * h2) % _WIDTH]);
+  return estimate;
+}
+
+typedef std::pair<unsigned long long, std::string> HeapEntry;
+
+static bool heapOrder(HeapEntry const& a, HeapEntry const& b) {
+  return a.first > b.first;
+}
+
+// k is small, finding the key in the heap is a linear scan
+void CountMin::offer(std::string const& key, unsigned long long estimate) {
+  for (HeapEntry& e : _heap)
+    if (e.second == key) {
+      e.first = estimate;
+      std::make_heap(_heap.begin(), _heap.end(), heapOrder);
+      return;
+    }
+
+  if (_heap.size() < _k) {
+    _heap.push_back(HeapEntry(estimate, key));
+    std::push_heap(_heap.begin(), _heap.end(), heapOrder);
+  }
+  else if (_k > 0 && estimate > _heap.front().first) {
+    std::pop_heap(_heap.begin(), _heap.end(), heapOrder);
+    _heap.back() = HeapEntry(estimate, key);
+    std::push_heap(_heap.begin(), _heap.end(), heapOrder);
+  }
+}
+
+// Candidates of both sides are estimated again against the merged counters
+void CountMin::merge(CountMin const& other) {
+  for (size_t i = 0; i < _counters.size(); ++i)
+    _counters[i] += other._counters[i];
+  _total += other._total;
+
+  std::vector<HeapEntry> candidates(_heap);
+  candidates.insert(candidates.end(), other._heap.begin(), other._heap.end());
+  _heap.clear();
+  for (HeapEntry const& c : candidates)
+    offer(c.second, estimate(c.second));
+}
+
+unsigned long long CountMin::total() const {
+  return _total;
+}
+
+std::vector<std::pair<std::string, unsigned long long> > CountMin::top() const {
+  std::vector<HeapEntry> sorted(_heap);
+  std::sort(sorted.begin(), sorted.end(), heapOrder);
+
+  std::vector<std::pair<std::string, unsigned long long> > top;
+  for (HeapEntry const& e : sorted)
+    top.push_back(std::make_pair(e.second, e.first));
+  return top;
+}
+
+int CountMin::save(FILE* file) const {
+  if (!put(file, _total) ||
+      fwrite(_counters.data(), sizeof(_counters[0]), _counters.size(), file) != _counters.size() ||
+      !put(file, (unsigned int)_heap.size()))
+    return 1;
+  for (HeapEntry const& e : _heap)
+    if (!put(file, e.first) || !put(file, (unsigned int)e.second.size()) ||
+	fwrite(e.second.data(), 1, e.second.size(), file) != e.second.size())
+      return 1;
+  return 0;
+}
+
+int CountMin::load(FILE* file) {
+  unsigned int size;
+  if (!get(file, _total) ||
+      fread(_counters.data(), sizeof(_counters[0]), _counters.size(), file) != _counters.size() ||
+      !get(file, size))
+    return 1;
+
+  _heap.clear();
+  for (unsigned int i = 0; i < size; ++i) {
+    unsigned long long estimate;
+    unsigned int length;
+    if (!get(file, estimate) || !get(file, length) || length > 1024)
+      return 1;
+    std::string key(length, 0);
+    if (fread(&key[0], 1, length, file) != length)
+      return 1;
+    offer(key, estimate);
+  }
+  return 0;
+}
+
+/*
+  t-digest, merging variant: values are buffered then merged into the centroids,
+  a centroid may only grow up to 4 * n * q * (1 - q) / compression
+*/
+
+TDigest::TDigest(double compression)
+  : _compression(compression),
+    _count(0)
+{
+}
+
+void TDigest::add(double value, double weight) {
+  _buffer.push_back({value, weight});
+  _count += weight;
+  if (_buffer.size() >= 8 * _compression)
+    compress();
+}
+
+void TDigest::compress() const {
+  if (_buffer.empty())
+    return;
+
+  _buffer.insert(_buffer.end(), _centroids.begin(), _centroids.end());
+  std::sort(_buffer.begin(), _buffer.end());
+  _centroids.clear();
+
+  double seen = 0;
+  Centroid current = _buffer[0];
+  for (size_t i = 1; i < _buffer.size(); ++i) {
+    Centroid const& c = _buffer[i];
+    double q = (seen + current.weight + c.weight / 2) / _count;
+    double limit = std::max(1.0, 4 * _count * q * (1 - q) / _compression);
+
+    if (current.weight + c.weight <= limit) {
+      current.mean += (c.mean - current.mean) * c.weight / (current.weight + c.weight);
+      current.weight += c.weight;
+    }
+    else {
+      seen += current.weight;
+      _centroids.push_back(current);
+      current = c;
+    }
+  }
+  _centroids.push_back(current);
+  _buffer.clear();
+}
+
+void TDigest::merge(TDigest const& other) {
+  other.compress();
+  for (Centroid const& c : other._centroids)
+    add(c.mean, c.weight);
+}
+
+double TDigest::count() const {
+  return _count;
+}
+
+// Linear interpolation between the centres of the centroids
+double TDigest::quantile(double q) const {
+  compress();
+  if (_centroids.empty())
+    return 0;
+  if (_centroids.size() == 1)
+    return _centroids[0].mean;
+
+  double target = q * _count;
+  double seen = 0;
+  for (size_t i = 0; i < _centroids.size(); ++i) {
+    double centre = seen + _centroids[i].weight / 2;
+    if (target <= centre) {
+      if (i == 0)
+	return _centroids[0].mean;
+      double previous = centre - (_centroids[i - 1].weight + _centroids[i].weight) / 2;
+      double t = (target - previous) / (centre - previous);
+      return _centroids[i - 1].mean + t * (_centroids[i].mean - _centroids[i - 1].mean);
+    }
+    seen += _centroids[i].weight;
+  }
+  return _centroids.back().mean;
+}
+
+int TDigest::save(FILE* file) const {
+  compress();
+  if (!put(file, _compression) || !put(file, (unsigned int)_centroids.size()))
+    return 1;
+  for (Centroid const& c : _centroids)
+    if (!put(file, c.mean) || !put(file, c.weight))
+      return 1;
+  return 0;
+}
+
+int TDigest::load(FILE* file) {
+  unsigned int size;
+  if (!get(file, _compression) || !get(file, size))
+    return 1;
+
+  _centroids.clear();
+  _buffer.clear();
+  _count = 0;
+  for (unsigned int i = 0; i < size; ++i) {
+    Centroid c;
+    if (!get(file, c.mean) || !get(file, c.weight))
+      return 1;
+    _centroids.push_back(c);
+    _count += c.weight;
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __SKETCHES_HH__
+# define __SKETCHES_HH__
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iostream>
+
+/* Constant memory summaries of a stream, mergeable with another summary of the same kind.
+   save and load use the host byte order, save returns 1 on a failed write and load on a truncated or foreign file.
+*/
+
+// Distinct count, about 0.8% standard error
+class HyperLogLog {
+
+public:
+  HyperLogLog();
+
+public:
+  void add(unsigned long long hash);
+  void merge(HyperLogLog const& other);
+  double estimate() const;
+
+  int save(FILE* file) const;
+  int load(FILE* file);
+
+private:
+  static const int _PRECISION = 14;
+  static const size_t _REGISTERS = 1 << _PRECISION;
+
+  std::vector<unsigned char> _registers;
+};
+
+// Frequency of keys, never under-estimated, with the most frequent keys kept aside
+class CountMin {
+
+public:
+  CountMin(size_t top = 20);
+
+public:
+  // Returns the new estimate of the key
+  unsigned long long add(std::string const& key, unsigned long long count = 1);
+  unsigned long long estimate(std::string const& key) const;
+  void merge(CountMin const& other);
+  unsigned long long total() const;
+
+  // Most frequent keys first
+  std::vector<std::pair<std::string, unsigned long long> > top() const;
+
+  int save(FILE* file) const;
+  int load(FILE* file);
+
+private:
+  void offer(std::string const& key, unsigned long long estimate);
+
+private:
+  static const size_t _DEPTH = 4;
+  static const size_t _WIDTH = 4096;
+
+  std::vector<unsigned long long> _counters; // _DEPTH rows of _WIDTH
+  unsigned long long _total;
+  size_t _k;
+  std::vector<std::pair<unsigned long long, std::string> > _heap; // Min-heap on the estimate
+};
+
+// Quantiles of a stream of values, more precise at the tails
+class TDigest {
+
+public:
+  TDigest(double compression = 100);
+
+public:
+  void add(double value, double weight = 1);
+  void merge(TDigest const& other);
+  double quantile(double q) const;
+  double count() const;
+
+  int save(FILE* file) const;
+  int load(FILE* file);
+
+private:
+  struct Centroid {
+    double mean;
+    double weight;
+
+    bool operator<(Centroid const& other) const { return mean < other.mean; }
+  };
+
+  void compress() const;
+
+private:
+  double _compression;
+  mutable std::vector<Centroid> _centroids;
+  mutable std::vector<Centroid> _buffer; // Not merged yet
+  mutable double _count;
+};
+
+#endif // __SKETCHES_HH__
@@ -0,0 +1,149 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <iomanip>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "stageprofile.hh"
+
+bool StageProfile::_enabled = false;
+int StageProfile::_fds[COUNTER_COUNT] = {-1, -1, -1, -1};
+int StageProfile::_leader = -1;
+unsigned long long StageProfile::_calls[STAGE_COUNT];
+unsigned long long StageProfile::_totals[STAGE_COUNT][1 + COUNTER_COUNT];
+
+static char const* const STAGE_NAMES[] = {
+  "getAll", "extractAppResponse", "extractBaseRecords", "paylog decode", "formatting"
+};
+
+static int openCounter(unsigned long long config, int group) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.exclude_kernel = 1; // Allowed at perf_event_paranoid 2
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+void StageProfile::start() {
+  unsigned long long const configs[COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+  };
+  char const* names[COUNTER_COUNT] = {"cycles", "instructions", "branch-misses", "cache-misses"};
+
+  // The first event that opens leads the group, so all are read with one read()
+  for (int c = 0; c < COUNTER_COUNT; ++c) {
+    _fds[c] = openCounter(configs[c], _leader);
+    if (_fds[c] < 0)
+      std::cerr << "Counter " << names[c] << " unavailable: " << strerror(errno) << std::endl;
+    else if (_leader < 0)
+      _leader = _fds[c];
+  }
+  if (_leader < 0)
+    std::cerr << "No hardware counter, stage times only" << std::endl;
+
+  memset(_calls, 0, sizeof(_calls));
+  memset(_totals, 0, sizeof(_totals));
+  _enabled = true;
+}
+
+void StageProfile::sample(unsigned long long* values) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  values[0] = now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+  unsigned long long group[1 + COUNTER_COUNT] = {0};
+  if (_leader < 0 || read(_leader, group, sizeof(group)) < (ssize_t)sizeof(*group)) {
+    memset(values + 1, 0, COUNTER_COUNT * sizeof(*values));
+    return;
+  }
+  // Values come in the order the events joined the group
+  for (int c = 0, n = 0; c < COUNTER_COUNT; ++c)
+    values[1 + c] = _fds[c] >= 0 && (unsigned long long)n < group[0] ? group[1 + n++] : 0;
+}
+
+StageProfile::Scope::Scope(Stage stage)
+  : _stage(stage) {
+  if (_enabled)
+    sample(_start);
+}
+
+StageProfile::Scope::~Scope() {
+  if (!_enabled)
+    return;
+  unsigned long long end[1 + COUNTER_COUNT];
+  sample(end);
+  _calls[_stage]++;
+  for (int v = 0; v <= COUNTER_COUNT; ++v)
+    _totals[_stage][v] += end[v] - _start[v];
+}
+
+// Per call averages, IPC and misses per thousand instructions
+void StageProfile::print(std::ostream& out) {
+  bool instructions = _fds[INSTRUCTIONS] >= 0;
+
+  out << "-- Stage profile --" << std::endl;
+  out << std::left << std::setw(20) << "stage" << std::right << std::setw(10) << "calls" << std::setw(12) << "ns/call"
+      << std::setw(14) << "cycles/call" << std::setw(14) << "instr/call" << std::setw(8) << "IPC"
+      << std::setw(12) << "br-miss/ki" << std::setw(12) << "$-miss/ki" << std::endl;
+
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(1);
+  for (int s = 0; s < STAGE_COUNT; ++s) {
+    unsigned long long const* t = _totals[s];
+    double calls = _calls[s] ? _calls[s] : 1;
+    out << std::left << std::setw(20) << STAGE_NAMES[s] << std::right << std::setw(10) << _calls[s]
+	<< std::setw(12) << t[0] / calls;
+
+    double const per[] = {
+      t[1 + CYCLES] / calls,
+      t[1 + INSTRUCTIONS] / calls,
+      t[1 + CYCLES] ? (double)t[1 + INSTRUCTIONS] / t[1 + CYCLES] : 0,
+      t[1 + INSTRUCTIONS] ? t[1 + BRANCH_MISSES] * 1000.0 / t[1 + INSTRUCTIONS] : 0,
+      t[1 + INSTRUCTIONS] ? t[1 + CACHE_MISSES] * 1000.0 / t[1 + INSTRUCTIONS] : 0
+    };
+    bool const available[] = {
+      _fds[CYCLES] >= 0, instructions, _fds[CYCLES] >= 0 && instructions,
+      _fds[BRANCH_MISSES] >= 0 && instructions, _fds[CACHE_MISSES] >= 0 && instructions
+    };
+    int const widths[] = {14, 14, 8, 12, 12};
+    out << std::setprecision(2);
+    for (size_t i = 0; i < sizeof(per) / sizeof(*per); ++i) {
+      out << std::setw(widths[i]);
+      if (available[i])
+	out << per[i];
+      else
+	out << "n/a";
+    }
+    out << std::setprecision(1) << std::endl;
+  }
+  out.unsetf(std::ios::floatfield);
+  out.precision(precision);
+}
@@ -0,0 +1,76 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+
+#ifndef __STAGEPROFILE_HH__
+# define __STAGEPROFILE_HH__
+
+#include <iostream>
+
+/* Time and hardware counters (perf_event_open: cycles, instructions, branch misses, cache misses,
+   user space only) spent in each stage of a card read, for --perf-stages. Counters are opened for
+   the calling thread by start(); the stages must run on that thread. An event the kernel or the CPU
+   does not offer is left out, and without any counter only the times are reported.
+   When profiling is off, a Scope costs a test of a flag.
+*/
+class StageProfile {
+
+public:
+  enum Stage {
+    GET_ALL,
+    EXTRACT_APP_RESPONSE,
+    EXTRACT_BASE_RECORDS,
+    PAYLOG_DECODE,
+    FORMATTING,
+    STAGE_COUNT
+  };
+
+  // Counts what runs between its construction and its destruction
+  class Scope {
+  public:
+    Scope(Stage stage);
+    ~Scope();
+
+  private:
+    Stage _stage;
+    unsigned long long _start[5]; // Time, then the counters
+  };
+
+public:
+  static void start();
+  static bool enabled() { return _enabled; }
+  static void print(std::ostream& out = std::cout);
+
+private:
+  static void sample(unsigned long long* values);
+
+private:
+  enum Counter { CYCLES, INSTRUCTIONS, BRANCH_MISSES, CACHE_MISSES, COUNTER_COUNT };
+
+  static bool _enabled;
+  static int _fds[COUNTER_COUNT]; // -1 when the event could not be opened
+  static int _leader;
+  static unsigned long long _calls[STAGE_COUNT];
+  static unsigned long long _totals[STAGE_COUNT][1 + COUNTER_COUNT];
+};
+
+#endif // __STAGEPROFILE_HH__
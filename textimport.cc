@@ -0,0 +1,451 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <chrono>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "textimport.hh"
+#include "workpool.hh"
+
+char const* const TextImport::MARKER = "========================= NEW CARD =====";
+
+struct TextFile {
+  char const* path;
+  char const* data;
+  size_t size;
+};
+
+struct TextChunk {
+  size_t file;
+  size_t begin;
+  size_t end;
+};
+
+static int mapFile(TextFile& file) {
+  file.data = NULL;
+  file.size = 0;
+
+  int fd = open(file.path, O_RDONLY);
+  if (fd < 0) {
+    perror(file.path);
+    return 1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    perror(file.path);
+    close(fd);
+    return 1;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(file.path);
+    return 1;
+  }
+
+  madvise(map, st.st_size, MADV_WILLNEED);
+  file.data = (char const*)map;
+  file.size = st.st_size;
+  return 0;
+}
+
+static bool startsWith(char const* line, char const* eol, char const* prefix, size_t length) {
+  return (size_t)(eol - line) >= length && !memcmp(line, prefix, length);
+}
+
+// Value of the "Key: value" line, NULL if the line is another key
+static char const* value(char const* line, char const* eol, char const* key) {
+  size_t length = strlen(key);
+  if (!startsWith(line, eol, key, length) || eol - line < (long)length + 2 ||
+      line[length] != ':' || line[length + 1] != ' ')
+    return NULL;
+  return line + length + 2;
+}
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+// Reads up to digits hex digits
+static unsigned hexValue(char const*& p, char const* end, size_t digits) {
+  unsigned value = 0;
+  for (int d; digits > 0 && p < end && (d = hexDigit(*p)) >= 0; --digits, ++p)
+    value = value << 4 | d;
+  return value;
+}
+
+// Reads "XX<separator>XX<separator>XX" into 3 BCD bytes
+static void bcdTriplet(char const* p, char const* end, byte_t* out) {
+  for (size_t i = 0; i < 3; ++i) {
+    out[i] = hexValue(p, end, 2);
+    if (p < end)
+      ++p;
+  }
+}
+
+// Known name or 4 hex digits, as printed
+static unsigned short code(char const* p, char const* end, unsigned short (*lookup)(char const*, size_t)) {
+  unsigned short c = lookup(p, end - p);
+  return c ? c : hexValue(p, end, 4);
+}
+
+// A field ends on "; " followed by the end of the line or by another field name
+static char const* fieldEnd(char const* p, char const* end) {
+  for (; p + 1 < end; ++p) {
+    if (p[0] != ';' || p[1] != ' ')
+      continue;
+    char const* next = p + 2;
+    if (next >= end)
+      return p;
+    char const* colon = (char const*)memchr(next, ':', end - next);
+    if (colon && CCInfo::logFieldTag(next, colon - next))
+      return p;
+  }
+  return end;
+}
+
+// Line printed by CCInfo::printPaylog: "index: Name: value; Name: value; ..."
+bool TextImport::parsePaylogEntry(char const* line, char const* end, PaylogEntry& entry) {
+  memset(&entry, 0, sizeof(entry));
+
+  char const* p = line;
+  while (p < end && isdigit(*p))
+    ++p;
+  if (p == line || end - p < 2 || p[0] != ':' || p[1] != ' ')
+    return false;
+  p += 2;
+
+  while (p < end) {
+    char const* colon = (char const*)memchr(p, ':', end - p);
+    if (colon == NULL || end - colon < 2)
+      return false;
+    unsigned short tag = CCInfo::logFieldTag(p, colon - p);
+    char const* v = colon + 2;
+    char const* e = fieldEnd(v, end);
+
+    switch (tag) {
+    case 0x9A: // Date, 20YY/MM/DD
+      bcdTriplet(v + 2 < e ? v + 2 : e, e, entry.date);
+      break;
+    case 0x9F21: // Time, HH:MM:SS
+      bcdTriplet(v, e, entry.time);
+      break;
+    case 0x9F02: { // Amount: BCD digits, the last byte after a dot
+      byte_t nibbles[2 * sizeof(entry.amount)] = {0};
+      size_t count = 0;
+      for (char const* c = v; c < e; ++c) {
+	int d = hexDigit(*c);
+	if (d < 0)
+	  continue;
+	memmove(nibbles, nibbles + 1, sizeof(nibbles) - 1);
+	nibbles[sizeof(nibbles) - 1] = d;
+	++count;
+      }
+      for (size_t j = 0; j < sizeof(entry.amount); ++j) {
+	entry.amount[j] = nibbles[2 * j] << 4 | nibbles[2 * j + 1];
+	entry.amountValue = entry.amountValue * 100 + nibbles[2 * j] * 10 + nibbles[2 * j + 1];
+      }
+      break;
+    }
+    case 0x5F2A: // Currency
+      entry.currency = code(v, e, CCInfo::currencyCode);
+      entry.currencyName = CCInfo::currencyName(entry.currency);
+      break;
+    case 0x9F1A: // Terminal country code
+      entry.country = code(v, e, CCInfo::countryCode);
+      entry.countryName = CCInfo::countryName(entry.country);
+      break;
+    case 0x9C: // Type
+      entry.type = startsWith(v, e, "Withdrawal", 10) ? 1 : 0;
+      break;
+    case 0x9F36: // Counter
+      entry.counter = hexValue(v, e, 4);
+      break;
+    case 0x9F27: // Crypto info data
+      entry.cryptoInfo = hexValue(v, e, 2);
+      break;
+    case 0x9F4E: // Merchant
+      entry.merchantLength = std::min<size_t>(e - v, sizeof(entry.merchant) - 1);
+      memcpy(entry.merchant, v, entry.merchantLength);
+      break;
+    default: // Unknown field, ignored
+      break;
+    }
+    p = e + 2;
+  }
+  return true;
+}
+
+// Cards start on the marker, anything before the first one is ignored
+void TextImport::parse(char const* begin, char const* end, size_t base, std::vector<ImportedCard>& cards) {
+  size_t markerLength = strlen(MARKER);
+  ImportedCard* card = NULL;
+  ImportedApp* app = NULL;
+  bool paylog = false;
+  char const* next;
+
+  for (char const* line = begin; line < end; line = next) {
+    char const* eol = (char const*)memchr(line, '\n', end - line);
+    next = eol ? eol + 1 : end;
+    if (eol == NULL)
+      eol = end;
+    if (eol > line && eol[-1] == '\r')
+      --eol;
+
+    if (startsWith(line, eol, MARKER, markerLength)) {
+      cards.push_back(ImportedCard());
+      card = &cards.back();
+      card->offset = base + (line - begin);
+      app = NULL;
+      paylog = false;
+      continue;
+    }
+    if (card == NULL)
+      continue;
+
+    if (startsWith(line, eol, "-- Application --", 17)) {
+      card->apps.push_back(ImportedApp());
+      app = &card->apps.back();
+      app->priority = 0;
+      app->logCount = 0;
+      memset(&app->tracks, 0, sizeof(app->tracks));
+      paylog = false;
+      continue;
+    }
+    if (app == NULL)
+      continue;
+
+    char const* v;
+    if (startsWith(line, eol, "-- Paylog --", 12))
+      paylog = true;
+    else if (startsWith(line, eol, "-- Records --", 13))
+      paylog = false;
+    else if (paylog && line < eol && isdigit(*line)) {
+      app->paylog.push_back(PaylogEntry());
+      if (!parsePaylogEntry(line, eol, app->paylog.back()))
+	app->paylog.pop_back();
+    }
+    else if ((v = value(line, eol, "Name")))
+      app->name.assign(v, eol);
+    else if ((v = value(line, eol, "Priority")) && v < eol)
+      app->priority = *v - '0';
+    else if ((v = value(line, eol, "AID")))
+      app->aid.assign(v, eol);
+    else if ((v = value(line, eol, "Language Preference")))
+      app->languagePreference.assign(v, eol);
+    else if ((v = value(line, eol, "Cardholder Name")))
+      app->cardholderName.assign(v, eol);
+    else if ((v = value(line, eol, "Track 1 Discretionary data")))
+      app->track1.assign(v, eol);
+    else if ((v = value(line, eol, "Track 2 equivalent data"))) { // The PAN is what comes before the D
+      app->track2.assign(v, eol);
+      size_t n = 0;
+      for (; v < eol && isdigit(*v) && n < sizeof(app->tracks.pan) - 1; ++v)
+	app->tracks.pan[n++] = *v;
+      app->tracks.pan[n] = 0;
+    }
+    else if ((v = value(line, eol, "PAN")) && app->track2.empty()) {
+      // Digits in groups of 4. Legacy dumps of PANs that are not 16 digits long run on into the
+      // separator and the expiry date, so this line is only used without track 2
+      size_t n = 0;
+      for (; v < eol && n < sizeof(app->tracks.pan) - 1; ++v)
+	if (isdigit(*v))
+	  app->tracks.pan[n++] = *v;
+      app->tracks.pan[n] = 0;
+    }
+    else if ((v = value(line, eol, "Expiry date"))) { // MM/20YY
+      app->tracks.expiryMonth = hexValue(v, eol, 2);
+      v += std::min<long>(3, eol - v); // "/20"
+      app->tracks.expiryYear = hexValue(v, eol, 2);
+    }
+    else if ((v = value(line, eol, "Log count")))
+      app->logCount = atoi(std::string(v, eol).c_str());
+  }
+}
+
+static void appendHex(std::string& out, unsigned value, size_t digits) {
+  static char const hex[] = "0123456789ABCDEF";
+  while (digits-- > 0)
+    out += hex[(value >> (4 * digits)) & 0x0F];
+}
+
+// Tabs and line breaks would split the record
+static void appendText(std::string& out, char const* text, size_t length) {
+  for (size_t i = 0; i < length; ++i)
+    out += text[i] == '\t' || text[i] == '\n' || text[i] == '\r' ? ' ' : text[i];
+}
+
+static void appendText(std::string& out, std::string const& text) {
+  appendText(out, text.data(), text.size());
+}
+
+void TextImport::write(ImportedCard const& card, std::string& out) {
+  std::string offset = std::to_string(card.offset);
+
+  out += "C\t" + offset + "\t" + std::to_string(card.apps.size()) + "\n";
+
+  for (ImportedApp const& app : card.apps) {
+    out += "A\t" + offset + "\t" + std::to_string(app.priority) + "\t";
+    appendText(out, app.name);
+    out += "\t";
+    appendText(out, app.aid);
+    out += "\t";
+    appendText(out, app.languagePreference);
+    out += "\t";
+    appendText(out, app.cardholderName);
+    out += "\t";
+    out += app.tracks.pan;
+    out += "\t";
+    appendHex(out, app.tracks.expiryMonth, 2);
+    out += "/20";
+    appendHex(out, app.tracks.expiryYear, 2);
+    out += "\t" + app.track1 + "\t" + app.track2 + "\t" + std::to_string(app.logCount) + "\n";
+  }
+
+  for (ImportedApp const& app : card.apps) {
+    for (size_t i = 0; i < app.paylog.size(); ++i) {
+      PaylogEntry const& e = app.paylog[i];
+
+      out += "L\t" + offset + "\t" + std::to_string(app.priority) + "\t" + std::to_string(i) + "\t20";
+      appendHex(out, e.date[0], 2);
+      out += "-";
+      appendHex(out, e.date[1], 2);
+      out += "-";
+      appendHex(out, e.date[2], 2);
+      out += "\t";
+      appendHex(out, e.time[0], 2);
+      out += ":";
+      appendHex(out, e.time[1], 2);
+      out += ":";
+      appendHex(out, e.time[2], 2);
+      out += "\t" + std::to_string(e.amountValue) + "\t";
+      if (e.currencyName)
+	out += e.currencyName;
+      else
+	appendHex(out, e.currency, 4);
+      out += "\t";
+      if (e.countryName)
+	out += e.countryName;
+      else
+	appendHex(out, e.country, 4);
+      out += "\t" + std::to_string(e.type) + "\t";
+      appendHex(out, e.counter, 4);
+      out += "\t";
+      appendHex(out, e.cryptoInfo, 2);
+      out += "\t";
+      appendText(out, e.merchant, e.merchantLength);
+      out += "\n";
+    }
+  }
+}
+
+int TextImport::import(std::vector<char const*> const& paths, unsigned threads, std::ostream& out) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<TextFile> files(paths.size());
+  std::vector<TextChunk> chunks;
+  int ret = 0;
+
+  // Chunks end right before the first NEW CARD line found after _CHUNK_BYTES
+  std::string needle = std::string("\n") + MARKER;
+  size_t bytes = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    files[i].path = paths[i];
+    if (mapFile(files[i])) {
+      ret = 1;
+      continue;
+    }
+    bytes += files[i].size;
+
+    for (size_t begin = 0; begin < files[i].size; ) {
+      size_t end = files[i].size;
+      if (begin + _CHUNK_BYTES < end) {
+	void const* found = memmem(files[i].data + begin + _CHUNK_BYTES, end - begin - _CHUNK_BYTES,
+				   needle.data(), needle.size());
+	if (found)
+	  end = (char const*)found - files[i].data + 1;
+      }
+      TextChunk c = {i, begin, end};
+      chunks.push_back(c);
+      begin = end;
+    }
+  }
+
+  if (threads < 1)
+    threads = 1;
+  std::vector<size_t> cards(threads, 0);
+  std::vector<size_t> entries(threads, 0);
+
+  WorkPool::run(chunks.size(), threads,
+		[&] (size_t chunk, unsigned thread, ChunkOutput& output) {
+		  TextChunk const& c = chunks[chunk];
+		  std::vector<ImportedCard> parsed;
+		  parse(files[c.file].data + c.begin, files[c.file].data + c.end, c.begin, parsed);
+
+		  for (ImportedCard const& card : parsed) {
+		    write(card, output.out);
+		    for (ImportedApp const& app : card.apps)
+		      entries[thread] += app.paylog.size();
+		  }
+		  cards[thread] += parsed.size();
+		},
+		[&] (size_t chunk, ChunkOutput& output) {
+		  if (chunks[chunk].begin == 0)
+		    out << "F\t" << files[chunks[chunk].file].path << "\n";
+		  out << output.out;
+		});
+  out.flush();
+
+  size_t totalCards = 0;
+  size_t totalEntries = 0;
+  for (unsigned i = 0; i < threads; ++i) {
+    totalCards += cards[i];
+    totalEntries += entries[i];
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << totalCards << " card(s), " << totalEntries << " paylog entries imported from "
+	    << bytes / 1e6 << " MB in " << elapsed << "s ("
+	    << (elapsed > 0 ? bytes / 1e6 / elapsed : 0) << " MB/s)" << std::endl;
+
+  for (TextFile const& file : files)
+    if (file.data)
+      munmap((void*)file.data, file.size);
+  return ret;
+}
@@ -0,0 +1,75 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __TEXTIMPORT_HH__
+# define __TEXTIMPORT_HH__
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "ccinfo.hh"
+
+// One application as printed by CCInfo::printAll
+struct ImportedApp {
+  std::string name;
+  byte_t priority;
+  std::string aid; // Hex, as printed
+  std::string languagePreference;
+  std::string cardholderName;
+  std::string track1; // Hex
+  std::string track2; // Hex
+  Track2 tracks; // PAN and expiry date
+  int logCount;
+  std::vector<PaylogEntry> paylog;
+};
+
+struct ImportedCard {
+  size_t offset; // Of the NEW CARD line in the dump
+  std::vector<ImportedApp> apps;
+};
+
+/* Parses the text dumps of readcc (standard output redirected to a file) back into cards.
+   Files are mapped, cut into chunks starting on a NEW CARD line and parsed in one pass on a WorkPool.
+   Records are written as tab separated lines, in the order of the files:
+     F  path
+     C  offset  application count
+     A  offset  priority  name  AID  language  cardholder  PAN  expiry  track 1  track 2  log count
+     L  offset  priority  index  date  time  amount  currency  country  type  counter  crypto info  merchant
+   offset identifies the card in its file, amounts are in minor units.
+*/
+class TextImport {
+
+public:
+  static int import(std::vector<char const*> const& paths, unsigned threads, std::ostream& out = std::cout);
+
+  static void parse(char const* begin, char const* end, size_t base, std::vector<ImportedCard>& cards);
+  static bool parsePaylogEntry(char const* line, char const* end, PaylogEntry& entry);
+  static void write(ImportedCard const& card, std::string& out);
+
+  static char const* const MARKER;
+
+private:
+  static const size_t _CHUNK_BYTES = 4 << 20;
+};
+
+#endif // __TEXTIMPORT_HH__
@@ -0,0 +1,444 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <queue>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "timeindex.hh"
+#include "apdufile.hh"
+#include "paylogscan.hh"
+
+const char TimeIndex::_MAGIC[8] = {'R', 'C', 'C', 'T', 'I', 'D', 'X', '1'};
+
+struct RunHeader {
+  char magic[8];
+  unsigned long long count;
+  unsigned long long pages;
+};
+
+struct TimeIndex::Run {
+  void* map;
+  size_t size;
+  TimeIndexEntry const* entries;
+  unsigned long long count;
+  long long const* fences; // Time of the first entry of each page
+  unsigned long long pages;
+};
+
+TimeIndex::TimeIndex()
+  : _indexed(0),
+    _scanned(0)
+{
+}
+
+TimeIndex::~TimeIndex() {
+  closeRuns();
+}
+
+std::string TimeIndex::runPath(unsigned id) const {
+  std::ostringstream path;
+  path << _directory << "/run-" << id << ".idx";
+  return path.str();
+}
+
+// Creates the index of capture if the directory holds none
+int TimeIndex::open(char const* directory, char const* capture) {
+  _directory = directory;
+  if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+    perror(directory);
+    return 1;
+  }
+
+  std::ifstream meta((_directory + "/meta").c_str());
+  if (meta) {
+    std::string key;
+    unsigned id;
+    while (meta >> key) {
+      if (key == "capture")
+	std::getline(meta >> std::ws, _capture);
+      else if (key == "indexed")
+	meta >> _indexed;
+      else if (key == "runs")
+	while (meta.peek() != '\n' && meta >> id)
+	  _runIds.push_back(id);
+    }
+    if (capture && _capture != capture) {
+      std::cerr << directory << ": index of " << _capture << ", not of " << capture << std::endl;
+      return 1;
+    }
+  }
+  else if (capture)
+    _capture = capture;
+  else {
+    std::cerr << directory << ": no time index" << std::endl;
+    return 1;
+  }
+
+  _scanned = _indexed;
+  return openRuns();
+}
+
+// Written to a temporary file then renamed, the runs it names are always complete
+int TimeIndex::saveMeta() const {
+  std::string path = _directory + "/meta";
+  {
+    std::ofstream meta((path + ".tmp").c_str());
+    meta << "capture " << _capture << std::endl;
+    meta << "indexed " << _indexed << std::endl;
+    meta << "runs";
+    for (unsigned id : _runIds)
+      meta << " " << id;
+    meta << std::endl;
+    meta.close();
+    if (!meta) {
+      perror(path.c_str());
+      return 1;
+    }
+  }
+  if (rename((path + ".tmp").c_str(), path.c_str()) != 0) {
+    perror(path.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int TimeIndex::openRuns() {
+  closeRuns();
+  for (unsigned id : _runIds) {
+    std::string path = runPath(id);
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      perror(path.c_str());
+      if (fd >= 0)
+	::close(fd);
+      return 1;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+      perror(path.c_str());
+      return 1;
+    }
+
+    // Range scans jump to the right page
+    madvise(map, st.st_size, MADV_RANDOM);
+    RunHeader const* header = (RunHeader const*)map;
+    Run* run = new Run;
+    run->map = map;
+    run->size = st.st_size;
+    _runs.push_back(run);
+    if ((size_t)st.st_size < sizeof(RunHeader) || memcmp(header->magic, _MAGIC, sizeof(_MAGIC)) ||
+	sizeof(RunHeader) + header->count * sizeof(TimeIndexEntry) + header->pages * sizeof(long long) != (size_t)st.st_size) {
+      std::cerr << path << ": not a time index run" << std::endl;
+      return 1;
+    }
+    run->count = header->count;
+    run->pages = header->pages;
+    run->entries = (TimeIndexEntry const*)(header + 1);
+    run->fences = (long long const*)(run->entries + run->count);
+  }
+  return 0;
+}
+
+void TimeIndex::closeRuns() {
+  for (Run* run : _runs) {
+    munmap(run->map, run->size);
+    delete run;
+  }
+  _runs.clear();
+}
+
+// Runs are written to PATH.tmp, then moved in place once complete
+static FILE* createRun(std::string const& path) {
+  FILE* file = fopen((path + ".tmp").c_str(), "wb");
+  if (file == NULL)
+    perror((path + ".tmp").c_str());
+  return file;
+}
+
+// A run that could not be written whole is removed, a query never sees it
+static int commitRun(FILE* file, std::string const& path, bool written) {
+  std::string tmp = path + ".tmp";
+  if (fclose(file) != 0 || !written || rename(tmp.c_str(), path.c_str()) != 0) {
+    perror(path.c_str());
+    unlink(tmp.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+// Writes sorted entries as run id
+int TimeIndex::writeRun(std::vector<TimeIndexEntry> const& entries, unsigned id) const {
+  std::string path = runPath(id);
+  FILE* file = createRun(path);
+  if (file == NULL)
+    return 1;
+
+  RunHeader header;
+  memcpy(header.magic, _MAGIC, sizeof(_MAGIC));
+  header.count = entries.size();
+  header.pages = (entries.size() + _PAGE_ENTRIES - 1) / _PAGE_ENTRIES;
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1
+    && fwrite(entries.data(), sizeof(TimeIndexEntry), entries.size(), file) == entries.size();
+  for (size_t i = 0; written && i < entries.size(); i += _PAGE_ENTRIES)
+    written = fwrite(&entries[i].time, sizeof(entries[i].time), 1, file) == 1;
+
+  return commitRun(file, path, written);
+}
+
+// Indexes the sessions appended to the capture since the last update
+int TimeIndex::update() {
+  ApduFile capture;
+  if (capture.open(_capture.c_str()))
+    return 1;
+
+  capture.seek(_scanned);
+  std::vector<PaylogEntry> entries;
+  byte_t const* session;
+  size_t size;
+  for (size_t offset = capture.tell(); capture.nextSession(session, size); offset = capture.tell()) {
+    entries.clear();
+    PaylogScan::scan(session, size, entries);
+    for (size_t i = 0; i < entries.size() && i < 0x100; ++i) {
+      long long time = epoch(entries[i]);
+      if (time >= 0)
+	_buffer.push_back({time, (unsigned long long)offset << 8 | i});
+    }
+  }
+  _scanned = capture.tell();
+
+  if (_buffer.size() >= _BUFFER_ENTRIES)
+    return flush();
+  return 0;
+}
+
+// Writes the buffered entries as a new run
+int TimeIndex::flush() {
+  if (_scanned == _indexed)
+    return 0;
+
+  if (!_buffer.empty()) {
+    std::sort(_buffer.begin(), _buffer.end());
+    unsigned id = _runIds.empty() ? 1 : *std::max_element(_runIds.begin(), _runIds.end()) + 1;
+    if (writeRun(_buffer, id))
+      return 1;
+    _runIds.push_back(id);
+    _buffer.clear();
+  }
+  _indexed = _scanned;
+  if (saveMeta())
+    return 1;
+
+  if (_runIds.size() > _MAX_RUNS)
+    return compact();
+  return openRuns();
+}
+
+struct MergeCursor {
+  TimeIndexEntry const* current;
+  TimeIndexEntry const* end;
+
+  bool operator<(MergeCursor const& other) const { return other.current->operator<(*current); }
+};
+
+// Merges every run into one, in pages of entries so memory stays bounded
+int TimeIndex::compact() {
+  if (openRuns())
+    return 1;
+
+  std::priority_queue<MergeCursor> cursors;
+  unsigned long long total = 0;
+  for (Run* run : _runs) {
+    if (run->count)
+      cursors.push({run->entries, run->entries + run->count});
+    total += run->count;
+  }
+
+  unsigned id = *std::max_element(_runIds.begin(), _runIds.end()) + 1;
+  std::string path = runPath(id);
+  FILE* file = createRun(path);
+  if (file == NULL)
+    return 1;
+
+  RunHeader header;
+  memcpy(header.magic, _MAGIC, sizeof(_MAGIC));
+  header.count = total;
+  header.pages = (total + _PAGE_ENTRIES - 1) / _PAGE_ENTRIES;
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  std::vector<long long> fences;
+  std::vector<TimeIndexEntry> page;
+  while (!cursors.empty()) {
+    MergeCursor c = cursors.top();
+    cursors.pop();
+    if (page.empty())
+      fences.push_back(c.current->time);
+    page.push_back(*c.current);
+    if (page.size() == _PAGE_ENTRIES) {
+      written = written && fwrite(page.data(), sizeof(TimeIndexEntry), page.size(), file) == page.size();
+      page.clear();
+    }
+    if (++c.current != c.end)
+      cursors.push(c);
+  }
+  written = written && fwrite(page.data(), sizeof(TimeIndexEntry), page.size(), file) == page.size()
+    && fwrite(fences.data(), sizeof(long long), fences.size(), file) == fences.size();
+  if (commitRun(file, path, written))
+    return 1;
+
+  std::vector<unsigned> old;
+  old.swap(_runIds);
+  _runIds.push_back(id);
+  if (saveMeta())
+    return 1;
+  closeRuns();
+  for (unsigned o : old)
+    unlink(runPath(o).c_str());
+  return openRuns();
+}
+
+// Entries of the runs and of the buffer between from and to included, sorted
+int TimeIndex::scan(long long from, long long to, std::vector<TimeIndexEntry>& entries) const {
+  for (Run const* run : _runs) {
+    // The page before the first one starting at from or later may hold the first entries
+    size_t page = std::lower_bound(run->fences, run->fences + run->pages, from) - run->fences;
+    for (size_t i = (page ? page - 1 : 0) * _PAGE_ENTRIES; i < run->count && run->entries[i].time <= to; ++i)
+      if (run->entries[i].time >= from)
+	entries.push_back(run->entries[i]);
+  }
+  for (TimeIndexEntry const& e : _buffer)
+    if (e.time >= from && e.time <= to)
+      entries.push_back(e);
+
+  std::sort(entries.begin(), entries.end());
+  return 0;
+}
+
+// Entries are decoded again from the capture
+int TimeIndex::print(long long from, long long to, std::ostream& out) const {
+  std::vector<TimeIndexEntry> found;
+  scan(from, to, found);
+
+  ApduFile capture;
+  if (capture.open(_capture.c_str()))
+    return 1;
+
+  std::vector<PaylogEntry> entries;
+  unsigned long long current = 0;
+  for (TimeIndexEntry const& f : found) {
+    unsigned long long offset = f.location >> 8;
+    size_t index = f.location & 0xFF;
+
+    if (offset != current || entries.empty()) {
+      byte_t const* session;
+      size_t size;
+      entries.clear();
+      capture.seek(offset);
+      if (capture.nextSession(session, size))
+	PaylogScan::scan(session, size, entries);
+      current = offset;
+    }
+    if (index >= entries.size())
+      continue;
+
+    PaylogEntry const& e = entries[index];
+    out << "20" << HEX(e.date[0]) << "/" << HEX(e.date[1]) << "/" << HEX(e.date[2]) << " "
+	<< HEX(e.time[0]) << ":" << HEX(e.time[1]) << ":" << HEX(e.time[2])
+	<< " card@" << offset << " #" << index << ": "
+	<< e.amountValue / 100 << "." << std::setw(2) << std::setfill('0') << e.amountValue % 100 << std::setfill(' ') << " ";
+    if (e.currencyName)
+      out << e.currencyName;
+    else
+      out << HEX((byte_t)(e.currency >> 8)) << HEX((byte_t)e.currency);
+    out << " ";
+    out.write(e.merchant, e.merchantLength);
+    out << std::endl;
+  }
+  std::cerr << found.size() << " entries" << std::endl;
+  return 0;
+}
+
+static int bcd(byte_t b) {
+  return (b >> 4) * 10 + (b & 0x0F);
+}
+
+// -1 without a valid date
+long long TimeIndex::epoch(PaylogEntry const& e) {
+  int year = 2000 + bcd(e.date[0]);
+  int month = bcd(e.date[1]);
+  int day = bcd(e.date[2]);
+  if (month < 1 || month > 12 || day < 1 || day > 31)
+    return -1;
+
+  // Days since 1970-01-01 in the proleptic Gregorian calendar
+  year -= month <= 2;
+  long long era = year / 400;
+  long long yoe = year - era * 400;
+  long long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  long long days = era * 146097 + doe - 719468;
+
+  return days * 86400 + bcd(e.time[0]) * 3600 + bcd(e.time[1]) * 60 + bcd(e.time[2]);
+}
+
+// YYYY-MM-DD, YYYY-MM-DDTHH:MM:SS or seconds since 1970. A day alone is its first second, or its last
+// one for the end of a range, so that the range includes the whole day
+bool TimeIndex::parseTime(char const* text, long long& time, bool rangeEnd) {
+  int year, month, day, hour = 0, minute = 0, second = 0;
+  char separator;
+
+  int fieldCount = sscanf(text, "%d-%d-%d%c%d:%d:%d", &year, &month, &day, &separator, &hour, &minute, &second);
+  if (fieldCount >= 3 && year >= 2000 && year < 2100) {
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59)
+      return false;
+    if (fieldCount < 5 && rangeEnd) {
+      hour = 23;
+      minute = 59;
+      second = 59;
+    }
+    PaylogEntry e;
+    memset(&e, 0, sizeof(e));
+    int const fields[] = {year - 2000, month, day, hour, minute, second};
+    byte_t* bytes[] = {&e.date[0], &e.date[1], &e.date[2], &e.time[0], &e.time[1], &e.time[2]};
+    for (size_t i = 0; i < 6; ++i)
+      *bytes[i] = (fields[i] / 10) << 4 | fields[i] % 10;
+    time = epoch(e);
+    return time >= 0;
+  }
+
+  char* end;
+  time = strtoll(text, &end, 10);
+  return *end == 0 && end != text;
+}
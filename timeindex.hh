@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __TIMEINDEX_HH__
+# define __TIMEINDEX_HH__
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "ccinfo.hh"
+
+struct TimeIndexEntry {
+  long long time; // Seconds since 1970, from 9A and 9F21 (terminal time taken as UTC)
+  unsigned long long location; // Offset of the session in the capture << 8 | entry index
+
+  bool operator<(TimeIndexEntry const& other) const {
+    return time != other.time ? time < other.time : location < other.location;
+  }
+};
+
+/* On-disk time index over the paylog entries of one capture (APDU file), in a directory:
+     meta            capture path and how far it is indexed
+     run-N.idx       sorted run: header, entries, then the time of the first entry of each page
+   New sessions are indexed as the capture grows, in memory, then written as a new run.
+   Past _MAX_RUNS, all runs are merged into one. A range scan binary searches the page times
+   of each run and only reads the pages in the range.
+*/
+class TimeIndex {
+
+public:
+  TimeIndex();
+  ~TimeIndex();
+
+public:
+  int open(char const* directory, char const* capture = NULL);
+  int update();
+  int flush();
+  int scan(long long from, long long to, std::vector<TimeIndexEntry>& entries) const;
+  int print(long long from, long long to, std::ostream& out = std::cout) const;
+
+  static long long epoch(PaylogEntry const& entry);
+  static bool parseTime(char const* text, long long& time, bool rangeEnd = false);
+
+private:
+  struct Run;
+
+  int saveMeta() const;
+  int writeRun(std::vector<TimeIndexEntry> const& entries, unsigned id) const;
+  int compact();
+  void closeRuns();
+  int openRuns();
+  std::string runPath(unsigned id) const;
+
+private:
+  std::string _directory;
+  std::string _capture;
+  unsigned long long _indexed; // Capture offset covered by the runs
+  unsigned long long _scanned; // Capture offset covered by the runs and the buffer
+  std::vector<unsigned> _runIds;
+  std::vector<Run*> _runs;
+  std::vector<TimeIndexEntry> _buffer;
+
+  static const size_t _PAGE_ENTRIES = 256; // 4 KB pages
+  static const size_t _BUFFER_ENTRIES = 1 << 16;
+  static const size_t _MAX_RUNS = 8;
+  static const char _MAGIC[8];
+};
+
+#endif // __TIMEINDEX_HH__
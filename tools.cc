@@ -22,6 +22,17 @@
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+# define TOOLS_X86
+# include <immintrin.h>
+#endif
 
 #include "tools.hh"
 
@@ -52,37 +63,377 @@ const byte_t Command::GET_DATA_LOG_FORMAT[7] = {0x40,0x01,
 						0x9F,0x4F, // 9F4F asks for the log format
 						0x00};
 
+const byte_t Command::GET_RESPONSE[7] = {0x40,0x01,
+					 0x00,0xC0, // GET RESPONSE
+					 0x00,0x00,
+					 0x00}; // Le, edited dynamically
+
 
 /*
   CLASS Tools
 */
 
-void Tools::print(char const* str, std::string const& label) {
-  std::cout << label << ": " << str << std::endl;
+void Tools::print(char const* str, std::string const& label, std::ostream& out) {
+  out << label << ": " << str << std::endl;
 }
 
-void Tools::printHex(APDU const& apdu, std::string const& label) {
-  printHex(apdu.data, apdu.size, label);
+void Tools::printHex(APDU const& apdu, std::string const& label, std::ostream& out) {
+  printHex(apdu.data, apdu.size, label, out);
 }
 
-void Tools::printChar(byte_t const* str, size_t size, std::string const& label) {
+void Tools::printChar(byte_t const* str, size_t size, std::string const& label, std::ostream& out) {
   if (label.size() > 0)
-    std::cout << label << ": ";
+    out << label << ": ";
 
-  for (size_t i = 0; i < size; ++i)
-    std::cout << (isprint((char)str[i]) ? (char)str[i] : '.');
+  char line[256];
+  for (size_t i = 0; i < size; i += sizeof(line)) {
+    size_t n = std::min(size - i, sizeof(line));
+    out.write(line, toPrintable(str + i, n, line) - line);
+  }
 
-  std::cout << std::endl;
+  out << std::endl;
 }
 
-void Tools::printHex(byte_t const* str, size_t size, std::string const& label) {
+void Tools::printHex(byte_t const* str, size_t size, std::string const& label, std::ostream& out) {
   if (label.size() > 0)
-    std::cout << label << ": ";
+    out << label << ": ";
+
+  char line[512];
+  for (size_t i = 0; i < size; i += sizeof(line) / 2) {
+    size_t n = std::min(size - i, sizeof(line) / 2);
+    out.write(line, toHex(str + i, n, line) - line);
+  }
+
+  out << std::endl;
+}
+
+std::ostream& operator<<(std::ostream& out, HexByte h) {
+  char digits[2];
+  Tools::toHex(&h.value, 1, digits);
+  return out.write(digits, 2);
+}
+
+// Sorts the samples. Prints min, usual quantiles and max, divided by unit
+void Tools::printDistribution(char const* label, std::vector<long>& samples, double unit, char const* unitName) {
+  if (samples.empty()) {
+    std::cout << label << ": no sample" << std::endl;
+    return;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  size_t n = samples.size();
+  double const quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  char const* names[] = {"p50", "p90", "p99", "p99.9"};
+
+  std::streamsize precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << label << " (" << unitName << "): min " << samples[0] / unit;
+  for (size_t q = 0; q < sizeof(quantiles) / sizeof(*quantiles); ++q)
+    std::cout << " " << names[q] << " " << samples[(size_t)(quantiles[q] * (n - 1))] / unit;
+  std::cout << " max " << samples[n - 1] / unit << std::endl;
+  std::cout.unsetf(std::ios::floatfield);
+  std::cout.precision(precision);
+}
+
+/*
+  Buffer kernels. Each one has a scalar version, which also finishes the tails, and SSSE3 and AVX2
+  versions compiled with the target attribute, picked at run time from the CPU flags.
+*/
+
+enum KernelLevel { SCALAR, SSSE3, AVX2 };
+
+static char const TOOLS_HEX_DIGITS[] = "0123456789ABCDEF";
+
+static int kernelLevel() {
+#ifdef TOOLS_X86
+  static int const level = __builtin_cpu_supports("avx2") ? AVX2 : __builtin_cpu_supports("ssse3") ? SSSE3 : SCALAR;
+  return level;
+#else
+  return SCALAR;
+#endif
+}
+
+static char* toHexScalar(byte_t const* in, size_t size, char* out) {
+  for (size_t i = 0; i < size; ++i) {
+    *out++ = TOOLS_HEX_DIGITS[in[i] >> 4];
+    *out++ = TOOLS_HEX_DIGITS[in[i] & 0x0F];
+  }
+  return out;
+}
+
+static char* toPrintableScalar(byte_t const* in, size_t size, char* out) {
+  for (size_t i = 0; i < size; ++i)
+    *out++ = in[i] >= 0x20 && in[i] < 0x7F ? in[i] : '.';
+  return out;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c |= 0x20;
+  return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+static size_t fromHexScalar(char const* hex, size_t length, byte_t* out, size_t max) {
+  size_t size = 0;
+
+  for (; size < max && length >= 2; hex += 2, length -= 2) {
+    int hi = hexValue(hex[0]);
+    int lo = hexValue(hex[1]);
+    if (hi < 0 || lo < 0)
+      break;
+    out[size++] = hi << 4 | lo;
+  }
+  return size;
+}
+
+#ifdef TOOLS_X86
+
+__attribute__((target("ssse3")))
+static char* toHexSSSE3(byte_t const* in, size_t size, char* out) {
+  __m128i const digits = _mm_loadu_si128((__m128i const*)TOOLS_HEX_DIGITS);
+  __m128i const low = _mm_set1_epi8(0x0F);
+  size_t i = 0;
+
+  for (; i + 16 <= size; i += 16, out += 32) {
+    __m128i v = _mm_loadu_si128((__m128i const*)(in + i));
+    __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), low));
+    __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, low));
+    _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(hi, lo));
+  }
+  return toHexScalar(in + i, size - i, out);
+}
+
+__attribute__((target("avx2")))
+static char* toHexAVX2(byte_t const* in, size_t size, char* out) {
+  __m256i const digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const*)TOOLS_HEX_DIGITS));
+  __m256i const low = _mm256_set1_epi8(0x0F);
+  size_t i = 0;
+
+  for (; i + 32 <= size; i += 32, out += 64) {
+    __m256i v = _mm256_loadu_si256((__m256i const*)(in + i));
+    __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(v, low));
+    // The unpacks work within each 128 bit lane, the permutes put the lanes back in order
+    __m256i a = _mm256_unpacklo_epi8(hi, lo);
+    __m256i b = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(a, b, 0x20));
+    _mm256_storeu_si256((__m256i*)(out + 32), _mm256_permute2x128_si256(a, b, 0x31));
+  }
+  return toHexSSSE3(in + i, size - i, out);
+}
+
+// Only needs SSE2, signed compares keep 0x20 to 0x7E
+__attribute__((target("ssse3")))
+static char* toPrintableSSSE3(byte_t const* in, size_t size, char* out) {
+  __m128i const space = _mm_set1_epi8(0x1F);
+  __m128i const del = _mm_set1_epi8(0x7F);
+  __m128i const dot = _mm_set1_epi8('.');
+  size_t i = 0;
+
+  for (; i + 16 <= size; i += 16, out += 16) {
+    __m128i v = _mm_loadu_si128((__m128i const*)(in + i));
+    __m128i keep = _mm_and_si128(_mm_cmpgt_epi8(v, space), _mm_cmplt_epi8(v, del));
+    _mm_storeu_si128((__m128i*)out, _mm_or_si128(_mm_and_si128(keep, v), _mm_andnot_si128(keep, dot)));
+  }
+  return toPrintableScalar(in + i, size - i, out);
+}
+
+__attribute__((target("avx2")))
+static char* toPrintableAVX2(byte_t const* in, size_t size, char* out) {
+  __m256i const space = _mm256_set1_epi8(0x1F);
+  __m256i const del = _mm256_set1_epi8(0x7F);
+  __m256i const dot = _mm256_set1_epi8('.');
+  size_t i = 0;
+
+  for (; i + 32 <= size; i += 32, out += 32) {
+    __m256i v = _mm256_loadu_si256((__m256i const*)(in + i));
+    __m256i keep = _mm256_and_si256(_mm256_cmpgt_epi8(v, space), _mm256_cmpgt_epi8(del, v));
+    _mm256_storeu_si256((__m256i*)out, _mm256_blendv_epi8(dot, v, keep));
+  }
+  return toPrintableSSSE3(in + i, size - i, out);
+}
+
+// 16 characters to 8 bytes at a time. A block holding any non hexadecimal character is left to the
+// scalar loop, which stops at the same place as before
+__attribute__((target("ssse3")))
+static size_t fromHexSSSE3(char const* hex, size_t length, byte_t* out, size_t max) {
+  __m128i const zero = _mm_set1_epi8('0' - 1);
+  __m128i const nine = _mm_set1_epi8('9' + 1);
+  __m128i const a = _mm_set1_epi8('a' - 1);
+  __m128i const f = _mm_set1_epi8('f' + 1);
+  __m128i const lower = _mm_set1_epi8(0x20);
+  __m128i const weights = _mm_set1_epi16(0x0110); // 16 for the high digit, 1 for the low one
+  size_t size = 0;
+
+  for (; size + 8 <= max && length >= 16; hex += 16, length -= 16, size += 8) {
+    __m128i v = _mm_loadu_si128((__m128i const*)hex);
+    __m128i l = _mm_or_si128(v, lower);
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, zero), _mm_cmplt_epi8(v, nine));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(l, a), _mm_cmplt_epi8(l, f));
+    if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xFFFF)
+      break;
+
+    __m128i value = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+				 _mm_and_si128(letter, _mm_sub_epi8(l, _mm_set1_epi8('a' - 10))));
+    __m128i pairs = _mm_maddubs_epi16(value, weights);
+    _mm_storel_epi64((__m128i*)(out + size), _mm_packus_epi16(pairs, pairs));
+  }
+  return size + fromHexScalar(hex, length, out + size, max - size);
+}
+
+#endif // TOOLS_X86
+
+char* Tools::toHex(byte_t const* in, size_t size, char* out) {
+#ifdef TOOLS_X86
+  if (size >= 32 && kernelLevel() == AVX2)
+    return toHexAVX2(in, size, out);
+  if (size >= 16 && kernelLevel() >= SSSE3)
+    return toHexSSSE3(in, size, out);
+#endif
+  return toHexScalar(in, size, out);
+}
+
+char* Tools::toPrintable(byte_t const* in, size_t size, char* out) {
+#ifdef TOOLS_X86
+  if (size >= 32 && kernelLevel() == AVX2)
+    return toPrintableAVX2(in, size, out);
+  if (size >= 16 && kernelLevel() >= SSSE3)
+    return toPrintableSSSE3(in, size, out);
+#endif
+  return toPrintableScalar(in, size, out);
+}
+
+// Returns the number of bytes decoded, stops at the first non hexadecimal character
+size_t Tools::fromHex(char const* hex, byte_t* out, size_t max) {
+  // The vector loop may only read what is known to be there
+  size_t length = strnlen(hex, 2 * max);
+
+#ifdef TOOLS_X86
+  if (length >= 16 && kernelLevel() >= SSSE3)
+    return fromHexSSSE3(hex, length, out, max);
+#endif
+  return fromHexScalar(hex, length, out, max);
+}
+
+/*
+  Kernel benchmark: the stream based versions that came before the kernels, against each level the
+  CPU supports, over a buffer of random bytes
+*/
+
+static void legacyPrintHex(byte_t const* str, size_t size, std::ostream& out) {
+  out << std::hex << std::uppercase;
+  for (size_t i = 0; i < size; ++i)
+    out << std::setw(2) << std::setfill('0') << (unsigned int)str[i];
+  out << std::dec;
+}
+
+static void legacyPrintChar(byte_t const* str, size_t size, std::ostream& out) {
+  for (size_t i = 0; i < size; ++i)
+    out << (isprint((char)str[i]) ? (char)str[i] : '.');
+}
+
+static size_t legacyFromHex(char const* hex, byte_t* out, size_t max) {
+  size_t size = 0;
+
+  for (; size < max && isxdigit(hex[0]) && isxdigit(hex[1]); hex += 2) {
+    byte_t hi = isdigit(hex[0]) ? hex[0] - '0' : (toupper(hex[0]) - 'A' + 10);
+    byte_t lo = isdigit(hex[1]) ? hex[1] - '0' : (toupper(hex[1]) - 'A' + 10);
+    out[size++] = hi << 4 | lo;
+  }
+  return size;
+}
+
+// Runs the kernel once per record of the buffer, the record size of a READ RECORD answer
+template <typename Kernel>
+static void benchKernel(char const* name, size_t megabytes, size_t record, Kernel kernel) {
+  size_t const BUFFER = 1 << 20;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (size_t m = 0; m < megabytes; ++m)
+    for (size_t i = 0; i + record <= BUFFER; i += record)
+      kernel(i, record);
+
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << std::left << std::setw(28) << name << std::right << std::setw(10)
+	    << (elapsed > 0 ? megabytes / elapsed : 0) << " MB/s" << std::endl;
+}
+
+int Tools::benchKernels(size_t megabytes) {
+  size_t const BUFFER = 1 << 20;
+  size_t const RECORD = 256;
+  std::vector<byte_t> bytes(BUFFER), decoded(BUFFER);
+  std::vector<char> text(2 * BUFFER + 1);
+  std::mt19937 random(42);
+  for (byte_t& b : bytes)
+    b = random();
+
+  int const level = kernelLevel();
+  std::ofstream sink("/dev/null");
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "CPU kernels: " << (level == AVX2 ? "AVX2" : level == SSSE3 ? "SSSE3" : "scalar")
+	    << ", " << megabytes << " MB in records of " << RECORD << " bytes" << std::endl;
+
+  // The MB count is the one of the bytes, encoded or decoded
+  benchKernel("hex, stream", megabytes, RECORD, [&](size_t i, size_t n) { legacyPrintHex(&bytes[i], n, sink); });
+  benchKernel("hex, scalar", megabytes, RECORD, [&](size_t i, size_t n) { toHexScalar(&bytes[i], n, &text[2 * i]); });
+#ifdef TOOLS_X86
+  if (level >= SSSE3)
+    benchKernel("hex, SSSE3", megabytes, RECORD, [&](size_t i, size_t n) { toHexSSSE3(&bytes[i], n, &text[2 * i]); });
+  if (level >= AVX2)
+    benchKernel("hex, AVX2", megabytes, RECORD, [&](size_t i, size_t n) { toHexAVX2(&bytes[i], n, &text[2 * i]); });
+#endif
+  benchKernel("hex, printHex", megabytes, RECORD, [&](size_t i, size_t n) { printHex(&bytes[i], n, "", sink); });
+
+  benchKernel("printable, stream", megabytes, RECORD, [&](size_t i, size_t n) { legacyPrintChar(&bytes[i], n, sink); });
+  benchKernel("printable, scalar", megabytes, RECORD,
+	      [&](size_t i, size_t n) { toPrintableScalar(&bytes[i], n, &text[i]); });
+#ifdef TOOLS_X86
+  if (level >= SSSE3)
+    benchKernel("printable, SSSE3", megabytes, RECORD,
+		[&](size_t i, size_t n) { toPrintableSSSE3(&bytes[i], n, &text[i]); });
+  if (level >= AVX2)
+    benchKernel("printable, AVX2", megabytes, RECORD,
+		[&](size_t i, size_t n) { toPrintableAVX2(&bytes[i], n, &text[i]); });
+#endif
+  benchKernel("printable, printChar", megabytes, RECORD, [&](size_t i, size_t n) { printChar(&bytes[i], n, "", sink); });
+
+  // Decoding reads the text of the whole buffer, checked against the bytes once
+  toHexScalar(bytes.data(), BUFFER, text.data());
+  text[2 * BUFFER] = 0;
+  if (fromHex(text.data(), decoded.data(), BUFFER) != BUFFER || decoded != bytes) {
+    std::cerr << "fromHex does not decode what toHex encoded" << std::endl;
+    return 1;
+  }
+  benchKernel("unhex, legacy", megabytes, RECORD,
+	      [&](size_t i, size_t n) { legacyFromHex(&text[2 * i], &decoded[i], n); });
+  benchKernel("unhex, scalar", megabytes, RECORD,
+	      [&](size_t i, size_t n) { fromHexScalar(&text[2 * i], 2 * n, &decoded[i], n); });
+#ifdef TOOLS_X86
+  if (level >= SSSE3)
+    benchKernel("unhex, SSSE3", megabytes, RECORD,
+		[&](size_t i, size_t n) { fromHexSSSE3(&text[2 * i], 2 * n, &decoded[i], n); });
+#endif
+  benchKernel("unhex, fromHex", megabytes, RECORD, [&](size_t i, size_t n) { fromHex(&text[2 * i], &decoded[i], n); });
+
+  std::cout.unsetf(std::ios::floatfield);
+  return 0;
+}
+
+// FNV-1a with a final mix, so that every bit of the result depends on every input byte
+unsigned long long Tools::hash(void const* data, size_t size) {
+  byte_t const* p = (byte_t const*)data;
+  unsigned long long h = 0xCBF29CE484222325ull;
 
-  std::cout << std::hex << std::uppercase;
   for (size_t i = 0; i < size; ++i)
-    std::cout << std::setw(2) << std::setfill('0') << (unsigned int)str[i];
-  std::cout << std::dec;
+    h = (h ^ p[i]) * 0x100000001B3ull;
 
-  std::cout << std::endl;  
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDull;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ull;
+  h ^= h >> 33;
+  return h;
 }
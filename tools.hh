@@ -27,17 +27,22 @@
 #include <cstdio>
 #include <iostream>
 #include <iomanip>
-
-//#define DEBUG
+#include <vector>
 
 #define MAX_FRAME_LEN 300
 
-// Macro to print unsigned chars in hexadecimal
-#define HEX(c) std::hex << std::uppercase << std::setw(2) << std::setfill('0') << (unsigned int)c << std::dec
-
 typedef unsigned char byte_t;
 
-extern struct nfc_device* pnd;
+// Two uppercase hexadecimal digits, the stream format is left untouched
+struct HexByte {
+  byte_t value;
+};
+std::ostream& operator<<(std::ostream& out, HexByte h);
+
+// Macro to print unsigned chars in hexadecimal
+#define HEX(c) HexByte{(byte_t)(c)}
+
+extern thread_local struct nfc_device* pnd; // Device of the calling thread, see ReaderHealth::use
 
 struct Application {
   byte_t priority;
@@ -59,16 +64,28 @@ public:
   static const byte_t GPO_HEADER[6];
   static const byte_t READ_RECORD[7];
   static const byte_t GET_DATA_LOG_FORMAT[7];
+  static const byte_t GET_RESPONSE[7];
+
+  static const byte_t IN_DATA_EXCHANGE = 0x40; // First byte of every APDU frame
 
 };
 
 // Misc tools for printing
 class Tools {
 public:
-  static void print(char const* str, std::string const& label = "");
-  static void printChar(byte_t const* str, size_t size, std::string const& = "");
-  static void printHex(APDU const&, std::string const& = "");
-  static void printHex(byte_t const* str, size_t size, std::string const& = "");
+  static void print(char const* str, std::string const& label = "", std::ostream& out = std::cout);
+  static void printChar(byte_t const* str, size_t size, std::string const& = "", std::ostream& out = std::cout);
+  static void printHex(APDU const&, std::string const& = "", std::ostream& out = std::cout);
+  static void printHex(byte_t const* str, size_t size, std::string const& = "", std::ostream& out = std::cout);
+  static void printDistribution(char const* label, std::vector<long>& samples, double unit = 1000.0, char const* unitName = "us");
+  static size_t fromHex(char const* hex, byte_t* out, size_t max);
+
+  // Buffer kernels, with SSSE3 or AVX2 when the CPU has them. Both return the end of the output,
+  // toHex writes 2 * size characters and toPrintable size characters, '.' for the non printable ones
+  static char* toHex(byte_t const* in, size_t size, char* out);
+  static char* toPrintable(byte_t const* in, size_t size, char* out);
+  static int benchKernels(size_t megabytes);
+  static unsigned long long hash(void const* data, size_t size);
 };
 
 #endif // __TOOLS_HH__
@@ -0,0 +1,257 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <csignal>
+#include <climits>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "trace.hh"
+
+// Single producer (the owning thread), single consumer (the formatting thread)
+struct Trace::Ring {
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+  std::atomic<size_t> dropped;
+  Record records[_RING_SIZE];
+};
+
+std::atomic<int> Trace::_level(Trace::OFF);
+
+static std::mutex ringsLock;
+static std::vector<Trace::Ring*> rings; // One per thread that traced, until it exits
+
+// Drains and frees the ring of a thread when it exits: WorkPool workers, Python threads
+struct Trace::RingOwner {
+  Ring* ring;
+  ~RingOwner();
+};
+
+static thread_local Trace::RingOwner local = {NULL};
+static std::thread consumer;
+static std::mutex consumerLock;
+static std::atomic<bool> running(false);
+static bool stopped = false; // At exit, not started again
+static std::atomic<int> wakeups(0); // Futex of the idle formatting thread
+static struct timespec origin;
+
+static uint64_t now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec - origin.tv_sec) * 1000000000ULL + ts.tv_nsec - origin.tv_nsec;
+}
+
+// Async signal safe
+static void wakeConsumer() {
+  wakeups.fetch_add(1, std::memory_order_release);
+  syscall(SYS_futex, &wakeups, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+void Trace::start(int level) {
+  clock_gettime(CLOCK_MONOTONIC, &origin);
+
+  // Allocated now so the reader thread does not allocate when traces get enabled
+  threadRing();
+
+  signal(SIGUSR1, onSignal);
+  signal(SIGUSR2, onSignal);
+
+  atexit(stop); // Before the thread object is destroyed
+  setLevel(level);
+}
+
+void Trace::stop() {
+  std::lock_guard<std::mutex> guard(consumerLock);
+  stopped = true;
+  if (!running)
+    return;
+  running = false;
+  wakeConsumer();
+  consumer.join();
+}
+
+// The formatting thread only exists once tracing was enabled
+void Trace::startConsumer() {
+  std::lock_guard<std::mutex> guard(consumerLock);
+  if (running || stopped)
+    return;
+  running = true;
+  consumer = std::thread(consume);
+}
+
+void Trace::setLevel(int level) {
+  if (level < OFF)
+    level = OFF;
+  if (level > MAX_LEVEL)
+    level = MAX_LEVEL;
+  _level.store(level, std::memory_order_relaxed);
+  if (level > OFF && !running.load(std::memory_order_acquire))
+    startConsumer();
+  wakeConsumer();
+}
+
+// A thread cannot be started here: the first record() after SIGUSR1 starts it
+void Trace::onSignal(int sig) {
+  int level = _level.load(std::memory_order_relaxed);
+  if (sig == SIGUSR1 && level < MAX_LEVEL) // Up to the full frames, SIGUSR2 turns it off
+    _level.store(level + 1, std::memory_order_relaxed);
+  else if (sig == SIGUSR2)
+    _level.store(OFF, std::memory_order_relaxed);
+  wakeConsumer();
+}
+
+Trace::Ring* Trace::threadRing() {
+  if (local.ring == NULL) {
+    Ring* ring = new Ring();
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+
+    std::lock_guard<std::mutex> guard(ringsLock);
+    rings.push_back(ring);
+    local.ring = ring;
+  }
+  return local.ring;
+}
+
+// The consumer drains under the same lock, the last records are formatted here
+Trace::RingOwner::~RingOwner() {
+  if (ring == NULL)
+    return;
+  std::lock_guard<std::mutex> guard(ringsLock);
+  drain(*ring);
+  rings.erase(std::find(rings.begin(), rings.end(), ring));
+  delete ring;
+  ring = NULL;
+}
+
+// Never blocks: when the formatting thread lags behind, the record is dropped and counted
+void Trace::record(char const* name,
+		   byte_t const* tx, size_t szTx,
+		   byte_t const* rx, int szRx) {
+  if (!running.load(std::memory_order_acquire))
+    startConsumer();
+  Ring* ring = threadRing();
+
+  size_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) == _RING_SIZE) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  Record& r = ring->records[head & (_RING_SIZE - 1)];
+  r.time = now();
+  r.name = name;
+  r.level = _level.load(std::memory_order_relaxed);
+  r.txSize = szTx;
+  r.rxSize = szRx;
+
+  if (r.level >= DATA) {
+    memcpy(r.tx, tx, szTx);
+    if (szRx > 0)
+      memcpy(r.rx, rx, szRx);
+  }
+  else if (szRx >= 2) { // Status word only
+    r.rx[szRx - 2] = rx[szRx - 2];
+    r.rx[szRx - 1] = rx[szRx - 1];
+  }
+
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+// Sleeps on the futex while tracing is off and every ring is drained, polls every ms otherwise
+void Trace::consume() {
+  while (true) {
+    int seen = wakeups.load(std::memory_order_acquire);
+    bool stopping = !running;
+    bool idle = true;
+    {
+      std::lock_guard<std::mutex> guard(ringsLock);
+      for (Ring* ring : rings)
+	if (drain(*ring))
+	  idle = false;
+    }
+    if (stopping)
+      break;
+    if (idle) {
+      std::cerr.flush();
+      if (_level.load(std::memory_order_relaxed) == OFF)
+	syscall(SYS_futex, &wakeups, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+      else
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  std::cerr.flush();
+}
+
+// Returns true if something was formatted
+bool Trace::drain(Ring& ring) {
+  size_t tail = ring.tail.load(std::memory_order_relaxed);
+  size_t head = ring.head.load(std::memory_order_acquire);
+
+  if (tail == head && ring.dropped.load(std::memory_order_relaxed) == 0)
+    return false;
+
+  for (; tail != head; ++tail)
+    format(ring.records[tail & (_RING_SIZE - 1)]);
+  ring.tail.store(tail, std::memory_order_release);
+
+  size_t dropped = ring.dropped.exchange(0, std::memory_order_relaxed);
+  if (dropped)
+    std::cerr << "[trace] " << dropped << " record(s) dropped" << std::endl;
+  return true;
+}
+
+void Trace::format(Record const& r) {
+  std::cerr << "[" << std::setfill(' ') << std::setw(6) << r.time / 1000000000ULL << "."
+	    << std::setw(6) << std::setfill('0') << (r.time / 1000) % 1000000 << std::setfill(' ') << "] "
+	    << r.name << ": ";
+
+  if (r.rxSize < 0) {
+    std::cerr << "transceive error" << std::endl;
+    return;
+  }
+
+  if (r.level >= DATA) {
+    // The answer starts with the PN532 status byte, not part of the APDU
+    Tools::printHex(r.tx, r.txSize, ">>", std::cerr);
+    std::cerr << "    ";
+    Tools::printHex(r.rx + 1, r.rxSize > 0 ? r.rxSize - 1 : 0, "<<", std::cerr);
+  }
+  else {
+    std::cerr << r.txSize << " bytes sent, " << (r.rxSize > 0 ? r.rxSize - 1 : 0) << " bytes received";
+    if (r.rxSize >= 3)
+      std::cerr << ", SW " << HEX(r.rx[r.rxSize - 2]) << HEX(r.rx[r.rxSize - 1]);
+    std::cerr << std::endl;
+  }
+}
@@ -0,0 +1,87 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __TRACE_HH__
+# define __TRACE_HH__
+
+#include <atomic>
+#include <cstdint>
+
+#include "tools.hh"
+
+/* APDU tracing, switchable at runtime (--trace N, SIGUSR1 raises the level, SIGUSR2 turns it off).
+   When off, executeCommand only pays for enabled(). When on, records are pushed into a
+   per-thread lock-free ring and formatted on stderr by a background thread, started the first time
+   tracing is enabled and asleep on a futex whenever tracing is off and the rings are drained.
+*/
+class Trace {
+
+public:
+  enum Level {
+    OFF = 0,
+    APDU = 1, // Command name, lengths and status word
+    DATA = 2, // Full command and response bytes
+    MAX_LEVEL = DATA
+  };
+
+public:
+  static void start(int level);
+  static void stop();
+  static void setLevel(int level);
+
+  static inline bool enabled(int level) {
+    return __builtin_expect(_level.load(std::memory_order_relaxed) >= level, 0);
+  }
+
+  static void record(char const* name,
+		     byte_t const* tx, size_t szTx,
+		     byte_t const* rx, int szRx);
+
+private:
+  struct Record {
+    uint64_t time; // ns since start()
+    char const* name; // Always a literal
+    int level;
+    int txSize;
+    int rxSize;
+    byte_t tx[MAX_FRAME_LEN];
+    byte_t rx[MAX_FRAME_LEN];
+  };
+
+public:
+  struct Ring; // Opaque, one per tracing thread
+  struct RingOwner;
+
+private:
+  static Ring* threadRing();
+  static void startConsumer();
+  static void consume();
+  static bool drain(Ring& ring);
+  static void format(Record const& record);
+  static void onSignal(int sig);
+
+private:
+  static std::atomic<int> _level;
+  static const size_t _RING_SIZE = 256; // Power of two
+};
+
+#endif // __TRACE_HH__
@@ -0,0 +1,190 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+#include "tracedecoder.hh"
+#include "apdufile.hh"
+#include "cardimage.hh"
+#include "cardreader.hh"
+#include "applicationhelper.hh"
+#include "workpool.hh"
+#include "stageprofile.hh"
+
+struct DecodeSession {
+  byte_t const* data;
+  size_t size;
+};
+
+static const size_t CHUNK_SESSIONS = 64;
+
+static thread_local CardImage replayed;
+
+// Answers with the recorded session of the current thread, an empty answer is a recorded failure
+static int replay(byte_t const* tx, size_t szTx, byte_t* rx, size_t szRx, int) {
+  if (tx[0] != Command::IN_DATA_EXCHANGE) {
+    byte_t const target[] = {0x01, 0x01, 0x00, 0x04, 0x20, 0x04, 0x12, 0x34, 0x56, 0x78};
+    memcpy(rx, target, sizeof(target));
+    return sizeof(target);
+  }
+
+  Bytes response;
+  replayed.answer(tx, szTx, response);
+  if (response.empty() || response.size() + 1 > szRx)
+    return -1;
+  rx[0] = 0x00; // PN532 status
+  memcpy(rx + 1, response.data(), response.size());
+  return response.size() + 1;
+}
+
+// Puts a recorded session in the field of the calling thread: ApplicationHelper now talks to it
+void TraceDecoder::present(byte_t const* session, size_t size) {
+  ApplicationHelper::setTransceiver(::replay);
+  replayed.load(session, size);
+  ApplicationHelper::executeCommand(Command::START_14443A,
+				    sizeof(Command::START_14443A),
+				    "START 14443A");
+}
+
+// Replays one recorded session through the read path on the calling thread
+void TraceDecoder::replay(byte_t const* session, size_t size, std::vector<CCInfo>& infos, bool dump,
+			  std::ostream& log) {
+  present(session, size);
+  CardReader::read(infos, dump, log);
+}
+
+static void decodeChunk(std::vector<DecodeSession> const& sessions, size_t first, bool dump,
+			ChunkOutput& output) {
+  static thread_local std::ostringstream out;
+  static thread_local std::ostringstream log;
+  std::vector<CCInfo> infos;
+
+  out.str("");
+  log.str("");
+
+  size_t last = std::min(first + CHUNK_SESSIONS, sessions.size());
+  for (size_t i = first; i < last; ++i) {
+    CardReader::printMarker(out);
+    TraceDecoder::replay(sessions[i].data, sessions[i].size, infos, dump, log);
+    CardReader::print(infos, out);
+  }
+
+  output.out = out.str();
+  output.log = log.str();
+}
+
+// Returns the number of sessions, output is dropped when out is NULL
+static size_t run(std::vector<ApduFile>& files, unsigned threads, bool dump, std::ostream* out) {
+  std::vector<DecodeSession> sessions;
+
+  DecodeSession s;
+  for (ApduFile& file : files) {
+    file.rewind();
+    while (file.nextSession(s.data, s.size))
+      sessions.push_back(s);
+  }
+
+  size_t chunks = (sessions.size() + CHUNK_SESSIONS - 1) / CHUNK_SESSIONS;
+  WorkPool::run(chunks, threads,
+		[&sessions, dump] (size_t chunk, unsigned, ChunkOutput& output) {
+		  decodeChunk(sessions, chunk * CHUNK_SESSIONS, dump, output);
+		},
+		[out] (size_t, ChunkOutput& output) {
+		  if (out) {
+		    *out << output.out;
+		    std::cerr << output.log;
+		  }
+		});
+  return sessions.size();
+}
+
+static int openAll(std::vector<char const*> const& paths, std::vector<ApduFile>& files) {
+  for (size_t i = 0; i < paths.size(); ++i)
+    if (files[i].open(paths[i]))
+	return 1;
+  return 0;
+}
+
+int TraceDecoder::decode(std::vector<char const*> const& paths, unsigned threads, bool dump,
+			 std::ostream& out) {
+  std::vector<ApduFile> files(paths.size());
+  if (openAll(paths, files))
+    return 1;
+
+  run(files, threads, dump, &out);
+  out.flush();
+  return 0;
+}
+
+// Decodes the traces on the calling thread with the stage profile, output discarded
+int TraceDecoder::profile(std::vector<char const*> const& paths, bool dump) {
+  std::vector<ApduFile> files(paths.size());
+  if (openAll(paths, files))
+    return 1;
+
+  std::ostringstream out;
+  std::ostringstream log;
+  std::vector<CCInfo> infos;
+  size_t sessions = 0;
+  byte_t const* session;
+  size_t size;
+
+  StageProfile::start();
+  for (ApduFile& file : files)
+    for (; file.nextSession(session, size); ++sessions) {
+      out.str("");
+      log.str("");
+      replay(session, size, infos, dump, log);
+      CardReader::print(infos, out);
+    }
+
+  std::cout << sessions << " session(s) replayed" << std::endl;
+  StageProfile::print();
+  return 0;
+}
+
+// Decodes the traces with 1, 2, 4 ... threads, output discarded
+int TraceDecoder::scaling(std::vector<char const*> const& paths, unsigned threads, bool dump) {
+  std::vector<ApduFile> files(paths.size());
+  if (openAll(paths, files))
+    return 1;
+
+  std::cout << "-- Trace decoding scaling --" << std::endl;
+  double base = 0;
+  for (unsigned n = 1; ; n = std::min(n * 2, threads)) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t sessions = run(files, n, dump, NULL);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rate = elapsed > 0 ? sessions / elapsed : 0;
+    if (n == 1)
+      base = rate;
+
+    std::cout << n << " thread(s): " << sessions << " session(s) in " << elapsed << "s, "
+	      << rate << " sessions/s, speedup " << (base > 0 ? rate / base : 0) << std::endl;
+    if (n >= threads)
+      break;
+  }
+  return 0;
+}
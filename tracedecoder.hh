@@ -0,0 +1,48 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __TRACEDECODER_HH__
+# define __TRACEDECODER_HH__
+
+#include <vector>
+#include <iostream>
+
+#include "ccinfo.hh"
+
+/* Offline decoding of recorded APDU traces.
+   Every session is replayed through the regular read path (ApplicationHelper, CardReader, CCInfo)
+   on a WorkPool. Chunks of sessions are formatted in per-thread buffers and written in the order
+   of the traces, so the output does not depend on the number of threads.
+*/
+class TraceDecoder {
+
+public:
+  static int decode(std::vector<char const*> const& paths, unsigned threads, bool dump,
+		    std::ostream& out = std::cout);
+  static int scaling(std::vector<char const*> const& paths, unsigned threads, bool dump);
+  static int profile(std::vector<char const*> const& paths, bool dump);
+  static void present(byte_t const* session, size_t size);
+  static void replay(byte_t const* session, size_t size, std::vector<CCInfo>& infos, bool dump,
+		     std::ostream& log);
+};
+
+#endif // __TRACEDECODER_HH__
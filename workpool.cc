@@ -0,0 +1,102 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "workpool.hh"
+
+struct PoolJob {
+  size_t chunks;
+  size_t window; // Chunks a worker may run ahead of the emitter
+  size_t next; // First chunk not handed out
+  size_t emitted; // Chunks already emitted
+  std::vector<ChunkOutput> outputs;
+  std::vector<bool> done;
+
+  std::mutex lock; // Protects all of the above
+  std::condition_variable finished; // A chunk is done
+  std::condition_variable room; // A chunk was emitted
+};
+
+// Next chunk in order, once it is within the window of the emitter
+static bool take(PoolJob& job, size_t& chunk) {
+  std::unique_lock<std::mutex> guard(job.lock);
+  job.room.wait(guard, [&job] { return job.next >= job.chunks || job.next < job.emitted + job.window; });
+  if (job.next >= job.chunks)
+    return false;
+  chunk = job.next++;
+  return true;
+}
+
+static void work(PoolJob& job, unsigned self, WorkPool::Work const& doWork) {
+  size_t chunk;
+
+  while (take(job, chunk)) {
+    ChunkOutput output;
+    doWork(chunk, self, output);
+
+    std::lock_guard<std::mutex> guard(job.lock);
+    job.outputs[chunk].out.swap(output.out);
+    job.outputs[chunk].log.swap(output.log);
+    job.done[chunk] = true;
+    job.finished.notify_one();
+  }
+}
+
+void WorkPool::run(size_t chunks, unsigned threads, Work const& doWork, Emit const& emit) {
+  PoolJob job;
+
+  if (threads < 1)
+    threads = 1;
+  job.chunks = chunks;
+  job.window = _WINDOW_PER_THREAD * threads;
+  job.next = 0;
+  job.emitted = 0;
+  job.outputs.resize(chunks);
+  job.done.resize(chunks, false);
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < threads; ++i)
+    pool.push_back(std::thread(work, std::ref(job), i, std::cref(doWork)));
+
+  // Emitted as soon as the next chunk is ready
+  for (size_t i = 0; i < chunks; ++i) {
+    ChunkOutput output;
+    {
+      std::unique_lock<std::mutex> guard(job.lock);
+      job.finished.wait(guard, [&job, i] { return job.done[i]; });
+      output.out.swap(job.outputs[i].out);
+      output.log.swap(job.outputs[i].log);
+    }
+    emit(i, output);
+
+    std::lock_guard<std::mutex> guard(job.lock);
+    job.emitted = i + 1;
+    job.room.notify_all();
+  }
+
+  for (std::thread& t : pool)
+    t.join();
+}
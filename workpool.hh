@@ -0,0 +1,53 @@
+/*
+  Copyright (C) 2014 Alexis Guillard, Maxime Marches, Thomas Brunner
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+  
+  File written for the requirements of our MSc Project at the University of Kent, Canterbury, UK
+  
+  Retrieves information available from EMV smartcards via an RFID/NFC reader.
+  Both tracks are printed then track2 is parsed to retrieve PAN and expiry date.
+  The paylog is parsed and showed as well.
+  
+  All these information are stored in plaintext on the card and available to anyone.
+
+  Requirements:
+  libnfc (>= 1.7.1) -> For later versions, please update the pn52x_transceive() prototype if needed, as it is not included in nfc.h
+
+*/
+
+#ifndef __WORKPOOL_HH__
+# define __WORKPOOL_HH__
+
+#include <string>
+#include <functional>
+
+// What a chunk produced, handed back in chunk order
+struct ChunkOutput {
+  std::string out;
+  std::string log;
+};
+
+/* Runs work on every chunk with a pool of threads, then emit on the results in chunk order.
+   Chunks are handed out in order to whichever thread is free, and no thread starts a chunk more than
+   _WINDOW_PER_THREAD * threads chunks ahead of the last one emitted: the outputs held in memory are
+   bounded by the thread count, not by the size of the input. thread is the index of the worker,
+   for per-thread state.
+*/
+class WorkPool {
+
+public:
+  typedef std::function<void (size_t chunk, unsigned thread, ChunkOutput& output)> Work;
+  typedef std::function<void (size_t chunk, ChunkOutput& output)> Emit;
+
+  static void run(size_t chunks, unsigned threads, Work const& work, Emit const& emit);
+
+private:
+  static const size_t _WINDOW_PER_THREAD = 4;
+};
+
+#endif // __WORKPOOL_HH__